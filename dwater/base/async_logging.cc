@@ -1,35 +1,64 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.03.21
+// Last modified:   2021.04.17
 // Filename:        async_logging.cc
 // Descripton:      异步日志的实现
 
 #include "dwater/base/async_logging.h"
 #include "dwater/base/log_file.h"
+#include "dwater/base/logging.h"
 #include "dwater/base/condition.h"
+#include "dwater/base/mpsc_queue.h"
 #include "dwater/base/timestamp.h"
 
+#include <algorithm>
+
 #include <stdio.h>
 
 using namespace dwater;
 
-// 异步日志中有连个FixedBuffer,以及一个Buffervector,重点在于Append数据
+namespace {
+
+std::atomic<int> g_next_id(0);
+
+// kdrop_below_warn给WARN及以上留的buffer占总数的比例
+const int kwarn_reserve_ratio = 4;
+
+} // namespace
+
+///
+/// 一个线程写日志的buffer，seq是这个线程内的顺序，start是写第一条日志的时间，
+/// binary表示有Logger二进制模式的条目，写文件之前要先转换成文本，
+/// spill表示是kspill临时分配的，写完就释放
+///
+struct AsyncLogging::LogBuffer : MpscNode {
+    LogBuffer() : seq(0), start(0), binary(false), spill(false) {}
 
-// typedef dwater::detail::FixedBuffer<dwater::detail::k_large_buffer> Buffer;
-// typedef std::vector<std::unique_ptr<Buffer>> BufferVector;
-// typedef BufferVector::value_type BufferPtr;
+    detail::FixedBuffer<detail::k_thread_buffer>   data;
+    uint64_t                                        seq;
+    int64_t                                         start;
+    bool                                            binary;
+    bool                                            spill;
+};
 
-// const int flush_interval_;
-// std::atomic<bool> running_;
-// const string basename_;
-// const off_t roll_size_;
-// dwater::Thread thread_; // 后台线程，这个线程消化buffers_中的数据，写到LogFile中，再由LogFile进行IO
-// dwater::CountDownLatch latch_;
-// dwater::MutexLock mutex_;
-// dwater::Condition cond_ GUARDED_BY(mutex_);
-// BufferPtr curr_buffer_ GUARDED_BY(mutex_);
-// BufferPtr next_buffer_ GUARDED_BY(mutex_);
-// BufferVector buffers_ GUARDED_BY(mutex_);
+///
+/// 每个写日志的线程一个，只有这个线程往current放buffer，后台线程只会取走
+///
+struct AsyncLogging::ThreadBuffer : noncopyable {
+    ThreadBuffer() : current(NULL), next_seq(0), retired(false) {}
+
+    ~ThreadBuffer() {
+        delete current.load();
+        while ( MpscNode* node = full.Pop() ) {
+            delete static_cast<LogBuffer*>(node);
+        }
+    }
+
+    std::atomic<LogBuffer*> current;    // 生产者正在写的时候为NULL
+    MpscQueue               full;       // 写满的buffer，只有一个生产者，不会乱序
+    uint64_t                next_seq;
+    std::atomic<bool>       retired;    // 线程已经退出
+};
 
 AsyncLogging::AsyncLogging(const string& basename,
                           off_t roll_size,
@@ -38,113 +67,322 @@ AsyncLogging::AsyncLogging(const string& basename,
       running_(false),
       basename_(basename),
       roll_size_(roll_size),
+      id_(g_next_id.fetch_add(1)),
+      sink_factory_(FileSinkFactory()),
+      roll_callback_(),
+      policy_(kdrop_newest),
+      max_buffers_(kdefault_max_buffers),
+      max_spill_(0),
+      dropped_lines_(0),
+      blocked_lines_(0),
+      pool_free_(0),
       thread_(std::bind(&AsyncLogging::ThreadFunc, this), "Logging"),
       latch_(1),
       mutex_(),
       cond_(mutex_),
-      curr_buffer_(new Buffer),
-      next_buffer_(new Buffer),
-      buffers_() {
-    curr_buffer_->Bzero();
-    next_buffer_->Bzero();
-    buffers_.reserve(16);
+      woken_(false),
+      threads_(),
+      pool_mutex_(),
+      pool_cond_(pool_mutex_),
+      pool_(),
+      spilled_(0) {
+    // Start()之前写的日志也有地方放，Start()的时候再按max_buffers_调整
+    MutexLockGuard lock(pool_mutex_);
+    for ( int i = 0; i < max_buffers_; ++i ) {
+        pool_.push_back(new LogBuffer);
+    }
+    pool_free_ = static_cast<int>(pool_.size());
+}
+
+AsyncLogging::~AsyncLogging() {
+    if ( running_ ) {
+        Stop();
+    }
+    MutexLockGuard lock(pool_mutex_);
+    for ( LogBuffer* buffer : pool_ ) {
+        delete buffer;
+    }
+}
+
+void AsyncLogging::Start() {
+    {
+        MutexLockGuard lock(pool_mutex_);
+        size_t in_use = kdefault_max_buffers - pool_.size();
+        size_t wanted = static_cast<size_t>(std::max(max_buffers_, 1));
+        while ( pool_.size() + in_use < wanted ) {
+            pool_.push_back(new LogBuffer);
+        }
+        while ( pool_.size() + in_use > wanted && !pool_.empty() ) {
+            delete pool_.back();
+            pool_.pop_back();
+        }
+        pool_free_ = static_cast<int>(pool_.size());
+    }
+    running_ = true;
+    thread_.Start();
+    latch_.Wait();
+}
+
+AsyncLogging::ThreadBuffer* AsyncLogging::LocalBuffer() {
+    // 线程退出的时候通知后台线程，写完剩下的数据之后就可以释放这个线程的buffer
+    struct Local {
+        Local() : owner(-1) {}
+
+        ~Local() {
+            if ( buffer ) {
+                buffer->retired.store(true, std::memory_order_release);
+            }
+        }
+
+        int             owner;
+        ThreadBufferPtr buffer;
+    };
+    static thread_local Local t_local;
+
+    if ( t_local.owner != id_ ) {
+        if ( t_local.buffer ) {
+            t_local.buffer->retired.store(true, std::memory_order_release);
+        }
+        t_local.owner = id_;
+        t_local.buffer = std::make_shared<ThreadBuffer>();
+        MutexLockGuard lock(mutex_);
+        threads_.push_back(t_local.buffer);
+    }
+    return t_local.buffer.get();
 }
 
-// 使用mutex_保护两个buffer的读写，当curr_buf没有满可以写数据就直接写，否则
-// 就将curr_buf插入到bufvec中，把next_buf的数据移动到curr_buf, 如果next_buf也没有
-// 数据，那么直接给curr_buf申请新的空间.在这里curr_buf是作为临时的中转的
-// 数据写完之后通过条件变量通知其他线程
 void AsyncLogging::Append(const char* logline, int len) {
+    Append(logline, len, Logger::OutputLevel());
+}
+
+// 正在写的buffer从current中取出来，写完再放回去。后台线程在这期间拿不到，
+// 写满了就放到full队列中，从buffer池中换一个空的
+void AsyncLogging::Append(const char* logline, int len, Logger::LogLevel level) {
+    // buffer快用完了，当前buffer还有空间也不写，留给WARN及以上
+    if ( policy_ == kdrop_below_warn && level < Logger::WARN &&
+         pool_free_.load(std::memory_order_relaxed) <= WarnReserve() ) {
+        dropped_lines_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ThreadBuffer* thread = LocalBuffer();
+    LogBuffer* buffer = thread->current.exchange(NULL, std::memory_order_acquire);
+    bool full = false;
+    if ( buffer != NULL && buffer->data.Avail() <= len && buffer->data.Length() > 0 ) {
+        thread->full.Push(buffer);
+        buffer = NULL;
+        full = true;
+    }
+    if ( buffer == NULL ) {
+        buffer = TakeBuffer(level);
+        if ( buffer == NULL ) {
+            dropped_lines_.fetch_add(1, std::memory_order_relaxed);
+            if ( full ) {
+                Wake();
+            }
+            return;
+        }
+    }
+    if ( buffer->data.Length() == 0 ) {
+        buffer->seq = thread->next_seq++;
+        buffer->start = Timestamp::Now().MicroSecondsSinceEpoch();
+        buffer->binary = false;
+    }
+    if ( len > 0 && logline[0] == '\0' ) {
+        buffer->binary = true;
+    }
+    buffer->data.Append(logline, len);
+    thread->current.store(buffer, std::memory_order_release);
+    if ( full ) {
+        Wake(); // 至少一个buffer满了就通知后台线程要写数据到磁盘了
+    }
+}
+
+int AsyncLogging::WarnReserve() const {
+    return std::max(max_buffers_ / kwarn_reserve_ratio, 1);
+}
+
+AsyncLogging::LogBuffer* AsyncLogging::TakeBuffer(Logger::LogLevel level) {
+    MutexLockGuard lock(pool_mutex_);
+    size_t reserved = 0;
+    if ( policy_ == kdrop_below_warn && level < Logger::WARN ) {
+        reserved = static_cast<size_t>(WarnReserve());
+    }
+    if ( pool_.size() > reserved ) {
+        LogBuffer* buffer = pool_.back();
+        pool_.pop_back();
+        pool_free_ = static_cast<int>(pool_.size());
+        return buffer;
+    }
+
+    bool block = policy_ == kblock || (policy_ == kdrop_below_warn && level >= Logger::WARN);
+    if ( block && running_ ) {
+        blocked_lines_.fetch_add(1, std::memory_order_relaxed);
+        Wake(); // 先拿pool_mutex_再拿mutex_
+        while ( pool_.empty() && running_ ) {
+            pool_cond_.Wait();
+        }
+    } else if ( policy_ == kspill && spilled_ < max_spill_ ) {
+        ++spilled_;
+        LogBuffer* buffer = new LogBuffer;
+        buffer->spill = true;
+        return buffer;
+    }
+
+    if ( pool_.size() <= reserved ) {
+        return NULL;
+    }
+    LogBuffer* buffer = pool_.back();
+    pool_.pop_back();
+    pool_free_ = static_cast<int>(pool_.size());
+    return buffer;
+}
+
+void AsyncLogging::ReturnBuffers(const LogBufferList& buffers) {
+    if ( buffers.empty() ) {
+        return;
+    }
+    MutexLockGuard lock(pool_mutex_);
+    for ( LogBuffer* buffer : buffers ) {
+        if ( buffer->spill ) {
+            delete buffer;
+            --spilled_;
+        } else {
+            buffer->data.Reset();
+            pool_.push_back(buffer);
+        }
+    }
+    pool_free_ = static_cast<int>(pool_.size());
+    pool_cond_.NotifyAll();
+}
+
+void AsyncLogging::Wake() {
     MutexLockGuard lock(mutex_);
-    if ( curr_buffer_->Avail() ) {
-        curr_buffer_->Append(logline, len);
-    } else {
-        buffers_.push_back(std::move(curr_buffer_));
-        if ( next_buffer_ ) {
-            curr_buffer_ = std::move(next_buffer_);
+    woken_ = true;
+    cond_.Notify();
+}
+
+void AsyncLogging::Collect(ThreadBuffer* thread, LogBufferList* buffers,
+                           LogBufferList* empty_buffers) {
+    size_t first = buffers->size();
+    while ( MpscNode* node = thread->full.Pop() ) {
+        buffers->push_back(static_cast<LogBuffer*>(node));
+    }
+
+    // 把正在写的buffer拿过来，生产者下次写的时候再从buffer池中取
+    LogBuffer* current = thread->current.exchange(NULL, std::memory_order_acq_rel);
+    if ( current != NULL ) {
+        if ( current->data.Length() > 0 ) {
+            buffers->push_back(current);
         } else {
-            curr_buffer_.reset(new Buffer);
+            empty_buffers->push_back(current);
         }
-        curr_buffer_->Append(logline, len);
-        cond_.Notify(); // 至少一个buffer满了就通知后天线程要写数据到磁盘了
     }
+
+    // 拿走current之前放进队列的buffer现在一定能看到
+    while ( MpscNode* node = thread->full.Pop() ) {
+        buffers->push_back(static_cast<LogBuffer*>(node));
+    }
+    std::sort(buffers->begin() + first, buffers->end(),
+              [](const LogBuffer* a, const LogBuffer* b) { return a->seq < b->seq; });
 }
 
-// 后台线程，消化buffervector的数据，将数据写到磁盘
-// 给一个线程专门执行这个函数
+// 后台线程，收集所有线程的buffer，写到磁盘
 void AsyncLogging::ThreadFunc() {
     assert(running_ == true);
     latch_.CountDown();
-    LogFile output(basename_, roll_size_, false); // 由logFile类直接进行IO
-    BufferPtr new_buffer1(new Buffer); // 后台线程的两个buffer
-    BufferPtr new_buffer2(new Buffer);
-    new_buffer1->Bzero();
-    new_buffer2->Bzero();
-    BufferVector buffers_to_write;  // 将前台产生buffervector中的数据swap过来
-    buffers_to_write.reserve(16);
-
-    while ( running_ ) {
-        assert(new_buffer1 && new_buffer1->Length() == 0);
-        assert(new_buffer2 && new_buffer2->Length() == 0);
-        assert(buffers_to_write.empty());
+    LogFile output(basename_, roll_size_, sink_factory_, false); // 由logFile类直接进行IO
+    output.SetRollCallback(roll_callback_);
+    std::vector<ThreadBufferPtr> threads;
+    std::vector<LogBufferList> collected;
+    LogBufferList buffers_to_write;
+    LogBufferList empty_buffers;
+    string text; // 二进制条目格式化之后的文本
+    int64_t reported_dropped = 0;
+    bool stopping = false;
 
+    while ( !stopping ) {
         {
             MutexLockGuard lock(mutex_);
-            // 等待醒过来，无论因为时间到了还是条件变量好了，都会醒过来
-            if ( buffers_.empty() ) {
+            // 等待醒过来，无论因为时间到了还是有buffer满了
+            if ( !woken_ && running_ ) {
                 cond_.WaitForSeconds(flush_interval_);
             }
-            // curr_buff_数据放入到buffers_中
-            buffers_.push_back(std::move(curr_buffer_));
-            // 还一个空的curr_buffer给前台
-            curr_buffer_ = std::move(new_buffer1);
-            // 把此时所有的数据移动到后台线程自己的buffer中
-            buffers_to_write.swap(buffers_);
-            // 如果第二个也是空的话，那么第二个也归还
-            if ( !next_buffer_ ) {
-                next_buffer_ = std::move(new_buffer2);
+            woken_ = false;
+            stopping = !running_;
+            threads = threads_;
+        }
+
+        // 先看退出标记再收集，线程退出之前写的日志都能收集到
+        std::vector<bool> retired(threads.size());
+        collected.resize(threads.size());
+        for ( size_t i = 0; i < threads.size(); ++i ) {
+            retired[i] = threads[i]->retired.load(std::memory_order_acquire);
+            collected[i].clear();
+            Collect(threads[i].get(), &collected[i], &empty_buffers);
+        }
+        ReturnBuffers(empty_buffers);
+        empty_buffers.clear();
+
+        // 不同线程的buffer按开始时间合并，同一个线程的顺序不变
+        std::vector<size_t> next(threads.size(), 0);
+        for ( ;; ) {
+            LogBuffer* earliest = NULL;
+            size_t from = 0;
+            for ( size_t i = 0; i < collected.size(); ++i ) {
+                if ( next[i] < collected[i].size() &&
+                     (earliest == NULL || collected[i][next[i]]->start < earliest->start) ) {
+                    earliest = collected[i][next[i]];
+                    from = i;
+                }
+            }
+            if ( earliest == NULL ) {
+                break;
             }
+            buffers_to_write.push_back(earliest);
+            ++next[from];
         }
 
-        // 如果要写的数据太多了，就丢弃部分数据，只丢下前连个buffer写到文件
-        assert(!buffers_to_write.empty());
-        if ( buffers_to_write.size() > 25 ) {
+        // 生产者因为没有buffer丢掉的日志在这里报告
+        int64_t dropped = DroppedLines();
+        if ( dropped != reported_dropped ) {
             char buf[256];
-            snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd larger buffers\n",
+            snprintf(buf, sizeof buf, "Dropped log messages at %s, %lld lines, %lld in total\n",
                     Timestamp::Now().ToFormattedString().c_str(),
-                    buffers_to_write.size() - 2);
+                    static_cast<long long>(dropped - reported_dropped),
+                    static_cast<long long>(dropped));
             fputs(buf, stderr);
             output.Append(buf, static_cast<int>(strlen(buf)));
-            buffers_to_write.erase(buffers_to_write.begin() + 2, buffers_to_write.end());
-        }
-
-        // 写到LogFile中，直接写到文件
-        for ( const auto& buffer : buffers_to_write ) {
-            output.Append(buffer->Data(), buffer->Length());
+            reported_dropped = dropped;
         }
 
-        if ( buffers_to_write.size() > 2 ) {
-            buffers_to_write.resize(2);
-        }
-
-        // 写完了清空数据
-        if ( !new_buffer1 ) {
-            assert(!buffers_to_write.empty());
-            new_buffer1 = std::move(buffers_to_write.back());
-            buffers_to_write.pop_back();
-            new_buffer1.reset();
+        // 写到LogFile中，直接写到文件。写完一个就还回去，等待的生产者可以早一点继续
+        for ( LogBuffer* buffer : buffers_to_write ) {
+            if ( buffer->binary ) {
+                text.clear();
+                Logger::DecodeBinary(buffer->data.Data(), buffer->data.Length(), &text);
+                output.Append(text.data(), static_cast<int>(text.size()));
+            } else {
+                output.Append(buffer->data.Data(), buffer->data.Length());
+            }
+            ReturnBuffers(LogBufferList(1, buffer));
         }
+        buffers_to_write.clear();
 
-        if ( !new_buffer2 ) {
-            assert(!buffers_to_write.empty());
-            new_buffer2 = std::move(buffers_to_write.back());
-            buffers_to_write.pop_back();
-            new_buffer2.reset();
+        // 已经退出的线程不会再写了，数据都已经收集
+        bool any_retired = std::find(retired.begin(), retired.end(), true) != retired.end();
+        if ( any_retired ) {
+            MutexLockGuard lock(mutex_);
+            for ( size_t i = 0; i < threads.size(); ++i ) {
+                if ( retired[i] ) {
+                    threads_.erase(std::find(threads_.begin(), threads_.end(), threads[i]));
+                }
+            }
         }
-
-        buffers_to_write.clear();
+        threads.clear();
         output.Flush();
     }
-    // 最后LogFile刷写
-    output.Flush();
+
+    // 后台线程退出之后，等待buffer的生产者不再等
+    MutexLockGuard lock(pool_mutex_);
+    pool_cond_.NotifyAll();
 }
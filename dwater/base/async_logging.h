@@ -1,8 +1,16 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.03.21
+// Last modified:   2021.04.17
 // Filename:        async_logging.h
 // Descripton:      异步日志
+//
+// 每个写日志的线程有自己的buffer，Append()不加锁，只有一次原子交换。写满的buffer
+// 放到这个线程自己的无锁队列中，后台线程定期收集所有线程的buffer，同一个线程的
+// 日志保持顺序，不同线程的buffer按开始的时间合并后写到LogFile。Logger的二进制
+// 模式在IO线程只记录原始数据，由后台线程在写文件之前格式化。
+//
+// 所有的buffer在Start()的时候预先分配好，总数固定。后台线程写文件跟不上，
+// buffer用完的时候按OverflowPolicy处理，丢掉和等待的行数都有计数
 
 #ifndef DWATER_SRC_BASE_ASYNC_LOGGING_H
 #define DWATER_SRC_BASE_ASYNC_LOGGING_H
@@ -10,62 +18,128 @@
 #include "dwater/base/blocking_queue.h"
 #include "dwater/base/bounded_blocking_queue.h"
 #include "dwater/base/count_down_latch.h"
+#include "dwater/base/log_file.h"
+#include "dwater/base/logging.h"
 #include "dwater/base/mutex.h"
 #include "dwater/base/thread.h"
 #include "dwater/base/log_stream.h"
 
 #include <atomic>
+#include <memory>
 #include <vector>
 
 namespace dwater {
 
 class AsyncLogging : noncopyable {
 public:
+    /// buffer用完的时候怎么处理新的日志
+    enum OverflowPolicy {
+        kblock,             // 等后台线程写完还回buffer，不丢日志
+        kdrop_newest,       // 丢掉新的日志
+        kdrop_below_warn,   // 留一部分buffer给WARN及以上，低于WARN的丢掉，WARN及以上
+                            // 连留的buffer都用完了就等待
+        kspill              // 临时分配有上限的spill buffer，写完就释放，再满了丢掉新的
+    };
+
+    static const int kdefault_max_buffers = 64; // 每个1MB
+
     AsyncLogging(const string& basename, off_t rool_size, int flush_interval = 3);
 
-    ~AsyncLogging() {
-        if ( running_ ) {
-            Stop(); 
-        }
-    }
+    ~AsyncLogging();
 
-    // 所有的LOG_xx最终都会调用这个函数，尽管往两个buffer些数据
+    // 所有的LOG_xx最终都会调用这个函数，写到调用线程自己的buffer中，
+    // 日志的级别是Logger::OutputLevel()
     void Append(const char* logline, int len);
 
-    void Start() {
-        running_ = true;
-        thread_.Start();
-        latch_.Wait();
+    void Append(const char* logline, int len, Logger::LogLevel level);
+
+    /// 必须在Start()之前设置，spill_buffers只对kspill有用
+    void SetOverflowPolicy(OverflowPolicy policy, int spill_buffers = 0) {
+        policy_ = policy;
+        max_spill_ = spill_buffers;
+    }
+
+    /// 预先分配的buffer数，必须在Start()之前设置
+    void SetMaxBuffers(int max_buffers) {
+        max_buffers_ = max_buffers;
+    }
+
+    /// 因为buffer不够丢掉的行数
+    int64_t DroppedLines() const { return dropped_lines_.load(std::memory_order_relaxed); }
+
+    /// 等待过buffer的行数
+    int64_t BlockedLines() const { return blocked_lines_.load(std::memory_order_relaxed); }
+
+    /// 写文件的方式，默认不压缩，必须在Start()之前设置
+    void SetSinkFactory(const LogSinkFactory& factory) {
+        sink_factory_ = factory;
+    }
+
+    /// 日志文件滚动之后在后台线程中调用，必须在Start()之前设置
+    void SetRollCallback(const LogFile::RollCallback& cb) {
+        roll_callback_ = cb;
     }
 
-    void Stop() NO_THREAD_SAFETY_ANALYSIS {
+    void Start();
+
+    void Stop() {
         running_ = false;
-        cond_.Notify();
+        Wake();
         thread_.Join();
     }
 
 private:
-    void ThreadFunc();
+    struct LogBuffer;
+    struct ThreadBuffer;
+    typedef std::shared_ptr<ThreadBuffer> ThreadBufferPtr;
+    typedef std::vector<LogBuffer*> LogBufferList;
+
+    /// 当前线程的buffer，第一次调用的时候注册到threads_中
+    ThreadBuffer* LocalBuffer();
+
+    /// 从buffer池中取一个空的buffer，按照policy_处理没有的情况，返回NULL表示丢掉
+    LogBuffer* TakeBuffer(Logger::LogLevel level);
+
+    /// 写完的buffer还回去，spill buffer直接释放
+    void ReturnBuffers(const LogBufferList& buffers);
 
-    typedef dwater::detail::FixedBuffer<dwater::detail::k_large_buffer> Buffer;
-    typedef std::vector<std::unique_ptr<Buffer>> BufferVector;
-    typedef BufferVector::value_type BufferPtr;
+    /// kdrop_below_warn时低于WARN的日志不能用的buffer数
+    int WarnReserve() const;
+
+    /// 唤醒后台线程
+    void Wake();
+
+    /// 取出一个线程所有有数据的buffer，按写的顺序排好，没有数据的放到empty_buffers
+    void Collect(ThreadBuffer* thread, LogBufferList* buffers, LogBufferList* empty_buffers);
+
+    void ThreadFunc();
 
     const int flush_interval_;
     std::atomic<bool> running_;
     const string basename_;
     const off_t roll_size_;
+    const int id_; // 区分不同的AsyncLogging对象，线程局部的buffer属于某一个对象
+    LogSinkFactory sink_factory_;
+    LogFile::RollCallback roll_callback_;
+    OverflowPolicy policy_;
+    int max_buffers_;
+    int max_spill_;
+    std::atomic<int64_t> dropped_lines_;
+    std::atomic<int64_t> blocked_lines_;
+    std::atomic<int> pool_free_; // pool_.size()，不加锁的时候看一下还剩多少
     dwater::Thread thread_;
     dwater::CountDownLatch latch_;
     dwater::MutexLock mutex_;
     dwater::Condition cond_ GUARDED_BY(mutex_);
-    BufferPtr curr_buffer_ GUARDED_BY(mutex_);
-    BufferPtr next_buffer_ GUARDED_BY(mutex_);
-    BufferVector buffers_ GUARDED_BY(mutex_);
+    bool woken_ GUARDED_BY(mutex_);
+    std::vector<ThreadBufferPtr> threads_ GUARDED_BY(mutex_);
+    dwater::MutexLock pool_mutex_; // 要同时拿两把锁的时候先拿pool_mutex_再拿mutex_
+    dwater::Condition pool_cond_ GUARDED_BY(pool_mutex_);
+    LogBufferList pool_ GUARDED_BY(pool_mutex_);
+    int spilled_ GUARDED_BY(pool_mutex_); // 还没有释放的spill buffer
 }; // class AsyncLogging
 
-} // namespace dwater 
+} // namespace dwater
 
 #endif // DWATER_SRC_BASE_ASYNC_LOGGING_H
 
-
@@ -20,6 +20,8 @@ class AtomicIntegerT : dwater::noncopyable {
 private:
     volatile T value_; // shared value_
 public:
+    AtomicIntegerT() : value_(0) {}
+
     T Get() {
         return __sync_val_compare_and_swap(&value_, 0, 0);
     }
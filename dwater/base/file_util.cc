@@ -7,8 +7,11 @@
 #include "dwater/base/file_util.h"
 #include "dwater/base/logging.h"
 
+#include <algorithm>
+
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <assert.h>
@@ -60,6 +63,82 @@ size_t file_util::AppendFile::Write(const char* logline, size_t len) {
     return  ::fwrite_unlocked(logline, 1, len, fp_);
 }
 
+file_util::PreallocAppendFile::PreallocAppendFile(StringArg filename, off_t prealloc_size)
+    :   fd_(::open(filename.Cstr(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644)),
+        buffer_(NULL),
+        used_(0),
+        offset_(0),
+        written_bytes_(0) {
+    assert(fd_ >= 0);
+    void* buffer = NULL;
+    int ret = ::posix_memalign(&buffer, 4096, kbuffer_size);
+    assert(ret == 0); (void)ret;
+    buffer_ = static_cast<char*>(buffer);
+    offset_ = ::lseek(fd_, 0, SEEK_END); // 和AppendFile一样，已经存在的文件接着写
+    // 文件系统不支持的时候就和普通文件一样
+    if ( prealloc_size > offset_ &&
+         ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, offset_, prealloc_size - offset_) != 0 ) {
+        fprintf(stderr, "PreallocAppendFile fallocate failed %s\n", dwater::strerror_tl(errno));
+    }
+}
+
+file_util::PreallocAppendFile::~PreallocAppendFile() {
+    WriteBuffer();
+    if ( ::ftruncate(fd_, offset_ + used_) != 0 ) {
+        fprintf(stderr, "PreallocAppendFile ftruncate failed %s\n", dwater::strerror_tl(errno));
+    }
+    ::close(fd_);
+    ::free(buffer_);
+}
+
+void file_util::PreallocAppendFile::Append(const char* logline, size_t len) {
+    written_bytes_ += len;
+    // 缓冲区是空的时候，整块的数据直接写，不用再复制一次
+    if ( used_ == 0 && len >= kbuffer_size ) {
+        size_t n = len / kbuffer_size * kbuffer_size;
+        WriteAt(logline, n, offset_);
+        offset_ += n;
+        logline += n;
+        len -= n;
+    }
+    while ( len > 0 ) {
+        size_t n = std::min(len, kbuffer_size - used_);
+        memcpy(buffer_ + used_, logline, n);
+        used_ += n;
+        logline += n;
+        len -= n;
+        if ( used_ == kbuffer_size ) {
+            WriteBuffer();
+            offset_ += used_;
+            used_ = 0;
+        }
+    }
+}
+
+void file_util::PreallocAppendFile::Flush() {
+    WriteBuffer();
+}
+
+void file_util::PreallocAppendFile::WriteBuffer() {
+    WriteAt(buffer_, used_, offset_);
+}
+
+void file_util::PreallocAppendFile::WriteAt(const char* data, size_t len, off_t offset) {
+    size_t n = 0;
+    while ( n < len ) {
+        ssize_t x = ::pwrite(fd_, data + n, len - n, offset + n);
+        if ( x < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( x <= 0 ) {
+            fprintf(stderr, "PreallocAppendFile::WriteBuffer() failed %s\n",
+                    dwater::strerror_tl(errno));
+            break;
+        }
+        n += x;
+    }
+}
+
 file_util::ReadSmallFile::ReadSmallFile(StringArg filename)
     :   fd_(::open(filename.Cstr(), O_RDONLY | O_CLOEXEC)),
         err_(0) {
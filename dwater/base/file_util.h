@@ -12,6 +12,7 @@
 #include "dwater/base/string_piece.h"
 #include "dwater/base/noncopable.h"
 
+#include <stdio.h>
 #include <sys/types.h> // for type off_t
 
 namespace dwater {
@@ -68,6 +69,9 @@ public:
 
     off_t WriteBytes() const { return written_bytes_; }
 
+    /// 之前的fwrite和fflush都没有出错
+    bool Ok() const { return ::ferror(fp_) == 0; }
+
 private:
     size_t Write(const char* logline, size_t len);
 
@@ -78,6 +82,40 @@ private:
 
 }; // class AppendFile
 
+///
+/// 和AppendFile一样只追加，打开的时候用fallocate预留prealloc_size的空间(不改变
+/// 文件长度)，写的时候文件系统不用再分配extent。数据先放在按页对齐的缓冲区中，
+/// 每次pwrite一整块，Flush()写不满的一块但是数据留在缓冲区，下次从同一个位置
+/// 重写，所以每次写都是对齐的。析构的时候ftruncate到实际长度，释放没用到的空间
+///
+class PreallocAppendFile : noncopyable {
+public:
+    static const size_t kbuffer_size = 1024 * 1024;
+
+public:
+    PreallocAppendFile(StringArg filename, off_t prealloc_size);
+
+    ~PreallocAppendFile();
+
+    void Append(const char* logline, size_t len);
+
+    void Flush();
+
+    off_t WriteBytes() const { return written_bytes_; }
+
+private:
+    void WriteBuffer();
+
+    void WriteAt(const char* data, size_t len, off_t offset);
+
+private:
+    int     fd_;
+    char*   buffer_;
+    size_t  used_;          // 缓冲区中数据的长度
+    off_t   offset_;        // 缓冲区对应的文件位置
+    off_t   written_bytes_;
+}; // class PreallocAppendFile
+
 } // namespace file_util
 
 } // namespace dwater
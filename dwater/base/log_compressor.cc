@@ -0,0 +1,91 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        log_compressor.cc
+// Descripton:      log_compressor.h的实现
+
+#include "dwater/base/log_compressor.h"
+#include "dwater/base/current_thread.h"
+#include "dwater/base/log_sink.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace dwater;
+
+LogCompressor::LogCompressor(int level)
+    :   level_(level),
+        running_(false),
+        compressed_(0),
+        queue_(),
+        thread_(std::bind(&LogCompressor::ThreadFunc, this), "LogCompressor") {
+}
+
+LogCompressor::~LogCompressor() {
+    if ( running_ ) {
+        Stop();
+    }
+}
+
+void LogCompressor::Start() {
+    running_ = true;
+    thread_.Start();
+}
+
+void LogCompressor::Stop() {
+    running_ = false;
+    queue_.Put(string());
+    thread_.Join();
+}
+
+void LogCompressor::Compress(const string& filename) {
+    if ( !filename.empty() ) {
+        queue_.Put(filename);
+    }
+}
+
+// 用GzipSink写，和边写边压缩的格式一样
+bool LogCompressor::CompressFile(const string& filename, int level) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd < 0 ) {
+        return false;
+    }
+    string gz_filename = filename + ".gz";
+    ::unlink(gz_filename.c_str()); // 上次没有压缩完的
+    bool ok = true;
+    {
+        GzipSink sink(gz_filename, level);
+        char buf[64 * 1024];
+        ssize_t n;
+        while ( (n = ::read(fd, buf, sizeof buf)) > 0 && sink.Ok() ) {
+            sink.Append(buf, n);
+        }
+        // 读完了，并且压缩的数据都写进了.gz文件，才能删除原文件
+        ok = n == 0 && sink.Finish();
+    }
+    ::close(fd);
+    if ( ok ) {
+        ::unlink(filename.c_str());
+    } else {
+        ::unlink(gz_filename.c_str());
+    }
+    return ok;
+}
+
+void LogCompressor::ThreadFunc() {
+    // Linux上nice值是每个线程的，只降低这个线程
+    ::setpriority(PRIO_PROCESS, current_thread::Tid(), 10);
+    for ( ;; ) {
+        string filename = queue_.Take();
+        if ( filename.empty() ) {
+            break;
+        }
+        if ( CompressFile(filename, level_) ) {
+            compressed_.fetch_add(1);
+        } else {
+            fprintf(stderr, "LogCompressor failed to compress %s\n", filename.c_str());
+        }
+    }
+}
@@ -0,0 +1,55 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        log_compressor.h
+// Descripton:      在单独的线程中压缩已经滚动的日志文件
+//
+// 用法：LogFile(或AsyncLogging)的滚动回调设成Compress()，写完的文件在这个线程中
+// 压缩成filename.gz再删除原文件，不占用写日志的线程。线程的优先级比较低
+
+#ifndef DWATER_SRC_BASE_LOG_COMPRESSOR_H
+#define DWATER_SRC_BASE_LOG_COMPRESSOR_H
+
+#include "dwater/base/blocking_queue.h"
+#include "dwater/base/thread.h"
+#include "dwater/base/types.h"
+
+#include <atomic>
+
+namespace dwater {
+
+class LogCompressor : noncopyable {
+public:
+    static const int kdefault_level = 6;
+
+    explicit LogCompressor(int level = kdefault_level);
+
+    ~LogCompressor();
+
+    void Start();
+
+    /// 压缩完已经排队的文件再返回
+    void Stop();
+
+    /// 任何线程都可以调用，只是放到队列中
+    void Compress(const string& filename);
+
+    /// 压缩好的文件数
+    int64_t Compressed() const { return compressed_.load(); }
+
+    /// 同步压缩一个文件，成功之后删除原文件
+    static bool CompressFile(const string& filename, int level = kdefault_level);
+
+private:
+    void ThreadFunc();
+
+    const int level_;
+    bool running_;
+    std::atomic<int64_t> compressed_;
+    BlockingQueue<string> queue_; // 空字符串表示退出
+    Thread thread_;
+}; // class LogCompressor
+
+} // namespace dwater
+
+#endif // DWATER_SRC_BASE_LOG_COMPRESSOR_H
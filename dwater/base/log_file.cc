@@ -6,7 +6,6 @@
 
 #include "dwater/base/log_file.h"
 
-#include "dwater/base/file_util.h"
 #include "dwater/base/process_info.h"
 
 #include <assert.h>
@@ -20,6 +19,16 @@ LogFile::LogFile(const string& basename,
                  bool thread_safe,
                  int flush_interval,
                  int check_every_N)
+    : LogFile(basename, roll_size, FileSinkFactory(), thread_safe,
+              flush_interval, check_every_N) {
+}
+
+LogFile::LogFile(const string& basename,
+                 off_t roll_size,
+                 const LogSinkFactory& sink_factory,
+                 bool thread_safe,
+                 int flush_interval,
+                 int check_every_N)
     : basename_(basename),
       roll_size_(roll_size),
       flush_interval_(flush_interval),
@@ -28,7 +37,8 @@ LogFile::LogFile(const string& basename,
       mutex_(thread_safe ? new MutexLock : NULL),
       start_of_period_(0),
       last_roll_(0),
-      last_flush_(0) {
+      last_flush_(0),
+      sink_factory_(sink_factory) {
     assert(basename.find('/') == string::npos);
     RollFile();
 }
@@ -85,7 +95,11 @@ bool LogFile::RollFile() {
         last_roll_ = now;
         last_flush_ = now;
         start_of_period_ = start;
-        file_.reset(new file_util::AppendFile(filename));
+        string finished = file_ ? file_->Filename() : string();
+        file_.reset(sink_factory_(filename)); // 旧文件析构的时候关闭
+        if ( !finished.empty() && roll_callback_ ) {
+            roll_callback_(finished);
+        }
         return true;
     }
     return false;
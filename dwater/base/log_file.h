@@ -8,26 +8,35 @@
 #ifndef DWATER_SRC_BASE_LOG_FILE_H
 #define DWATER_SRC_BASE_LOG_FILE_H
 
+#include "dwater/base/log_sink.h"
 #include "dwater/base/mutex.h"
 #include "dwater/base/types.h"
 
+#include <functional>
 #include <memory>
 
 namespace dwater {
 
-namespace file_util {
-class AppendFile;
-} // namespace file_util
-
 class LogFile : noncopyable {
 public:
+    /// 滚动之后调用，参数是写完的文件名，例如交给LogCompressor压缩
+    typedef std::function<void (const string& filename)> RollCallback;
+
+    LogFile(const string& basename,
+            off_t roll_size,
+            bool thread_safe = true,
+            int flush_interval = 3,
+            int check_every_n = 1024);
     LogFile(const string& basename,
             off_t roll_size,
+            const LogSinkFactory& sink_factory,
             bool thread_safe = true,
             int flush_interval = 3,
             int check_every_n = 1024);
     ~LogFile();
 
+    void SetRollCallback(const RollCallback& cb) { roll_callback_ = cb; }
+
     void Append(const char* logline, int len);
 
     void Flush();
@@ -51,7 +60,9 @@ private:
     time_t start_of_period_; // 开始记录日志的时间
     time_t last_roll_;  // 上次滚动日志时间
     time_t last_flush_; // 上次写到文件的时间
-    std::unique_ptr<file_util::AppendFile> file_; // 中间有一个buffer
+    const LogSinkFactory sink_factory_;
+    RollCallback roll_callback_;
+    std::unique_ptr<LogSink> file_; // 中间有一个buffer
 
     const static int kroll_per_seconds_ = 60*60*24; // 一天滚动一次日志
 }; // class LogFile
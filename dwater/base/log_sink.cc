@@ -0,0 +1,143 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        log_sink.cc
+// Descripton:      log_sink.h的实现
+
+#include "dwater/base/log_sink.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+#include <zlib.h>
+
+using namespace dwater;
+
+LogSink::~LogSink() = default;
+
+FileSink::FileSink(const string& filename)
+    :   LogSink(filename),
+        file_(filename) {
+}
+
+void FileSink::Append(const char* data, size_t len) {
+    file_.Append(data, len);
+}
+
+void FileSink::Flush() {
+    file_.Flush();
+}
+
+off_t FileSink::WriteBytes() const {
+    return file_.WriteBytes();
+}
+
+PreallocFileSink::PreallocFileSink(const string& filename, off_t prealloc_size)
+    :   LogSink(filename),
+        file_(filename, prealloc_size) {
+}
+
+void PreallocFileSink::Append(const char* data, size_t len) {
+    file_.Append(data, len);
+}
+
+void PreallocFileSink::Flush() {
+    file_.Flush();
+}
+
+off_t PreallocFileSink::WriteBytes() const {
+    return file_.WriteBytes();
+}
+
+GzipSink::GzipSink(const string& filename, int level)
+    :   LogSink(filename),
+        file_(filename),
+        stream_(new z_stream_s),
+        ok_(true) {
+    stream_->zalloc = Z_NULL;
+    stream_->zfree = Z_NULL;
+    stream_->opaque = Z_NULL;
+    stream_->next_in = Z_NULL;
+    stream_->avail_in = 0;
+    // windowBits加16输出gzip格式，memLevel 8是zlib的默认值
+    int ret = ::deflateInit2(stream_.get(), level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    if ( ret != Z_OK ) {
+        fprintf(stderr, "GzipSink deflateInit2() failed %d %s\n", ret, filename.c_str());
+        stream_.reset();
+        ok_ = false;
+    }
+}
+
+GzipSink::~GzipSink() {
+    Finish();
+}
+
+void GzipSink::Append(const char* data, size_t len) {
+    // avail_in只有32位
+    while ( stream_ && len > 0 ) {
+        uInt n = static_cast<uInt>(std::min(len, static_cast<size_t>(1 << 30)));
+        stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream_->avail_in = n;
+        Deflate(Z_NO_FLUSH);
+        data += n;
+        len -= n;
+    }
+}
+
+void GzipSink::Flush() {
+    if ( stream_ ) {
+        Deflate(Z_SYNC_FLUSH);
+    }
+    file_.Flush();
+}
+
+bool GzipSink::Finish() {
+    if ( stream_ ) {
+        Deflate(Z_FINISH);
+        ::deflateEnd(stream_.get());
+        stream_.reset();
+        file_.Flush();
+    }
+    return Ok();
+}
+
+off_t GzipSink::WriteBytes() const {
+    return file_.WriteBytes();
+}
+
+// 输出缓冲区没有写满说明这次的输入都处理完了
+void GzipSink::Deflate(int flush) {
+    do {
+        stream_->next_out = reinterpret_cast<Bytef*>(out_);
+        stream_->avail_out = sizeof out_;
+        int ret = ::deflate(stream_.get(), flush);
+        if ( ret == Z_STREAM_ERROR ) {
+            fprintf(stderr, "GzipSink::Deflate() failed %s\n", Filename().c_str());
+            ok_ = false;
+            return;
+        }
+        size_t n = sizeof out_ - stream_->avail_out;
+        if ( n > 0 ) {
+            file_.Append(out_, n);
+        }
+    } while ( stream_->avail_out == 0 );
+}
+
+LogSinkFactory dwater::FileSinkFactory() {
+    return [](const string& filename) -> LogSink* {
+        return new FileSink(filename);
+    };
+}
+
+LogSinkFactory dwater::PreallocFileSinkFactory(off_t prealloc_size) {
+    return [prealloc_size](const string& filename) -> LogSink* {
+        return new PreallocFileSink(filename, prealloc_size);
+    };
+}
+
+LogSinkFactory dwater::GzipSinkFactory(int level) {
+    return [level](const string& filename) -> LogSink* {
+        return new GzipSink(filename + ".gz", level);
+    };
+}
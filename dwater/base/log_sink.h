@@ -0,0 +1,122 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        log_sink.h
+// Descripton:      LogFile写数据的目标，默认直接写文件，也可以边写边用gzip压缩
+//
+// LogFile每次滚动都通过LogSinkFactory打开一个新的LogSink，只在写日志的线程
+// (AsyncLogging的后台线程)中使用，不需要加锁
+
+#ifndef DWATER_SRC_BASE_LOG_SINK_H
+#define DWATER_SRC_BASE_LOG_SINK_H
+
+#include "dwater/base/file_util.h"
+#include "dwater/base/types.h"
+
+#include <functional>
+#include <memory>
+
+struct z_stream_s;
+
+namespace dwater {
+
+class LogSink : noncopyable {
+public:
+    explicit LogSink(const string& filename) : filename_(filename) {}
+
+    virtual ~LogSink();
+
+    virtual void Append(const char* data, size_t len) = 0;
+
+    virtual void Flush() = 0;
+
+    /// 已经写到文件中的字节数，LogFile用来判断是否要滚动
+    virtual off_t WriteBytes() const = 0;
+
+    const string& Filename() const { return filename_; }
+
+private:
+    const string filename_;
+}; // class LogSink
+
+/// 参数是LogFile生成的文件名，返回的LogSink由LogFile释放
+typedef std::function<LogSink* (const string& filename)> LogSinkFactory;
+
+///
+/// 不压缩，直接写文件
+///
+class FileSink : public LogSink {
+public:
+    explicit FileSink(const string& filename);
+
+    void Append(const char* data, size_t len) override;
+
+    void Flush() override;
+
+    off_t WriteBytes() const override;
+
+private:
+    file_util::AppendFile file_;
+}; // class FileSink
+
+///
+/// 每个文件先预留prealloc_size的空间，用对齐的pwrite写，见PreallocAppendFile
+///
+class PreallocFileSink : public LogSink {
+public:
+    PreallocFileSink(const string& filename, off_t prealloc_size);
+
+    void Append(const char* data, size_t len) override;
+
+    void Flush() override;
+
+    off_t WriteBytes() const override;
+
+private:
+    file_util::PreallocAppendFile file_;
+}; // class PreallocFileSink
+
+///
+/// 写之前用zlib压缩成gzip格式，Flush()的时候Z_SYNC_FLUSH，已经写到文件的
+/// 部分可以直接用zcat看。WriteBytes()是压缩之后的字节数。
+/// 出错之后不再写，Finish()或者Ok()返回false
+///
+class GzipSink : public LogSink {
+public:
+    static const int kdefault_level = 1; // 日志压缩率已经很高，优先保证速度
+
+    explicit GzipSink(const string& filename, int level = kdefault_level);
+
+    ~GzipSink() override;
+
+    void Append(const char* data, size_t len) override;
+
+    void Flush() override;
+
+    off_t WriteBytes() const override;
+
+    /// 写gzip的结尾并且fflush，之后不能再Append()。析构的时候没有调用就自动调用
+    bool Finish();
+
+    bool Ok() const { return ok_ && file_.Ok(); }
+
+private:
+    void Deflate(int flush);
+
+    file_util::AppendFile           file_;
+    std::unique_ptr<z_stream_s>     stream_;    // 初始化失败或者Finish()之后是空的
+    bool                            ok_;
+    char                            out_[64 * 1024];
+}; // class GzipSink
+
+LogSinkFactory FileSinkFactory();
+
+/// prealloc_size一般是LogFile的roll_size，再加上一次写的最大长度
+LogSinkFactory PreallocFileSinkFactory(off_t prealloc_size);
+
+/// 文件名后面加上".gz"
+LogSinkFactory GzipSinkFactory(int level = GzipSink::kdefault_level);
+
+} // namespace dwater
+
+#endif // DWATER_SRC_BASE_LOG_SINK_H
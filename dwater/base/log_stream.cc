@@ -58,13 +58,14 @@ size_t ConvertHex(char buf[], uintptr_t value) {
         i /= 16;
         *p++ = digits_hex[lsd];
     } while ( i != 0 );
-    *p++ = '\0';
+    *p = '\0';
     std::reverse(buf, p);
     return p - buf;
 }
 
 template class FixedBuffer<k_small_buffer>;
 template class FixedBuffer<k_large_buffer>;
+template class FixedBuffer<k_thread_buffer>;
 
 } // namespace detail
 
@@ -211,37 +212,71 @@ LogStream& LogStream::operator<<(unsigned short  v) {
 }
 
 LogStream& LogStream::operator<<(int v) {
+    if ( binary_ ) {
+        int32_t value = v;
+        AppendBinary(kint_tag, &value, sizeof value);
+        return *this;
+    }
     FormatInteger(v);
     return *this;
 }
 
 LogStream& LogStream::operator<<(unsigned int v) {
+    if ( binary_ ) {
+        uint32_t value = v;
+        AppendBinary(kuint_tag, &value, sizeof value);
+        return *this;
+    }
     FormatInteger(v);
     return *this;
 }
 
 LogStream& LogStream::operator<<(long v) {
+    if ( binary_ ) {
+        int64_t value = v;
+        AppendBinary(kint64_tag, &value, sizeof value);
+        return *this;
+    }
     FormatInteger(v);
     return *this;
 }
 
 LogStream& LogStream::operator<<(unsigned long v) {
+    if ( binary_ ) {
+        uint64_t value = v;
+        AppendBinary(kuint64_tag, &value, sizeof value);
+        return *this;
+    }
     FormatInteger(v);
     return *this;
 }
 
 LogStream& LogStream::operator<<(long long v) {
+    if ( binary_ ) {
+        int64_t value = v;
+        AppendBinary(kint64_tag, &value, sizeof value);
+        return *this;
+    }
     FormatInteger(v);
     return *this;
 }
 
 LogStream& LogStream::operator<<(unsigned long long v) {
+    if ( binary_ ) {
+        uint64_t value = v;
+        AppendBinary(kuint64_tag, &value, sizeof value);
+        return *this;
+    }
     FormatInteger(v);
     return *this;
 }
 
 LogStream& LogStream::operator<<(const void* p) {
     uintptr_t v = reinterpret_cast<uintptr_t>(p);
+    if ( binary_ ) {
+        AppendBinary(kpointer_tag, &v, sizeof v);
+        return *this;
+    }
     if ( buffer_.Avail() >= k_max_numeric_size ) {
         char* buf = buffer_.Current();
         buf[0] = '0';
@@ -253,6 +288,10 @@ LogStream& LogStream::operator<<(const void* p) {
 }
 
 LogStream& LogStream::operator<<(double v) {
+    if ( binary_ ) {
+        AppendBinary(kdouble_tag, &v, sizeof v);
+        return *this;
+    }
     if ( buffer_.Avail() >= k_max_numeric_size ) {
         int len = snprintf(buffer_.Current(), k_max_numeric_size, "%.12g", v);
         buffer_.Add(len);
@@ -260,6 +299,85 @@ LogStream& LogStream::operator<<(double v) {
     return *this;
 }
 
+namespace {
+
+template<typename T>
+bool ReadValue(const char** p, const char* end, T* value) {
+    if ( static_cast<size_t>(end - *p) < sizeof(T) ) {
+        return false;
+    }
+    memcpy(value, *p, sizeof(T));
+    *p += sizeof(T);
+    return true;
+}
+
+template<typename T>
+bool DecodeValue(const char** p, const char* end, LogStream* stream) {
+    T value;
+    if ( !ReadValue(p, end, &value) ) {
+        return false;
+    }
+    *stream << value;
+    return true;
+}
+
+} // namespace
+
+// 每种类型用和文本模式相同的operator<<输出，保证两种模式的结果一样
+bool LogStream::DecodeBinary(const char* data, int len) {
+    assert(!binary_);
+    const char* p = data;
+    const char* end = data + len;
+    while ( p < end ) {
+        bool ok = false;
+        switch ( *p++ ) {
+        case kbool_tag:
+            ok = DecodeValue<bool>(&p, end, this);
+            break;
+        case kchar_tag:
+            ok = DecodeValue<char>(&p, end, this);
+            break;
+        case kint_tag:
+            ok = DecodeValue<int32_t>(&p, end, this);
+            break;
+        case kuint_tag:
+            ok = DecodeValue<uint32_t>(&p, end, this);
+            break;
+        case kint64_tag:
+            ok = DecodeValue<long long>(&p, end, this);
+            break;
+        case kuint64_tag:
+            ok = DecodeValue<unsigned long long>(&p, end, this);
+            break;
+        case kpointer_tag: {
+            uintptr_t v;
+            ok = ReadValue(&p, end, &v);
+            if ( ok ) {
+                *this << reinterpret_cast<const void*>(v);
+            }
+            break;
+        }
+        case kdouble_tag:
+            ok = DecodeValue<double>(&p, end, this);
+            break;
+        case kstring_tag: {
+            uint16_t size;
+            ok = ReadValue(&p, end, &size) && end - p >= size;
+            if ( ok ) {
+                buffer_.Append(p, size);
+                p += size;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if ( !ok ) {
+            return false;
+        }
+    }
+    return true;
+}
 
 template<typename T>
 Format::Format(const char* fmt, T val) {
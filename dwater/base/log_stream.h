@@ -10,6 +10,7 @@
 #include "dwater/base/types.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 namespace dwater {
@@ -18,6 +19,7 @@ namespace detail {
 
 const int k_small_buffer = 4000;
 const int k_large_buffer = 4000 * 1000;
+const int k_thread_buffer = 1000 * 1000; // AsyncLogging每个线程的buffer
 
 // FixedBuffer is used to store log imformation by LogStream
 template<int SIZE>
@@ -61,7 +63,7 @@ public:
 
     // 返回可以写的长度
     int Avail() const { 
-        return static_cast<int>(end() - data_);
+        return static_cast<int>(end() - curr_);
     }
 
     void Add(size_t len) {
@@ -93,12 +95,29 @@ public:
     
 } // namespace detail
 
+///
+/// 二进制模式下每个参数写成一个字节的类型加上原始的字节，不做格式化，
+/// 字符串是类型加上两个字节的长度和内容。DecodeBinary()再按文本模式的格式输出
+///
 class LogStream : noncopyable {
 public:
     typedef detail::FixedBuffer<detail::k_small_buffer> Buffer;
 
+    enum BinaryTag {
+        kbool_tag = 1,
+        kchar_tag,
+        kint_tag,
+        kuint_tag,
+        kint64_tag,
+        kuint64_tag,
+        kpointer_tag,
+        kdouble_tag,
+        kstring_tag
+    };
+
 private:
     Buffer buffer_;
+    bool   binary_;
     static const int k_max_numeric_size = 32;
 
 private:
@@ -107,9 +126,38 @@ private:
 
     void StaticCheck();
 
+    void AppendBinary(char tag, const void* value, size_t len) {
+        if ( static_cast<size_t>(buffer_.Avail()) > len + 1 ) {
+            char* p = buffer_.Current();
+            *p = tag;
+            memcpy(p + 1, value, len);
+            buffer_.Add(len + 1);
+        }
+    }
+
+    // 和文本模式一样，放不下的时候整个丢掉
+    void AppendString(const char* data, size_t len) {
+        if ( !binary_ ) {
+            buffer_.Append(data, len);
+        } else if ( static_cast<size_t>(buffer_.Avail()) > len + 3 ) {
+            uint16_t size = static_cast<uint16_t>(len);
+            char* p = buffer_.Current();
+            *p = kstring_tag;
+            memcpy(p + 1, &size, sizeof size);
+            memcpy(p + 3, data, len);
+            buffer_.Add(len + 3);
+        }
+    }
+
 public:
+    LogStream() : binary_(false) {}
+
     LogStream& operator<<(bool v) {
-        buffer_.Append(v ? "1" : "0", 1);
+        if ( binary_ ) {
+            AppendBinary(kbool_tag, &v, sizeof v);
+        } else {
+            buffer_.Append(v ? "1" : "0", 1);
+        }
         return *this;
     }
 
@@ -133,15 +181,19 @@ public:
     LogStream& operator<<(double);
 
     LogStream& operator<<(char v) {
-        buffer_.Append(&v, 1);
+        if ( binary_ ) {
+            AppendBinary(kchar_tag, &v, sizeof v);
+        } else {
+            buffer_.Append(&v, 1);
+        }
         return *this;
     }
 
     LogStream& operator<<(const char* str) {
         if ( str ) {
-            buffer_.Append(str, strlen(str));
+            AppendString(str, strlen(str));
         } else {
-            buffer_.Append("(null)", 6);
+            AppendString("(null)", 6);
         }
         return *this;
     }
@@ -151,12 +203,12 @@ public:
     }
     
     LogStream& operator<<(const string& v) {
-        buffer_.Append(v.c_str(), v.size());
+        AppendString(v.c_str(), v.size());
         return *this;
     }
 
     LogStream& operator<<(const StringPiece& v) {
-        buffer_.Append(v.Data(), v.Size());
+        AppendString(v.Data(), v.Size());
         return *this;
     }
 
@@ -166,9 +218,31 @@ public:
     }
 
     void Append(const char* data, int len) {
-        buffer_.Append(data, len);
+        AppendString(data, len);
+    }
+
+    void SetBinary(bool binary) {
+        binary_ = binary;
+    }
+
+    bool Binary() const {
+        return binary_;
     }
 
+    /// 直接占用len个字节，不加类型，Logger用来写二进制条目的头部。放不下时返回NULL
+    char* Reserve(int len) {
+        if ( buffer_.Avail() <= len ) {
+            return NULL;
+        }
+        char* p = buffer_.Current();
+        buffer_.Add(len);
+        return p;
+    }
+
+    /// 把二进制模式写的参数[data, data+len)按文本模式的格式写到这个LogStream，
+    /// 数据不完整时返回false
+    bool DecodeBinary(const char* data, int len);
+
     const Buffer& GetBuffer() const {
         return buffer_;
     }
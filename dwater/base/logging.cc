@@ -9,17 +9,20 @@
 #include "dwater/base/timestamp.h"
 #include "dwater/base/time_zone.h"
 
+#include <atomic>
+#include <sstream>
+
 #include <errno.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
-#include <sstream>
-
 namespace dwater {
 
 __thread char   t_errnobuf[512];
 __thread char   t_time[64];
 __thread time_t t_last_second;     
+__thread Logger::LogLevel t_output_level = Logger::INFO;
 
 
 const char* strerror_tl(int saved_errno) {
@@ -79,27 +82,28 @@ void DefaultFlush() {
 Logger::OutputFunc g_output = DefaultOutput;
 Logger::FlushFunc g_flush = DefaultFlush;
 TimeZone g_log_timezone;
+bool g_log_binary = false;
 
-} // namespace dwater
-
-using namespace dwater;
+// 注册过的LogSite，只增加不删除，读的时候不用加锁
+std::atomic<uint32_t> g_site_count(0);
+std::atomic<const LogSite*> g_sites[LogSite::kmax_sites];
 
-Logger::Impl::Impl(LogLevel level, int saved_errno, const SourceFile& file, int line)
-    :   time_(Timestamp::Now()),
-        stream_(),
-        line_(line),
-        basename_(file) {
-    FormatTime();
-    current_thread::Tid();
-    stream_ << T(current_thread::TidString(), current_thread::TidStringLength());
-    stream_ << T(LogLevelName[level], 6);
-    if ( saved_errno != 0 ) {
-        stream_ << strerror_tl(saved_errno) << " (errno = " << saved_errno <<") ";
-    }
-}
+///
+/// 二进制条目的头部，第一个字节是0，文本日志不会以0开头，两种可以混在一起
+///
+struct BinaryHeader {
+    char        marker;
+    char        reserved;
+    uint16_t    size;           // 包括头部的整个条目的长度
+    uint32_t    site;
+    int64_t     time;           // 微秒
+    int32_t     tid;
+    int32_t     saved_errno;
+};
+static_assert(sizeof(BinaryHeader) == 24, "BinaryHeader has no padding");
 
-void Logger::Impl::FormatTime() {
-    int64_t micro_seconds_since_epoch = time_.MicroSecondsSinceEpoch();
+void FormatTime(Timestamp time, LogStream& stream) {
+    int64_t micro_seconds_since_epoch = time.MicroSecondsSinceEpoch();
     time_t seconds = static_cast<time_t>(micro_seconds_since_epoch / Timestamp::kmicro_seconds_per_second);
     int micro_seconds = static_cast<int>(micro_seconds_since_epoch % Timestamp::kmicro_seconds_per_second);
     if ( seconds != t_last_second ) {
@@ -119,16 +123,121 @@ void Logger::Impl::FormatTime() {
     if ( g_log_timezone.valid() ) {
         Format us(".%06dZ ", micro_seconds);
         assert(us.Length() == 8);
-        stream_ << T(t_time, 17) << T(us.Data(), 8);
+        stream << T(t_time, 17) << T(us.Data(), 8);
     } else {
         Format us(".%06dZ ", micro_seconds);
         assert(us.Length() == 9);
-        stream_ << T(t_time, 17) << T(us.Data(), 9);
+        stream << T(t_time, 17) << T(us.Data(), 9);
+    }
+}
+
+void FormatErrno(int saved_errno, LogStream& stream) {
+    if ( saved_errno != 0 ) {
+        stream << strerror_tl(saved_errno) << " (errno = " << saved_errno <<") ";
     }
 }
 
+// 一个二进制条目按文本模式的格式输出，返回false表示数据有错误
+bool DecodeEntry(const BinaryHeader& header, const char* args, int len, LogStream& stream) {
+    const LogSite* site = LogSite::Find(header.site);
+    if ( site == NULL ) {
+        return false;
+    }
+    FormatTime(Timestamp(header.time), stream);
+    stream << Format("%5d", header.tid);
+    stream << T(LogLevelName[site->level_], 6);
+    FormatErrno(header.saved_errno, stream);
+    if ( site->func_ ) {
+        stream << site->func_ << ' ';
+    }
+    bool ok = stream.DecodeBinary(args, len);
+    stream << " - " << site->file_ << ':' << site->line_ << '\n';
+    return ok;
+}
+
+} // namespace dwater
+
+using namespace dwater;
+
+LogSite::LogSite(Logger::SourceFile file, int line, Logger::LogLevel level,
+                 const char* func, bool syserr)
+    :   file_(file),
+        line_(line),
+        level_(level),
+        func_(func),
+        syserr_(syserr),
+        id_(kinvalid_id) {
+    uint32_t id = g_site_count.fetch_add(1, std::memory_order_relaxed);
+    if ( id < kmax_sites ) {
+        id_ = id;
+        g_sites[id].store(this, std::memory_order_release);
+    }
+}
+
+const LogSite* LogSite::Find(uint32_t id) {
+    if ( id >= kmax_sites ) {
+        return NULL;
+    }
+    return g_sites[id].load(std::memory_order_acquire);
+}
+
+Logger::Impl::Impl(LogLevel level, int saved_errno, const SourceFile& file, int line)
+    :   time_(Timestamp::Now()),
+        stream_(),
+        level_(level),
+        line_(line),
+        basename_(file),
+        header_(NULL) {
+    FormatTime();
+    current_thread::Tid();
+    stream_ << T(current_thread::TidString(), current_thread::TidStringLength());
+    stream_ << T(LogLevelName[level], 6);
+    FormatErrno(saved_errno, stream_);
+}
+
+// 二进制模式只填头部，时间、线程id和errno都不格式化
+Logger::Impl::Impl(const LogSite& site, int saved_errno)
+    :   time_(Timestamp::Now()),
+        stream_(),
+        level_(site.level_),
+        line_(site.line_),
+        basename_(site.file_),
+        header_(NULL) {
+    if ( g_log_binary && site.id_ != LogSite::kinvalid_id ) {
+        BinaryHeader header;
+        header.marker = '\0';
+        header.reserved = 0;
+        header.size = 0;
+        header.site = site.id_;
+        header.time = time_.MicroSecondsSinceEpoch();
+        header.tid = current_thread::Tid();
+        header.saved_errno = saved_errno;
+        header_ = stream_.Reserve(sizeof header);
+        memcpy(header_, &header, sizeof header);
+        stream_.SetBinary(true);
+    } else {
+        FormatTime();
+        current_thread::Tid();
+        stream_ << T(current_thread::TidString(), current_thread::TidStringLength());
+        stream_ << T(LogLevelName[level_], 6);
+        FormatErrno(saved_errno, stream_);
+        if ( site.func_ ) {
+            stream_ << site.func_ << ' ';
+        }
+    }
+}
+
+void Logger::Impl::FormatTime() {
+    dwater::FormatTime(time_, stream_);
+}
+
 void Logger::Impl::Finish() {
-    stream_ << " - " <<  basename_ << ':' << line_ << '\n';
+    if ( header_ ) {
+        uint16_t size = static_cast<uint16_t>(stream_.GetBuffer().Length());
+        memcpy(header_ + offsetof(BinaryHeader, size), &size, sizeof size);
+    } else {
+        stream_ << " - " <<  basename_ << ':' << line_ << '\n';
+    }
 }
 
 Logger::Logger(SourceFile file, int line) : impl_(INFO, 0, file, line) {}
@@ -144,10 +253,15 @@ Logger::Logger(SourceFile file, int line, LogLevel level)
 Logger::Logger(SourceFile file, int line, bool to_about)
     :   impl_(to_about ? FATAL : ERROR, errno, file, line) {}
 
+Logger::Logger(const LogSite& site)
+    :   impl_(site, site.syserr_ ? errno : 0) {}
+
 Logger::~Logger() {
     impl_.Finish();
     const LogStream::Buffer& buf(Stream().GetBuffer());
+    t_output_level = impl_.level_;
     g_output(buf.Data(), buf.Length());
+    t_output_level = INFO;
     // 如果FATAL信息，匿名对象Logger析构的时候就要刷新到文件或者标准输出
     if ( impl_.level_ == FATAL ) {
         g_flush();
@@ -170,3 +284,50 @@ void Logger::SetFlush(FlushFunc flush) {
 void Logger::SetTimeZone(const TimeZone& tz) {
     g_log_timezone = tz;
 }
+
+Logger::LogLevel Logger::OutputLevel() {
+    return t_output_level;
+}
+
+void Logger::SetBinaryMode(bool binary) {
+    g_log_binary = binary;
+}
+
+bool Logger::BinaryMode() {
+    return g_log_binary;
+}
+
+// 文本日志一直到下一个0为止，二进制条目由头部的长度确定，数据有错误时
+// 剩下的部分丢掉，不会越界
+void Logger::DecodeBinary(const char* data, int len, string* text) {
+    const char* p = data;
+    const char* end = data + len;
+    LogStream stream;
+    while ( p < end ) {
+        if ( *p != '\0' ) {
+            const char* next = static_cast<const char*>(memchr(p, '\0', end - p));
+            if ( next == NULL ) {
+                next = end;
+            }
+            text->append(p, next);
+            p = next;
+            continue;
+        }
+        BinaryHeader header;
+        if ( end - p < static_cast<ptrdiff_t>(sizeof header) ) {
+            break;
+        }
+        memcpy(&header, p, sizeof header);
+        if ( header.size < sizeof header || header.size > end - p ) {
+            break;
+        }
+        stream.ResetBuffer();
+        bool ok = DecodeEntry(header, p + sizeof header,
+                              header.size - static_cast<int>(sizeof header), stream);
+        text->append(stream.GetBuffer().Data(), stream.GetBuffer().Length());
+        if ( !ok ) {
+            break;
+        }
+        p += header.size;
+    }
+}
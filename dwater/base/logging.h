@@ -14,6 +14,7 @@ namespace dwater {
 
 // forward declaration
 class TimeZone;
+class LogSite;
 
 class Logger {
 public:
@@ -56,6 +57,7 @@ public:
     Logger(SourceFile file, int line, LogLevel level);
     Logger(SourceFile file, int line, LogLevel level, const char* func);
     Logger(SourceFile file, int line, bool to_abort);
+    explicit Logger(const LogSite& site); // LOG_xx宏使用
     ~Logger();
 
     LogStream& Stream() { return impl_.stream_; }
@@ -69,11 +71,24 @@ public:
     static void SetFlush(FlushFunc);
     static void SetTimeZone(const TimeZone& tz);
 
+    /// 在输出函数中调用，返回正在输出的这条日志的级别，其他时候是INFO
+    static LogLevel OutputLevel();
+
+    /// 二进制模式：LOG_xx只记录调用点的id、时间、线程id和参数的原始字节，
+    /// 不做格式化，输出函数收到的是二进制的条目。要配合AsyncLogging使用，
+    /// 后台线程写文件之前调用DecodeBinary()转换成和文本模式一样的格式
+    static void SetBinaryMode(bool binary);
+    static bool BinaryMode();
+
+    /// 把[data, data+len)中的二进制条目转换成文本追加到text，其中的文本日志原样复制
+    static void DecodeBinary(const char* data, int len, string* text);
+
 private:
     class Impl {
     public:
         typedef Logger::LogLevel LogLevel;
         Impl(LogLevel level, int old_errno, const SourceFile& file, int line);
+        Impl(const LogSite& site, int saved_errno);
         void FormatTime();
         void Finish();
 
@@ -83,29 +98,60 @@ private:
         LogLevel    level_;
         int         line_;
         SourceFile  basename_;
+        char*       header_; // 二进制模式下条目头部的位置，文本模式为NULL
     };
 
     Impl impl_;
 };
 
+///
+/// 一条LOG_xx语句，第一次执行的时候注册得到一个id。二进制模式下条目中只有id，
+/// 文件名、行号、级别和函数名在格式化的时候再查
+///
+class LogSite : noncopyable {
+public:
+    static const uint32_t kinvalid_id = 0xffffffff; // 注册满了，只能用文本模式
+    static const uint32_t kmax_sites = 64 * 1024;
+
+    LogSite(Logger::SourceFile file, int line, Logger::LogLevel level,
+            const char* func, bool syserr);
+
+    /// 任何线程都可以调用，id不存在时返回NULL
+    static const LogSite* Find(uint32_t id);
+
+    // members
+    Logger::SourceFile  file_;
+    int                 line_;
+    Logger::LogLevel    level_;
+    const char*         func_;      // 只有TRACE和DEBUG输出函数名，其他为NULL
+    bool                syserr_;    // LOG_SYSERR和LOG_SYSFATAL，记录errno
+    uint32_t            id_;
+};
+
 extern Logger::LogLevel g_log_level;
 
 inline Logger::LogLevel Logger::logLevel() {
     return g_log_level;
 }
 
+// 每条LOG_xx语句一个静态的LogSite，__func__要在lambda外面取
+#define DWATER_LOG_SITE(level, func, syserr) \
+  [](const char* f) -> const dwater::LogSite& { \
+    static const dwater::LogSite site(__FILE__, __LINE__, level, f, syserr); \
+    return site; }(func)
+
 // 宏，生成Logger的临时对象，讲数据存储在Logger对象的缓存区中
 #define LOG_TRACE if (dwater::Logger::logLevel() <= dwater::Logger::TRACE) \
-  dwater::Logger(__FILE__, __LINE__, dwater::Logger::TRACE, __func__).Stream()
+  dwater::Logger(DWATER_LOG_SITE(dwater::Logger::TRACE, __func__, false)).Stream()
 #define LOG_DEBUG if (dwater::Logger::logLevel() <= dwater::Logger::DEBUG) \
-  dwater::Logger(__FILE__, __LINE__, dwater::Logger::DEBUG, __func__).Stream()
+  dwater::Logger(DWATER_LOG_SITE(dwater::Logger::DEBUG, __func__, false)).Stream()
 #define LOG_INFO if (dwater::Logger::logLevel() <= dwater::Logger::INFO) \
-  dwater::Logger(__FILE__, __LINE__).Stream()
-#define LOG_WARN dwater::Logger(__FILE__, __LINE__, dwater::Logger::WARN).Stream()
-#define LOG_ERROR dwater::Logger(__FILE__, __LINE__, dwater::Logger::ERROR).Stream()
-#define LOG_FATAL dwater::Logger(__FILE__, __LINE__, dwater::Logger::FATAL).Stream()
-#define LOG_SYSERR dwater::Logger(__FILE__, __LINE__, false).Stream()
-#define LOG_SYSFATAL dwater::Logger(__FILE__, __LINE__, true).Stream()
+  dwater::Logger(DWATER_LOG_SITE(dwater::Logger::INFO, NULL, false)).Stream()
+#define LOG_WARN dwater::Logger(DWATER_LOG_SITE(dwater::Logger::WARN, NULL, false)).Stream()
+#define LOG_ERROR dwater::Logger(DWATER_LOG_SITE(dwater::Logger::ERROR, NULL, false)).Stream()
+#define LOG_FATAL dwater::Logger(DWATER_LOG_SITE(dwater::Logger::FATAL, NULL, false)).Stream()
+#define LOG_SYSERR dwater::Logger(DWATER_LOG_SITE(dwater::Logger::ERROR, NULL, true)).Stream()
+#define LOG_SYSFATAL dwater::Logger(DWATER_LOG_SITE(dwater::Logger::FATAL, NULL, true)).Stream()
 
 const char* strerror_tl(int savedErrno);
 
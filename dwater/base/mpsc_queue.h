@@ -0,0 +1,81 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.13
+// Filename:        mpsc_queue.h
+// Descripton:      无锁的侵入式多生产者单消费者队列(Dmitry Vyukov的算法)，
+// 任意线程都可以Push，只有一个线程可以Pop。Push只有一次原子交换，不会阻塞
+
+#ifndef DWATER_SRC_BASE_MPSC_QUEUE_H
+#define DWATER_SRC_BASE_MPSC_QUEUE_H
+
+#include "dwater/base/noncopable.h"
+
+#include <atomic>
+#include <stddef.h>
+
+namespace dwater {
+
+///
+/// 队列中的元素必须继承这个类，队列不负责分配和释放节点
+///
+struct MpscNode {
+    std::atomic<MpscNode*> mpsc_next_;
+};
+
+class MpscQueue : noncopyable {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {
+        stub_.mpsc_next_.store(NULL, std::memory_order_relaxed);
+    }
+
+    ///
+    /// 线程安全，wait-free
+    ///
+    void Push(MpscNode* node) {
+        node->mpsc_next_.store(NULL, std::memory_order_relaxed);
+        MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        // 从exchange到这里之间，消费者看到的队列是断开的，Pop()会返回NULL
+        prev->mpsc_next_.store(node, std::memory_order_release);
+    }
+
+    ///
+    /// 只能在消费者线程调用，队列为空或者生产者正在Push()时返回NULL
+    ///
+    MpscNode* Pop() {
+        MpscNode* tail = tail_;
+        MpscNode* next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if ( tail == &stub_ ) {
+            if ( next == NULL ) {
+                return NULL;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->mpsc_next_.load(std::memory_order_acquire);
+        }
+        if ( next ) {
+            tail_ = next;
+            return tail;
+        }
+        if ( tail != head_.load(std::memory_order_acquire) ) {
+            return NULL;
+        }
+        // 只剩最后一个节点，把stub_放回队列，这样tail就可以被取出
+        Push(&stub_);
+        next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if ( next ) {
+            tail_ = next;
+            return tail;
+        }
+        return NULL;
+    }
+
+private:
+    std::atomic<MpscNode*>  head_;  // 生产者插入的位置
+    char                    pad_[64 - sizeof(std::atomic<MpscNode*>)]; // 避免false sharing
+    MpscNode*               tail_;  // 消费者取出的位置
+    MpscNode                stub_;
+}; // class MpscQueue
+
+} // namespace dwater
+
+#endif // DWATER_SRC_BASE_MPSC_QUEUE_H
@@ -45,7 +45,7 @@ private:
 
 public:
     StringPiece()
-        : ptr_(NULL), length_(1) {  }
+        : ptr_(NULL), length_(0) {  }
 
     StringPiece(const char* str)
         : ptr_(str), length_(static_cast<int>(strlen(ptr_))) {  }
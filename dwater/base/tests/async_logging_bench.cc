@@ -0,0 +1,177 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        async_logging_bench.cc
+// Descripton:      多个线程同时写日志，比较每个线程一个buffer的AsyncLogging和
+//                  原来所有线程共用一把锁的实现
+//
+// 用法：async_logging_bench [每个线程的行数]
+
+#include "dwater/base/async_logging.h"
+#include "dwater/base/condition.h"
+#include "dwater/base/log_file.h"
+#include "dwater/base/thread.h"
+#include "dwater/base/timestamp.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace dwater;
+
+///
+/// 原来的实现：所有线程共用curr_buffer_，每条日志都加锁
+///
+class MutexAsyncLogging : noncopyable {
+public:
+    MutexAsyncLogging(const string& basename, off_t roll_size)
+        : running_(false),
+          basename_(basename),
+          roll_size_(roll_size),
+          thread_(std::bind(&MutexAsyncLogging::ThreadFunc, this), "Logging"),
+          latch_(1),
+          cond_(mutex_),
+          curr_buffer_(new Buffer),
+          next_buffer_(new Buffer) {
+    }
+
+    void Append(const char* logline, int len) {
+        MutexLockGuard lock(mutex_);
+        if ( curr_buffer_->Avail() > len ) {
+            curr_buffer_->Append(logline, len);
+        } else {
+            buffers_.push_back(std::move(curr_buffer_));
+            if ( next_buffer_ ) {
+                curr_buffer_ = std::move(next_buffer_);
+            } else {
+                curr_buffer_.reset(new Buffer);
+            }
+            curr_buffer_->Append(logline, len);
+            cond_.Notify();
+        }
+    }
+
+    void Start() {
+        running_ = true;
+        thread_.Start();
+        latch_.Wait();
+    }
+
+    void Stop() {
+        running_ = false;
+        cond_.Notify();
+        thread_.Join();
+    }
+
+private:
+    typedef detail::FixedBuffer<detail::k_large_buffer> Buffer;
+    typedef std::unique_ptr<Buffer> BufferPtr;
+
+    void ThreadFunc() {
+        latch_.CountDown();
+        LogFile output(basename_, roll_size_, false);
+        BufferPtr new_buffer1(new Buffer);
+        BufferPtr new_buffer2(new Buffer);
+        std::vector<BufferPtr> buffers_to_write;
+        while ( running_ ) {
+            {
+                MutexLockGuard lock(mutex_);
+                if ( buffers_.empty() ) {
+                    cond_.WaitForSeconds(1);
+                }
+                buffers_.push_back(std::move(curr_buffer_));
+                curr_buffer_ = std::move(new_buffer1);
+                buffers_to_write.swap(buffers_);
+                if ( !next_buffer_ ) {
+                    next_buffer_ = std::move(new_buffer2);
+                }
+            }
+            for ( const BufferPtr& buffer : buffers_to_write ) {
+                output.Append(buffer->Data(), buffer->Length());
+            }
+            new_buffer1 = std::move(buffers_to_write.back());
+            new_buffer1->Reset();
+            buffers_to_write.pop_back();
+            if ( !new_buffer2 ) {
+                new_buffer2 = buffers_to_write.empty() ? BufferPtr(new Buffer)
+                                                       : std::move(buffers_to_write.back());
+                new_buffer2->Reset();
+            }
+            buffers_to_write.clear();
+            output.Flush();
+        }
+        MutexLockGuard lock(mutex_);
+        for ( const BufferPtr& buffer : buffers_ ) {
+            output.Append(buffer->Data(), buffer->Length());
+        }
+        output.Append(curr_buffer_->Data(), curr_buffer_->Length());
+        output.Flush();
+    }
+
+    std::atomic<bool> running_;
+    const string basename_;
+    const off_t roll_size_;
+    Thread thread_;
+    CountDownLatch latch_;
+    MutexLock mutex_;
+    Condition cond_;
+    BufferPtr curr_buffer_;
+    BufferPtr next_buffer_;
+    std::vector<BufferPtr> buffers_;
+};
+
+const off_t kroll_size = 1000 * 1000 * 1000;
+
+// 和MutexAsyncLogging一样不丢日志，每一行都要写到文件
+void SetUp(MutexAsyncLogging&) {}
+
+void SetUp(AsyncLogging& log) {
+    log.SetOverflowPolicy(AsyncLogging::kblock);
+}
+
+template <typename Logging>
+double Run(int num_threads, int lines) {
+    Logging log("async_logging_bench", kroll_size);
+    SetUp(log);
+    log.Start();
+    CountDownLatch start(1);
+    std::vector<std::unique_ptr<Thread>> threads;
+    for ( int i = 0; i < num_threads; ++i ) {
+        threads.emplace_back(new Thread([&log, &start, i, lines] {
+            char line[128];
+            start.Wait();
+            for ( int n = 0; n < lines; ++n ) {
+                int len = snprintf(line, sizeof line,
+                                   "20210417 12:00:00.123456Z %5d INFO  thread %2d line %8d "
+                                   "GET /index.html 200 - http_server.cc:88\n", i, i, n);
+                log.Append(line, len);
+            }
+        }));
+        threads.back()->Start();
+    }
+    Timestamp begin(Timestamp::Now());
+    start.CountDown();
+    for ( auto& thread : threads ) {
+        thread->Join();
+    }
+    double seconds = TimeDifference(Timestamp::Now(), begin);
+    log.Stop();
+    return seconds;
+}
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? atoi(argv[1]) : 200000;
+    printf("%d lines per thread, million lines per second\n", lines);
+    printf("threads   mutex  per-thread\n");
+    for ( int num_threads = 1; num_threads <= 32; num_threads *= 2 ) {
+        double mutex_seconds = Run<MutexAsyncLogging>(num_threads, lines);
+        double thread_seconds = Run<AsyncLogging>(num_threads, lines);
+        double total = static_cast<double>(num_threads) * lines / 1e6;
+        printf("%7d %7.2f %11.2f\n", num_threads, total / mutex_seconds, total / thread_seconds);
+    }
+    ::system("rm -f async_logging_bench.*.log");
+}
@@ -0,0 +1,126 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        async_logging_overflow_test.cc
+// Descripton:      后台线程写文件很慢的时候，检查AsyncLogging每种OverflowPolicy
+//                  丢掉、等待和写出的行数
+
+#include "../async_logging.h"
+#include "../log_sink.h"
+#include "../logging.h"
+#include "../timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace dwater;
+
+int g_info_lines = 0;
+int g_warn_lines = 0;
+
+///
+/// 不写文件，只数行数，每次写的时候睡一会，模拟很慢的磁盘
+///
+class SlowSink : public LogSink {
+public:
+    explicit SlowSink(const string& filename) : LogSink(filename), bytes_(0) {}
+
+    void Append(const char* data, size_t len) override {
+        const char* end = data + len;
+        while ( data < end ) {
+            const char* eol = static_cast<const char*>(memchr(data, '\n', end - data));
+            eol = eol ? eol + 1 : end;
+            if ( memmem(data, eol - data, "INFO  ", 6) ) {
+                ++g_info_lines;
+            } else if ( memmem(data, eol - data, "WARN  ", 6) ) {
+                ++g_warn_lines;
+            }
+            data = eol;
+        }
+        bytes_ += len;
+        ::usleep(5 * 1000);
+    }
+
+    void Flush() override {}
+
+    off_t WriteBytes() const override { return bytes_; }
+
+private:
+    off_t bytes_;
+};
+
+AsyncLogging* g_async_log = NULL;
+
+void AsyncOutput(const char* msg, int len) {
+    g_async_log->Append(msg, len);
+}
+
+const int klines = 300 * 1000;
+const int kwarn_every = 10;
+const int kmax_buffers = 4;
+
+struct Result {
+    int64_t dropped;
+    int64_t blocked;
+};
+
+Result Run(AsyncLogging::OverflowPolicy policy, int spill_buffers) {
+    g_info_lines = 0;
+    g_warn_lines = 0;
+    AsyncLogging log("async_logging_overflow_test", 1000 * 1000 * 1000);
+    log.SetSinkFactory([](const string& filename) { return new SlowSink(filename); });
+    log.SetMaxBuffers(kmax_buffers);
+    log.SetOverflowPolicy(policy, spill_buffers);
+    log.Start();
+    g_async_log = &log;
+    Logger::SetOutput(AsyncOutput);
+    string padding(40, 'x');
+    for ( int i = 0; i < klines; ++i ) {
+        if ( i % kwarn_every == 0 ) {
+            LOG_WARN << "line " << i << ' ' << padding;
+        } else {
+            LOG_INFO << "line " << i << ' ' << padding;
+        }
+    }
+    log.Stop();
+    Result result = { log.DroppedLines(), log.BlockedLines() };
+    return result;
+}
+
+void Check(bool ok, const char* what) {
+    if ( !ok ) {
+        printf("FAILED: %s\n", what);
+        exit(1);
+    }
+}
+
+int main() {
+    const int kwarn_lines = klines / kwarn_every;
+    const char* names[] = { "block", "drop_newest", "drop_below_warn", "spill" };
+    for ( int policy = AsyncLogging::kblock; policy <= AsyncLogging::kspill; ++policy ) {
+        Timestamp start(Timestamp::Now());
+        Result result = Run(static_cast<AsyncLogging::OverflowPolicy>(policy), kmax_buffers);
+        printf("%-16s %.2fs written info %6d warn %6d, dropped %6lld, blocked %6lld\n",
+               names[policy], TimeDifference(Timestamp::Now(), start),
+               g_info_lines, g_warn_lines, static_cast<long long>(result.dropped),
+               static_cast<long long>(result.blocked));
+        Check(g_info_lines + g_warn_lines + result.dropped == klines, "written + dropped");
+        switch ( policy ) {
+        case AsyncLogging::kblock:
+            Check(result.dropped == 0 && result.blocked > 0, "block");
+            break;
+        case AsyncLogging::kdrop_newest:
+            Check(result.dropped > 0 && result.blocked == 0, "drop_newest");
+            break;
+        case AsyncLogging::kdrop_below_warn:
+            Check(result.dropped > 0 && g_warn_lines == kwarn_lines, "drop_below_warn");
+            break;
+        case AsyncLogging::kspill:
+            Check(result.blocked == 0, "spill");
+            break;
+        }
+    }
+    printf("OK\n");
+}
@@ -0,0 +1,154 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        binary_logging_test.cc
+// Descripton:      Logger二进制模式，检查转换出来的文本和文本模式一样，
+//                  再比较两种模式写到AsyncLogging每条日志用的CPU时间
+//
+// 用法：binary_logging_test [日志条数]
+
+#include "../async_logging.h"
+#include "../logging.h"
+#include "../timestamp.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace dwater;
+
+string g_captured;
+
+void CaptureOutput(const char* msg, int len) {
+    g_captured.append(msg, len);
+}
+
+AsyncLogging* g_async_log = NULL;
+
+void AsyncOutput(const char* msg, int len) {
+    g_async_log->Append(msg, len);
+}
+
+// 同一条语句，二进制模式和文本模式都执行一次
+string LogAll(bool binary) {
+    Logger::SetBinaryMode(binary);
+    g_captured.clear();
+    string str("string");
+    StringPiece piece("piece");
+    short s = -3;
+    unsigned short us = 4;
+    for ( int i = 0; i < 2; ++i ) {
+        LOG_INFO << "int " << -1 << " uint " << 2u << " long " << -123456789012L
+                 << " ulong " << 123456789012UL << " short " << s << " ushort " << us;
+        LOG_WARN << "double " << 3.14159 << " float " << 2.5f << " bool " << true
+                 << " char " << 'c' << " ptr " << reinterpret_cast<void*>(0x1234);
+        LOG_ERROR << str << ' ' << piece << ' ' << Format("%4.2f", 1.5) << ' '
+                  << static_cast<const char*>(NULL);
+        LOG_INFO << string(5000, 'x') << "too long";
+        errno = EAGAIN;
+        LOG_SYSERR << "syserr";
+        LOG_INFO;
+    }
+    Logger::SetBinaryMode(false);
+    if ( !binary ) {
+        return g_captured;
+    }
+    string text;
+    Logger::DecodeBinary(g_captured.data(), static_cast<int>(g_captured.size()), &text);
+    return text;
+}
+
+// 时间不一样，每行去掉开头的时间再比较
+string StripTime(const string& text) {
+    string result;
+    size_t begin = 0;
+    while ( begin < text.size() ) {
+        size_t end = text.find('\n', begin);
+        end = end == string::npos ? text.size() : end + 1;
+        result.append(text, begin + 26, end - begin - 26);
+        begin = end;
+    }
+    return result;
+}
+
+void TestDecode() {
+    Logger::SetOutput(CaptureOutput);
+    string text = LogAll(false);
+    string decoded = LogAll(true);
+    printf("%s", decoded.c_str());
+    if ( StripTime(text) != StripTime(decoded) ) {
+        printf("FAILED: decoded text differs\n%s", text.c_str());
+        exit(1);
+    }
+
+    // 二进制条目和文本日志混在一起
+    g_captured.clear();
+    LOG_INFO << "text";
+    Logger::SetBinaryMode(true);
+    LOG_INFO << "binary " << 1;
+    Logger::SetBinaryMode(false);
+    LOG_INFO << "text again";
+    text.clear();
+    Logger::DecodeBinary(g_captured.data(), static_cast<int>(g_captured.size()), &text);
+    if ( StripTime(text).find("text - ") == string::npos ||
+         StripTime(text).find("binary 1 - ") == string::npos ||
+         StripTime(text).find("text again - ") == string::npos ) {
+        printf("FAILED: mixed\n%s", text.c_str());
+        exit(1);
+    }
+
+    // 截断的数据不能越界
+    Logger::SetBinaryMode(true);
+    g_captured.clear();
+    LOG_INFO << "truncated " << 42;
+    Logger::SetBinaryMode(false);
+    for ( size_t len = 0; len < g_captured.size(); ++len ) {
+        text.clear();
+        Logger::DecodeBinary(g_captured.data(), static_cast<int>(len), &text);
+    }
+    printf("decode OK\n");
+}
+
+// 只算写日志线程的CPU时间，后台线程写文件的时间不算在内
+double ThreadSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+double Bench(bool binary, int n) {
+    Logger::SetBinaryMode(binary);
+    string path("/index.html");
+    double start = ThreadSeconds();
+    for ( int i = 0; i < n; ++i ) {
+        LOG_INFO << "GET " << path << " status " << 200 << " bytes " << i
+                 << " time " << 0.000123;
+    }
+    double seconds = ThreadSeconds() - start;
+    Logger::SetBinaryMode(false);
+    return seconds * 1e9 / n;
+}
+
+int main(int argc, char* argv[]) {
+    TestDecode();
+
+    int n = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+    AsyncLogging log("binary_logging_test", 1000 * 1000 * 1000);
+    // 不丢日志，否则比较的大多是被丢掉的行
+    log.SetOverflowPolicy(AsyncLogging::kblock);
+    log.Start();
+    g_async_log = &log;
+    Logger::SetOutput(AsyncOutput);
+    // 先预热，让每个线程的buffer分配好
+    Bench(false, n / 10);
+    Bench(true, n / 10);
+    for ( int i = 0; i < 3; ++i ) {
+        double text = Bench(false, n);
+        double binary = Bench(true, n);
+        printf("ns per LOG_INFO: text %.1f binary %.1f\n", text, binary);
+    }
+    log.Stop();
+    printf("dropped %lld lines\n", static_cast<long long>(log.DroppedLines()));
+    ::system("rm -f binary_logging_test.*.log");
+}
@@ -0,0 +1,182 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        log_sink_bench.cc
+// Descripton:      比较LogFile直接写文件、预分配文件和边写边gzip压缩的速度、CPU时间、
+//                  一次写的最长时间和文件大小，再测试LogCompressor压缩滚动之后的
+//                  文件，检查写进去的内容，以及写.gz失败的时候不删除原文件
+//
+// 用法：log_sink_bench [MB]
+
+#include "../file_util.h"
+#include "../log_compressor.h"
+#include "../log_file.h"
+#include "../log_sink.h"
+#include "../timestamp.h"
+
+#include <algorithm>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+using namespace dwater;
+
+double ThreadSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+// 和LOG_INFO格式一样的日志，内容有一些变化
+string MakeLines(size_t bytes) {
+    static const char* const kpaths[] = { "/index.html", "/api/v1/users", "/static/app.js",
+                                         "/favicon.ico", "/api/v1/orders?page=2" };
+    string lines;
+    lines.reserve(bytes + 256);
+    char line[256];
+    unsigned seed = 1;
+    for ( int i = 0; lines.size() < bytes; ++i ) {
+        seed = seed * 1103515245 + 12345;
+        int len = snprintf(line, sizeof line,
+                           "20210417 12:%02d:%02d.%06dZ %5dINFO  GET %s %d %u bytes %d us "
+                           "- http_server.cc:%d\n",
+                           i / 60000 % 60, i / 1000 % 60, seed % 1000000, 4000 + i % 8,
+                           kpaths[seed % 5], (seed >> 8) % 16 == 0 ? 404 : 200,
+                           (seed >> 4) % 100000, (seed >> 12) % 5000, 80 + i % 20);
+        lines.append(line, len);
+    }
+    return lines;
+}
+
+off_t FileSize(const string& filename) {
+    struct stat st;
+    return ::stat(filename.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+// 解压之后和写进去的一样
+bool CheckGzip(const string& filename, const string& expected) {
+    gzFile gz = ::gzopen(filename.c_str(), "rb");
+    if ( gz == NULL ) {
+        return false;
+    }
+    string content;
+    char buf[64 * 1024];
+    int n;
+    while ( (n = ::gzread(gz, buf, sizeof buf)) > 0 ) {
+        content.append(buf, n);
+    }
+    ::gzclose(gz);
+    return content == expected;
+}
+
+bool CheckPlain(const string& filename, const string& expected) {
+    string content;
+    int64_t size = 0;
+    file_util::ReadFile(filename, static_cast<int>(expected.size()) + 1, &content, &size);
+    return content == expected;
+}
+
+const size_t kchunk = 4 * 1000 * 1000;
+
+// 一次写4MB，和AsyncLogging后台线程写一个大buffer差不多
+string Write(const char* name, const LogSinkFactory& factory, const string& lines) {
+    string filename;
+    double max_append = 0;
+    Timestamp start(Timestamp::Now());
+    double cpu_start = ThreadSeconds();
+    {
+        LogFile file("log_sink_bench", 1024L * 1024 * 1024 * 16, factory, false);
+        file.SetRollCallback([&filename](const string& f) { filename = f; });
+        for ( size_t i = 0; i < lines.size(); i += kchunk ) {
+            Timestamp begin(Timestamp::Now());
+            file.Append(lines.data() + i, static_cast<int>(std::min(kchunk, lines.size() - i)));
+            max_append = std::max(max_append, TimeDifference(Timestamp::Now(), begin));
+        }
+        file.Flush();
+        ::sleep(1); // 文件名精确到秒，下一秒才能滚动
+        file.RollFile();
+    }
+    double cpu = ThreadSeconds() - cpu_start;
+    double seconds = TimeDifference(Timestamp::Now(), start) - 1.0;
+    off_t size = FileSize(filename);
+    double mb = static_cast<double>(lines.size()) / 1e6;
+    printf("%-8s %8.1f MB/s %6.2f cpu s %8.1f cpu us/MB %7.2f max ms %8.1f MB on disk (%.1f%%)\n",
+           name, mb / seconds, cpu, cpu * 1e6 / mb, max_append * 1e3,
+           static_cast<double>(size) / 1e6,
+           100.0 * static_cast<double>(size) / static_cast<double>(lines.size()));
+    return filename;
+}
+
+// 用RLIMIT_FSIZE模拟磁盘写满，.gz写不完的时候CompressFile()失败并且保留原文件
+bool CheckCompressFailure() {
+    const string filename = "log_sink_bench.full";
+    string data(1024 * 1024, '\0');
+    unsigned seed = 1;
+    for ( size_t i = 0; i < data.size(); ++i ) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = static_cast<char>(seed >> 16); // 压缩不了
+    }
+    {
+        file_util::AppendFile file(filename);
+        file.Append(data.data(), data.size());
+    }
+    struct rlimit old_limit;
+    ::getrlimit(RLIMIT_FSIZE, &old_limit);
+    struct rlimit limit = old_limit;
+    limit.rlim_cur = 256 * 1024;
+    ::signal(SIGXFSZ, SIG_IGN); // write()返回EFBIG，而不是结束进程
+    ::setrlimit(RLIMIT_FSIZE, &limit);
+    bool compressed = LogCompressor::CompressFile(filename);
+    ::setrlimit(RLIMIT_FSIZE, &old_limit);
+    printf("compress with full disk: %s, original kept %s\n", compressed ? "ok" : "failed",
+           FileSize(filename) == static_cast<off_t>(data.size()) ? "yes" : "no");
+    return !compressed && FileSize(filename) == static_cast<off_t>(data.size()) &&
+           FileSize(filename + ".gz") < 0;
+}
+
+int main(int argc, char* argv[]) {
+    size_t mb = argc > 1 ? atoi(argv[1]) : 200;
+    string lines = MakeLines(mb * 1000 * 1000);
+
+    string plain = Write("plain", FileSinkFactory(), lines);
+    string prealloc = Write("prealloc", PreallocFileSinkFactory(lines.size() + kchunk), lines);
+    if ( FileSize(prealloc) != static_cast<off_t>(lines.size()) || !CheckPlain(prealloc, lines) ) {
+        printf("FAILED: prealloc content\n");
+        return 1;
+    }
+    string gzip1 = Write("gzip-1", GzipSinkFactory(1), lines);
+    string gzip6 = Write("gzip-6", GzipSinkFactory(6), lines);
+    if ( !CheckGzip(gzip1, lines) || !CheckGzip(gzip6, lines) ) {
+        printf("FAILED: gzip content\n");
+        return 1;
+    }
+
+    // 滚动之后由LogCompressor在另一个线程压缩，写日志的线程只负责提交
+    LogCompressor compressor;
+    compressor.Start();
+    Timestamp start(Timestamp::Now());
+    compressor.Compress(plain);
+    compressor.Stop();
+    double seconds = TimeDifference(Timestamp::Now(), start);
+    string gz = plain + ".gz";
+    printf("compressor gzip-%d %.1f MB/s %10.1f MB on disk, original removed %s\n",
+           LogCompressor::kdefault_level, static_cast<double>(lines.size()) / 1e6 / seconds,
+           static_cast<double>(FileSize(gz)) / 1e6, FileSize(plain) < 0 ? "yes" : "no");
+    if ( compressor.Compressed() != 1 || !CheckGzip(gz, lines) ) {
+        printf("FAILED: compressor\n");
+        return 1;
+    }
+    if ( !CheckCompressFailure() ) {
+        printf("FAILED: compressor write error\n");
+        return 1;
+    }
+    printf("OK\n");
+    ::system("rm -f log_sink_bench.*");
+}
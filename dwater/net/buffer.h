@@ -11,6 +11,7 @@
 #include "dwater/base/string_piece.h"
 #include "dwater/base/types.h"
 #include "dwater/net/endian.h"
+#include "dwater/net/simd_scan.h"
 
 #include <algorithm>
 #include <vector>  // buffer
@@ -56,15 +57,13 @@ public:
     const char* Peek() const { return Begin() + reader_index_; }
 
     const char* FindCRLF() const {
-        const char* crlf = std::search(Peek(), BeginWrite(), kCRLF, kCRLF+2);
-        return crlf == BeginWrite() ? NULL : crlf;
+        return scan::FindCRLF(Peek(), BeginWrite());
     }
 
     const char* FindCRLF(const char* start) const {
         assert(Peek() <= start);
         assert(start <= BeginWrite());
-        const char* crlf = std::search(start, BeginWrite(), kCRLF, kCRLF+2);
-        return crlf == BeginWrite() ? NULL : crlf;
+        return scan::FindCRLF(start, BeginWrite());
     }
 
     const char* FindEOL() const {
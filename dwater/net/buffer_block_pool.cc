@@ -0,0 +1,111 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.16
+// Filename:        buffer_block_pool.cc
+// Descripton:
+
+#include "dwater/net/buffer_block_pool.h"
+
+#include "dwater/base/current_thread.h"
+#include "dwater/net/chain_buffer.h"
+
+#include <assert.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+const size_t BufferBlockPool::kdefault_max_free_blocks;
+
+size_t BufferBlockPool::Stats::MemoryHeld() const {
+    return (in_use_blocks + free_blocks) * sizeof(BufferBlock);
+}
+
+BufferBlockPool::BufferBlockPool(size_t max_free_blocks)
+    : owner_tid_(current_thread::Tid()),
+      max_free_blocks_(max_free_blocks),
+      closed_(false),
+      refs_(1),
+      acquires_(0),
+      hits_(0) {
+}
+
+BufferBlockPool::~BufferBlockPool() {
+    // 所有Release()都已经返回，队列中不会有正在进行的Push()
+    while ( MpscNode* node = remote_.Pop() ) {
+        delete static_cast<BufferBlock*>(node);
+    }
+    for ( BufferBlock* block : free_blocks_ ) {
+        delete block;
+    }
+}
+
+BufferBlock* BufferBlockPool::Acquire() {
+    assert(current_thread::Tid() == owner_tid_);
+    assert(!closed_.load(std::memory_order_relaxed));
+    ++acquires_;
+    refs_.fetch_add(1, std::memory_order_relaxed);
+    if ( free_blocks_.empty() ) {
+        DrainRemote();
+    }
+    if ( free_blocks_.empty() ) {
+        return new BufferBlock(this);
+    }
+    ++hits_;
+    BufferBlock* block = free_blocks_.back();
+    free_blocks_.pop_back();
+    block->refs_.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+///
+/// 关闭之后直接删除；否则所属线程放回空闲列表，别的线程放到remote_队列中。
+/// remote_中的块如果Close()的时候还没有取到，由最后一个Unref()的析构函数删除
+///
+void BufferBlockPool::Release(BufferBlock* block) {
+    assert(block->pool_ == this);
+    if ( closed_.load(std::memory_order_acquire) ) {
+        delete block;
+    } else if ( current_thread::Tid() == owner_tid_ ) {
+        if ( free_blocks_.size() < max_free_blocks_ ) {
+            free_blocks_.push_back(block);
+        } else {
+            delete block;
+        }
+    } else {
+        remote_.Push(block);
+    }
+    Unref();
+}
+
+void BufferBlockPool::Close() {
+    assert(current_thread::Tid() == owner_tid_);
+    closed_.store(true, std::memory_order_release);
+    while ( MpscNode* node = remote_.Pop() ) {
+        delete static_cast<BufferBlock*>(node);
+    }
+    for ( BufferBlock* block : free_blocks_ ) {
+        delete block;
+    }
+    free_blocks_.clear();
+    Unref();
+}
+
+BufferBlockPool::Stats BufferBlockPool::GetStats() const {
+    Stats stats;
+    stats.acquires = acquires_;
+    stats.hits = hits_;
+    stats.in_use_blocks = static_cast<size_t>(refs_.load(std::memory_order_relaxed) - 1);
+    stats.free_blocks = free_blocks_.size();
+    return stats;
+}
+
+void BufferBlockPool::DrainRemote() {
+    while ( MpscNode* node = remote_.Pop() ) {
+        BufferBlock* block = static_cast<BufferBlock*>(node);
+        if ( free_blocks_.size() < max_free_blocks_ ) {
+            free_blocks_.push_back(block);
+        } else {
+            delete block;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.16
+// Filename:        buffer_block_pool.h
+// Descripton:      每个EventLoop一个的BufferBlock池
+//
+// 连接的ChainBuffer从所属EventLoop的池中分配块，数据取完之后马上把块还回去，
+// 所以空闲的连接不占用缓冲区内存，内存只和正在传输的数据量有关。块可能在别的
+// 线程释放(跨线程转发)，这时通过无锁队列还给所属线程，所属线程分配的时候再取回
+
+#ifndef DWATER_NET_BUFFER_BLOCK_POOL_H
+#define DWATER_NET_BUFFER_BLOCK_POOL_H
+
+#include "dwater/base/mpsc_queue.h"
+#include "dwater/base/noncopable.h"
+#include "dwater/base/types.h"
+
+#include <atomic>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace dwater {
+
+namespace net {
+
+class BufferBlock;
+
+///
+/// 除了Release()，都只能在创建它的线程调用
+///
+/// 池自己管理生命周期：所属的EventLoop析构的时候调用Close()，之后还在外面的块
+/// 释放时直接删除，最后一个块释放之后池被删除
+class BufferBlockPool : noncopyable {
+public:
+    static const size_t kdefault_max_free_blocks = 256; // 4MB
+
+    struct Stats {
+        int64_t acquires;       // Acquire()次数
+        int64_t hits;           // 从空闲块中分配的次数
+        size_t  in_use_blocks;  // 已经分配出去还没有释放的块
+        size_t  free_blocks;    // 池中缓存的空闲块，不包括别的线程还回来还没有取回的
+
+        double HitRate() const {
+            return acquires == 0 ? 0.0 : static_cast<double>(hits) / acquires;
+        }
+
+        ///
+        /// 池分配的、还没有还给系统的内存
+        ///
+        size_t MemoryHeld() const;
+    };
+
+    explicit BufferBlockPool(size_t max_free_blocks = kdefault_max_free_blocks);
+
+    ///
+    /// 分配一个块，引用计数为1，最后一个引用释放的时候自动还回来
+    ///
+    BufferBlock* Acquire();
+
+    ///
+    /// 任意线程都可以调用，由BufferBlock::Unref()调用
+    ///
+    void Release(BufferBlock* block);
+
+    ///
+    /// 所属的EventLoop析构的时候调用，释放缓存的块，之后不能再调用Acquire()
+    ///
+    void Close();
+
+    ///
+    /// 空闲块超过这个数的时候直接释放
+    ///
+    void SetMaxFreeBlocks(size_t n) { max_free_blocks_ = n; }
+
+    Stats GetStats() const;
+
+private:
+    ~BufferBlockPool();
+
+    /// 把别的线程还回来的块放到free_blocks_中
+    void DrainRemote();
+
+    void Unref() {
+        if ( refs_.fetch_sub(1, std::memory_order_acq_rel) == 1 ) {
+            delete this;
+        }
+    }
+
+    const pid_t                 owner_tid_;
+    size_t                      max_free_blocks_;
+    std::vector<BufferBlock*>   free_blocks_;
+    MpscQueue                   remote_;    // 别的线程释放的块
+    std::atomic<bool>           closed_;
+    std::atomic<int>            refs_;      // 分配出去的块数加上所属EventLoop的一个
+    int64_t                     acquires_;
+    int64_t                     hits_;
+}; // class BufferBlockPool
+
+} // namespace net
+
+} // namespace dwater
+
+#endif // DWATER_NET_BUFFER_BLOCK_POOL_H
@@ -47,6 +47,7 @@ namespace net {
 
 // all client callbacks
 class Buffer;
+class ChainBuffer;
 class TcpConnection;
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
 typedef std::function<void()> TimerCallback;
@@ -60,6 +61,11 @@ typedef std::function<void (const TcpConnectionPtr&,
                             Buffer*,
                             Timestamp)> MessageCallback;
 
+// 数据读到链式buffer中，可以不拷贝直接转发给另一个连接
+typedef std::function<void (const TcpConnectionPtr&,
+                            ChainBuffer*,
+                            Timestamp)> ChainMessageCallback;
+
 void DefaultConnectionCallback(const TcpConnectionPtr& conn);
 void DefaultMessageCallback(const TcpConnectionPtr& conn,
                             Buffer* buffer,
@@ -0,0 +1,308 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.16
+// Filename:        chain_buffer.cc
+// Descripton:
+
+#include "dwater/net/chain_buffer.h"
+#include "dwater/net/buffer_block_pool.h"
+#include "dwater/net/socket_ops.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+const size_t BufferBlock::ksize;
+const int ChainBuffer::kmax_iov;
+const size_t ChainBuffer::kmax_read;
+
+BufferBlock* BufferBlock::New() {
+    return new BufferBlock(NULL);
+}
+
+void BufferBlock::Recycle() {
+    if ( pool_ ) {
+        pool_->Release(this);
+    } else {
+        delete this;
+    }
+}
+
+ExternalBuffer* ExternalBuffer::New(const DoneCallback& done) {
+    return new ExternalBuffer(done);
+}
+
+void ExternalBuffer::Recycle() {
+    if ( done_ ) {
+        done_();
+    }
+    delete this;
+}
+
+ChainBuffer::ChainBuffer()
+    : head_(0),
+      readable_(0),
+      write_block_(NULL),
+      write_index_(0),
+      pool_(NULL) {
+}
+
+ChainBuffer::~ChainBuffer() {
+    if ( write_block_ ) {
+        write_block_->Unref();
+    }
+}
+
+ChainBuffer::ChainBuffer(ChainBuffer&& rhs)
+    : head_(0),
+      readable_(0),
+      write_block_(NULL),
+      write_index_(0),
+      pool_(NULL) {
+    Swap(rhs);
+}
+
+void ChainBuffer::Swap(ChainBuffer& rhs) {
+    slices_.swap(rhs.slices_);
+    std::swap(head_, rhs.head_);
+    std::swap(readable_, rhs.readable_);
+    std::swap(write_block_, rhs.write_block_);
+    std::swap(write_index_, rhs.write_index_);
+    std::swap(pool_, rhs.pool_);
+}
+
+void ChainBuffer::Append(const void* data, size_t len) {
+    const char* d = static_cast<const char*>(data);
+    while ( len > 0 ) {
+        if ( write_block_ == NULL || write_index_ == BufferBlock::ksize ) {
+            SetWriteBlock(NewBlock());
+        }
+        size_t n = std::min(len, BufferBlock::ksize - write_index_);
+        ::memcpy(write_block_->Data() + write_index_, d, n);
+        HasWritten(n);
+        d += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::Append(ChainBuffer* other) {
+    assert(other != this);
+    for ( size_t i = other->head_; i < other->slices_.size(); ++i ) {
+        PushBack(std::move(other->slices_[i]));
+    }
+    other->slices_.clear();
+    other->head_ = 0;
+    other->readable_ = 0;
+    other->ReleaseIfEmpty();
+}
+
+void ChainBuffer::Append(ChainBuffer* other, size_t len) {
+    assert(other != this);
+    assert(len <= other->readable_);
+    while ( len > 0 ) {
+        BufferSlice& front = other->slices_[other->head_];
+        if ( front.Size() <= len ) {
+            len -= front.Size();
+            other->readable_ -= front.Size();
+            PushBack(std::move(front));
+            other->PopFront();
+        } else {
+            BufferSlice prefix(front);
+            prefix.RemoveSuffix(front.Size() - len);
+            front.RemovePrefix(len);
+            other->readable_ -= len;
+            PushBack(std::move(prefix));
+            len = 0;
+        }
+    }
+    other->ReleaseIfEmpty();
+}
+
+void ChainBuffer::Append(const BufferSlice& slice) {
+    if ( slice.Size() > 0 ) {
+        PushBack(BufferSlice(slice));
+    }
+}
+
+void ChainBuffer::AppendExternal(const void* data, size_t len,
+                                 const ExternalBuffer::DoneCallback& done) {
+    ExternalBuffer* external = ExternalBuffer::New(done);
+    if ( len > 0 ) {
+        PushBack(BufferSlice(external, static_cast<const char*>(data), len));
+    }
+    external->Unref();
+}
+
+void ChainBuffer::Retrieve(size_t len) {
+    assert(len <= readable_);
+    while ( len > 0 ) {
+        BufferSlice& front = slices_[head_];
+        if ( front.Size() <= len ) {
+            len -= front.Size();
+            readable_ -= front.Size();
+            PopFront();
+        } else {
+            front.RemovePrefix(len);
+            readable_ -= len;
+            len = 0;
+        }
+    }
+    ReleaseIfEmpty();
+}
+
+void ChainBuffer::RetrieveAll() {
+    slices_.clear();
+    head_ = 0;
+    readable_ = 0;
+    ReleaseIfEmpty();
+}
+
+string ChainBuffer::RetrieveAsString(size_t len) {
+    assert(len <= readable_);
+    string result(len, '\0');
+    Copy(&*result.begin(), len);
+    Retrieve(len);
+    return result;
+}
+
+void ChainBuffer::Copy(char* out, size_t len) const {
+    assert(len <= readable_);
+    for ( size_t i = head_; len > 0; ++i ) {
+        size_t n = std::min(len, slices_[i].Size());
+        ::memcpy(out, slices_[i].Data(), n);
+        out += n;
+        len -= n;
+    }
+}
+
+int ChainBuffer::FillIovec(struct iovec* iov, int max_iov) const {
+    int count = 0;
+    for ( size_t i = head_; i < slices_.size() && count < max_iov; ++i ) {
+        iov[count].iov_base = const_cast<char*>(slices_[i].Data());
+        iov[count].iov_len = slices_[i].Size();
+        ++count;
+    }
+    return count;
+}
+
+///
+/// 先填满当前写块，剩下的读到新块中，没有用到的新块直接释放
+///
+ssize_t ChainBuffer::ReadFd(int fd, int* saved_errno) {
+    const int kmax_blocks = static_cast<int>(kmax_read / BufferBlock::ksize) + 1;
+    struct iovec vec[kmax_blocks + 1];
+    BufferBlock* blocks[kmax_blocks];
+    int iov_count = 0;
+    int block_count = 0;
+    size_t writable = 0;
+    if ( write_block_ && write_index_ < BufferBlock::ksize ) {
+        vec[0].iov_base = write_block_->Data() + write_index_;
+        vec[0].iov_len = BufferBlock::ksize - write_index_;
+        writable = vec[0].iov_len;
+        iov_count = 1;
+    }
+    while ( writable < kmax_read && block_count < kmax_blocks ) {
+        blocks[block_count] = NewBlock();
+        vec[iov_count].iov_base = blocks[block_count]->Data();
+        vec[iov_count].iov_len = BufferBlock::ksize;
+        writable += BufferBlock::ksize;
+        ++iov_count;
+        ++block_count;
+    }
+
+    const ssize_t n = socket::Readv(fd, vec, iov_count);
+    if ( n < 0 ) {
+        *saved_errno = errno;
+    }
+    size_t remaining = n > 0 ? static_cast<size_t>(n) : 0;
+    if ( remaining > 0 && write_block_ && write_index_ < BufferBlock::ksize ) {
+        size_t filled = std::min(remaining, BufferBlock::ksize - write_index_);
+        HasWritten(filled);
+        remaining -= filled;
+    }
+    for ( int i = 0; i < block_count; ++i ) {
+        if ( remaining > 0 ) {
+            SetWriteBlock(blocks[i]);
+            size_t filled = std::min(remaining, BufferBlock::ksize);
+            HasWritten(filled);
+            remaining -= filled;
+        } else {
+            blocks[i]->Unref();
+        }
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::WriteFd(int fd, size_t max_len, int* saved_errno) {
+    struct iovec vec[kmax_iov];
+    int iov_count = FillIovec(vec, kmax_iov);
+    for ( int i = 0; i < iov_count; ++i ) {
+        if ( vec[i].iov_len >= max_len ) {
+            vec[i].iov_len = max_len;
+            iov_count = i + 1;
+            break;
+        }
+        max_len -= vec[i].iov_len;
+    }
+    ssize_t n = socket::Writev(fd, vec, iov_count);
+    if ( n < 0 ) {
+        *saved_errno = errno;
+    } else {
+        Retrieve(n);
+    }
+    return n;
+}
+
+///
+/// 如果最后一个slice正好在写块中写入的位置结束，直接延长它
+///
+void ChainBuffer::HasWritten(size_t n) {
+    assert(write_index_ + n <= BufferBlock::ksize);
+    const char* start = write_block_->Data() + write_index_;
+    if ( SliceCount() > 0 ) {
+        BufferSlice& back = slices_.back();
+        if ( back.Block() == write_block_ && back.Data() + back.Size() == start ) {
+            back.Extend(n);
+            write_index_ += n;
+            readable_ += n;
+            return;
+        }
+    }
+    PushBack(BufferSlice(write_block_, start, n));
+    write_index_ += n;
+}
+
+BufferBlock* ChainBuffer::NewBlock() {
+    return pool_ ? pool_->Acquire() : BufferBlock::New();
+}
+
+void ChainBuffer::SetWriteBlock(BufferBlock* block) {
+    if ( write_block_ ) {
+        write_block_->Unref();
+    }
+    write_block_ = block;
+    write_index_ = 0;
+}
+
+void ChainBuffer::PushBack(BufferSlice&& slice) {
+    readable_ += slice.Size();
+    slices_.push_back(std::move(slice));
+}
+
+///
+/// 前面空出来的位置太多时整体前移，避免slices_一直增长
+///
+void ChainBuffer::PopFront() {
+    slices_[head_] = BufferSlice();
+    ++head_;
+    if ( head_ == slices_.size() ) {
+        slices_.clear();
+        head_ = 0;
+    } else if ( head_ >= 16 && head_ * 2 >= slices_.size() ) {
+        slices_.erase(slices_.begin(), slices_.begin() + head_);
+        head_ = 0;
+    }
+}
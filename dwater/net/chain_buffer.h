@@ -0,0 +1,331 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.16
+// Filename:        chain_buffer.h
+// Descripton:      由引用计数的固定大小内存块组成的链式buffer
+//
+// 数据保存在BufferBlock中，ChainBuffer只记录一串BufferSlice(块中的一段)。
+// 在两个ChainBuffer之间移动数据只需要移动slice，不拷贝数据，适合在两个连接
+// 之间转发大量数据。读用readv直接读到新的块中，写用writev。
+// slice也可以直接引用用户的内存(ExternalBuffer)，不再被引用的时候通知用户
+
+#ifndef DWATER_NET_CHAIN_BUFFER_H
+#define DWATER_NET_CHAIN_BUFFER_H
+
+#include "dwater/base/copyable.h"
+#include "dwater/base/mpsc_queue.h"
+#include "dwater/base/noncopable.h"
+#include "dwater/base/string_piece.h"
+#include "dwater/base/types.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <assert.h>
+
+struct iovec; // in <sys/uio.h>
+
+namespace dwater {
+
+namespace net {
+
+class BufferBlockPool;
+
+///
+/// slice引用的内存，引用计数，可以在不同的线程之间传递
+///
+class RefCountedBuffer : noncopyable {
+public:
+    void Ref() {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Unref() {
+        if ( refs_.fetch_sub(1, std::memory_order_acq_rel) == 1 ) {
+            Recycle();
+        }
+    }
+
+protected:
+    RefCountedBuffer() : refs_(1) {}
+    virtual ~RefCountedBuffer() {}
+
+    /// 最后一个引用释放的时候调用
+    virtual void Recycle() = 0;
+
+    std::atomic<int>    refs_;
+}; // class RefCountedBuffer
+
+///
+/// 固定大小的内存块，最后一个引用释放的时候删除或者还给分配它的BufferBlockPool
+///
+/// 一个块只有一个写者(分配它的ChainBuffer)，已经写入的部分不会再被修改，
+/// 所以多个slice可以同时引用同一个块
+class BufferBlock : public RefCountedBuffer, public MpscNode {
+public:
+    static const size_t ksize = 16 * 1024 - 64; // 加上块头之后不超过16KB
+
+    ///
+    /// 新分配一个不属于任何池的块，引用计数为1
+    ///
+    static BufferBlock* New();
+
+    char* Data() { return data_; }
+
+    const char* Data() const { return data_; }
+
+private:
+    friend class BufferBlockPool;
+
+    explicit BufferBlock(BufferBlockPool* pool) : pool_(pool) {}
+    ~BufferBlock() {}
+
+    /// 还给pool_或者删除
+    void Recycle() override;
+
+    BufferBlockPool*    pool_;
+    char                data_[ksize];
+}; // class BufferBlock
+
+///
+/// 用户自己的内存，ChainBuffer不拷贝，最后一个引用释放的时候调用完成回调
+///
+class ExternalBuffer : public RefCountedBuffer {
+public:
+    typedef std::function<void()> DoneCallback;
+
+    ///
+    /// 引用计数为1，@c data 在 @c done 被调用之前必须一直有效
+    ///
+    static ExternalBuffer* New(const DoneCallback& done);
+
+private:
+    explicit ExternalBuffer(const DoneCallback& done) : done_(done) {}
+    ~ExternalBuffer() {}
+
+    /// 调用done_之后删除自己
+    void Recycle() override;
+
+    DoneCallback    done_;
+}; // class ExternalBuffer
+
+///
+/// 块中的一段数据，持有块的一个引用
+///
+/// 块可以是BufferBlock，也可以是ExternalBuffer
+class BufferSlice : public dwater::copyable {
+public:
+    BufferSlice() : block_(NULL), data_(NULL), len_(0) {}
+
+    ///
+    /// 增加块的引用计数
+    ///
+    BufferSlice(RefCountedBuffer* block, const char* data, size_t len)
+        : block_(block), data_(data), len_(len) {
+        block_->Ref();
+    }
+
+    BufferSlice(const BufferSlice& rhs)
+        : block_(rhs.block_), data_(rhs.data_), len_(rhs.len_) {
+        if ( block_ ) {
+            block_->Ref();
+        }
+    }
+
+    BufferSlice(BufferSlice&& rhs)
+        : block_(rhs.block_), data_(rhs.data_), len_(rhs.len_) {
+        rhs.block_ = NULL;
+        rhs.data_ = NULL;
+        rhs.len_ = 0;
+    }
+
+    BufferSlice& operator=(BufferSlice rhs) {
+        Swap(rhs);
+        return *this;
+    }
+
+    ~BufferSlice() {
+        if ( block_ ) {
+            block_->Unref();
+        }
+    }
+
+    void Swap(BufferSlice& rhs) {
+        std::swap(block_, rhs.block_);
+        std::swap(data_, rhs.data_);
+        std::swap(len_, rhs.len_);
+    }
+
+    RefCountedBuffer* Block() const { return block_; }
+
+    const char* Data() const { return data_; }
+
+    size_t Size() const { return len_; }
+
+    StringPiece ToStringPiece() const {
+        return StringPiece(data_, static_cast<int>(len_));
+    }
+
+    void RemovePrefix(size_t n) {
+        assert(n <= len_);
+        data_ += n;
+        len_ -= n;
+    }
+
+    void RemoveSuffix(size_t n) {
+        assert(n <= len_);
+        len_ -= n;
+    }
+
+    ///
+    /// 块中紧跟在这个slice后面的数据也属于这个slice
+    ///
+    void Extend(size_t n) { len_ += n; }
+
+private:
+    RefCountedBuffer*   block_;
+    const char*         data_;
+    size_t              len_;
+}; // class BufferSlice
+
+///
+/// 链式buffer
+///
+/// 空的ChainBuffer不占用任何块，不是线程安全的
+class ChainBuffer : noncopyable {
+public:
+    static const int kmax_iov = 64; // 一次writev最多的slice数
+
+    ChainBuffer();
+    ~ChainBuffer();
+
+    ChainBuffer(ChainBuffer&& rhs);
+
+    void Swap(ChainBuffer& rhs);
+
+    ///
+    /// 新的块从 @c pool 中分配，为NULL时直接new，pool必须和这个ChainBuffer在同一个线程
+    ///
+    void SetBlockPool(BufferBlockPool* pool) { pool_ = pool; }
+
+    size_t ReadableBytes() const { return readable_; }
+
+    size_t SliceCount() const { return slices_.size() - head_; }
+
+    const BufferSlice& Slice(size_t i) const {
+        assert(i < SliceCount());
+        return slices_[head_ + i];
+    }
+
+    ///
+    /// 第一个slice的数据，没有数据的时候为空
+    ///
+    StringPiece FirstSlice() const {
+        return readable_ == 0 ? StringPiece() : slices_[head_].ToStringPiece();
+    }
+
+    void Append(const StringPiece& str) {
+        Append(str.Data(), str.Size());
+    }
+
+    ///
+    /// 拷贝到当前的写块中，写满了就分配新的块
+    ///
+    void Append(const void* data, size_t len);
+
+    ///
+    /// 把 @c other 中的数据全部移动到末尾，不拷贝数据
+    ///
+    void Append(ChainBuffer* other);
+
+    ///
+    /// 把 @c other 前面 @c len 字节移动到末尾，边界上的slice被两边共享
+    ///
+    void Append(ChainBuffer* other, size_t len);
+
+    ///
+    /// 追加一个slice，不拷贝数据
+    ///
+    void Append(const BufferSlice& slice);
+
+    ///
+    /// 追加用户的内存，不拷贝数据。这段数据被取走(写出或者丢弃)、并且不再被
+    /// 任何slice引用之后调用 @c done，@c done 在最后释放引用的线程中调用
+    ///
+    void AppendExternal(const void* data, size_t len, const ExternalBuffer::DoneCallback& done);
+
+    void Retrieve(size_t len);
+
+    void RetrieveAll();
+
+    string RetrieveAsString(size_t len);
+
+    string RetrieveAllAsString() {
+        return RetrieveAsString(readable_);
+    }
+
+    ///
+    /// 拷贝前面 @c len 字节到 @c out，不移除数据
+    ///
+    void Copy(char* out, size_t len) const;
+
+    ///
+    /// 填充iovec，最多 @c max_iov 个，返回填充的个数
+    ///
+    int FillIovec(struct iovec* iov, int max_iov) const;
+
+    ///
+    /// 用readv直接读到当前写块的剩余空间和新分配的块中，一次最多读64KB
+    ///
+    /// @return read(2)的返回值，出错的时候保存errno
+    ssize_t ReadFd(int fd, int* saved_errno);
+
+    ///
+    /// 用writev写出数据，移除已经写出的部分
+    ///
+    /// @return write(2)的返回值，出错的时候保存errno
+    ssize_t WriteFd(int fd, int* saved_errno) {
+        return WriteFd(fd, readable_, saved_errno);
+    }
+
+    ///
+    /// 最多写出前面 @c max_len 字节
+    ///
+    ssize_t WriteFd(int fd, size_t max_len, int* saved_errno);
+
+private:
+    static const size_t kmax_read = 64 * 1024;
+
+    /// 当前写块中写入了n个字节
+    void HasWritten(size_t n);
+
+    /// 当前写块已经写满，换一个新块
+    void SetWriteBlock(BufferBlock* block);
+
+    BufferBlock* NewBlock();
+
+    /// 数据都取走之后把写块也还回去，空闲的ChainBuffer不占用块
+    void ReleaseIfEmpty() {
+        if ( readable_ == 0 && write_block_ ) {
+            SetWriteBlock(NULL);
+        }
+    }
+
+    void PushBack(BufferSlice&& slice);
+
+    void PopFront();
+
+    std::vector<BufferSlice>    slices_;
+    size_t                      head_;          // 第一个有效的slice
+    size_t                      readable_;
+    BufferBlock*                write_block_;   // 只有这个ChainBuffer会往里写，持有一个引用
+    size_t                      write_index_;
+    BufferBlockPool*            pool_;
+}; // class ChainBuffer
+
+} // namespace net
+
+} // namespace dwater
+
+#endif // DWATER_NET_CHAIN_BUFFER_H
@@ -26,6 +26,7 @@ Channel::Channel(EventLoop* loop, int fd)
       revents_(0),
       index_(-1),
       log_hup_(true),
+      edge_triggered_(false),
       tied_(false),
       event_handling_(false),
       added_to_loop_(false) {}
@@ -84,7 +85,9 @@ void Channel::HandleEventWithGuard(Timestamp receive_time) {
         LOG_WARN << "fd = " << fd_ << " Channel::HandleEvent() POLLNVAL";
     }
 
-    if ( revents_ & (POLLERR | POLLNVAL) ) {
+    if ( (revents_ & POLLERR) && error_queue_callback_ ) {
+        error_queue_callback_();
+    } else if ( revents_ & (POLLERR | POLLNVAL) ) {
         if ( error_callback_ ) error_callback_();
     }
 
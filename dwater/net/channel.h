@@ -48,6 +48,14 @@ public:
         error_callback_ = std::move(cb);
     }
 
+    ///
+    /// 设置之后POLLERR交给这个回调处理，用来读取socket错误队列中的通知(比如
+    /// MSG_ZEROCOPY的完成通知)，错误队列不为空的时候POLLERR一直有效，回调必须把它读空
+    ///
+    void SetErrorQueueCallback(EventCallback cb) {
+        error_queue_callback_ = std::move(cb);
+    }
+
     void Tie(const std::shared_ptr<void>&);
 
     // 拥有的fd
@@ -107,6 +115,15 @@ public:
         return index_;
     }
 
+    // 边缘触发，只有EpollPoller会使用，回调函数必须一直读写到EAGAIN
+    void SetEdgeTriggered(bool on) {
+        edge_triggered_ = on;
+    }
+
+    bool EdgeTriggered() const {
+        return edge_triggered_;
+    }
+
     void SetIndex(int index) {
         index_ = index;
     }
@@ -139,6 +156,7 @@ private:
     int                     revents_;   // 目前活动的事件
     int                     index_;     // 在Poller事件数组中的索引
     bool                    log_hup_;   // 
+    bool                    edge_triggered_; // 是否使用EPOLLET注册
 
     std::weak_ptr<void>     tie_;       // 负责控制当前Channel的生存期
     bool                    tied_;
@@ -149,6 +167,7 @@ private:
     EventCallback           write_callback_;
     EventCallback           close_callback_;
     EventCallback           error_callback_;
+    EventCallback           error_queue_callback_;
 }; // class Channel
 
 } // namespace dwater
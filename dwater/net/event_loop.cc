@@ -8,7 +8,8 @@
 #include "dwater/net/event_loop.h"
 
 #include "dwater/base/logging.h"
-#include "dwater/base/mutex.h"
+#include "dwater/net/buffer.h"
+#include "dwater/net/buffer_block_pool.h"
 #include "dwater/net/channel.h"
 #include "dwater/net/poller.h"
 #include "dwater/net/socket_ops.h"
@@ -49,7 +50,7 @@ public:
 IgnoreSigPipe init_obj;
 } // unname namespace 
 
-EventLoop::EventLoop()
+EventLoop::EventLoop(TimerQueueOption option)
     : looping_(false),
       quit_(false),
       event_handling_(false),
@@ -57,10 +58,17 @@ EventLoop::EventLoop()
       iteration_(0),
       thread_id_(current_thread::Tid()),
       poller_(Poller::NewDefaultPoller(this)),
-      timer_queue_(new TimerQueue(this)),
+      timer_queue_(option == kdefault_timer_queue
+                   ? TimerQueue::NewDefaultTimerQueue(this)
+                   : TimerQueue::NewTimerQueue(this, option == kwheel_timer_queue)),
       wakeup_fd_(CreateEventfd()),
       wakeup_channel_(new Channel(this, wakeup_fd_)),
-      curr_active_channel_(NULL) {
+      curr_active_channel_(NULL),
+      pending_count_(0),
+      wakeup_pending_(false),
+      connection_count_(0),
+      block_pool_(new BufferBlockPool),
+      shared_input_buffer_(new Buffer) {
     
     LOG_DEBUG << "EventLoop created " << this << " in thread" << thread_id_;
     if ( t_loop_in_this_thread ) {
@@ -81,6 +89,10 @@ EventLoop::~EventLoop() {
     wakeup_channel_->Remove();
     ::close(wakeup_fd_);
     t_loop_in_this_thread = NULL;
+    while ( MpscNode* node = pending_functors_.Pop() ) {
+        delete static_cast<FunctorNode*>(node);
+    }
+    block_pool_->Close();
 }
 
 void EventLoop::Loop() {
@@ -132,18 +144,19 @@ void EventLoop::RunInLoop(Functor cb) {
 }
 
 void EventLoop::QueueInLoop(Functor cb) {
-    {
-        MutexLockGuard lock(mutex_);
-        pending_functors_.push_back(std::move(cb));
-    }
+    pending_functors_.Push(new FunctorNode(std::move(cb)));
+    pending_count_.fetch_add(1, std::memory_order_relaxed);
+    // 必须在Push()之后，DoPendingFunctors()先清除标志再取队列，
+    // 所以要么这次入队被本轮取走，要么这里会看到false并唤醒
     if ( !IsInLoopThread() || calling_pending_functors_ ) {
-        Wakeup();
+        if ( !wakeup_pending_.exchange(true) ) {
+            Wakeup();
+        }
     }
 }
 
 size_t EventLoop::QueueSize() const {
-    MutexLockGuard lock(mutex_);
-    return pending_functors_.size();
+    return pending_count_.load(std::memory_order_relaxed);
 }
 
 TimerId EventLoop::RunAt(Timestamp time, TimerCallback cb) {
@@ -211,15 +224,21 @@ void EventLoop::HandleRead() {
 }
 
 void EventLoop::DoPendingFunctors() {
-    std::vector<Functor> functors;
     calling_pending_functors_ = true;
-    {
-        MutexLockGuard lock(mutex_);
-        functors.swap(pending_functors_);
-    }
-
-    for ( const Functor& functor : functors ) {
-        functor();
+    wakeup_pending_.store(false);
+
+    // 只执行进入时已经在队列中的函数，执行过程中新加入的留到下一轮，
+    // 和原来swap一个vector的语义一致
+    size_t n = pending_count_.load(std::memory_order_acquire);
+    for ( ; n > 0; --n ) {
+        MpscNode* node = pending_functors_.Pop();
+        if ( node == NULL ) {
+            break; // 生产者还没有完成Push()，它会负责唤醒
+        }
+        pending_count_.fetch_sub(1, std::memory_order_relaxed);
+        FunctorNode* functor_node = static_cast<FunctorNode*>(node);
+        functor_node->functor();
+        delete functor_node;
     }
     calling_pending_functors_ = false;
 }
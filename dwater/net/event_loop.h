@@ -9,8 +9,8 @@
 #ifndef DWATER_NET_EVENT_LOOP_H
 #define DWATER_NET_EVENT_LOOP_H
 
-#include "dwater/base/mutex.h"
 #include "dwater/base/current_thread.h"
+#include "dwater/base/mpsc_queue.h"
 #include "dwater/base/timestamp.h"
 #include "dwater/net/callbacks.h"
 #include "dwater/net/timerid.h"
@@ -26,6 +26,7 @@ namespace dwater {
 namespace net {
 
 // forward declaretion
+class BufferBlockPool;  // 连接缓冲区的内存块池
 class Channel;          // 每个socket连接的事件分发
 class Poller;           // IO复用的基类借口
 class TimerQueue;       // 定时器队列
@@ -33,11 +34,21 @@ class TimerQueue;       // 定时器队列
 class EventLoop : noncopyable {
 public:
     typedef std::function<void()> Functor;
+
+    ///
+    /// 定时器队列的实现，kdefault_timer_queue由环境变量DWATER_USE_TIMER_WHEEL决定
+    ///
+    enum TimerQueueOption {
+        kdefault_timer_queue,
+        ktree_timer_queue,  // std::set，插入删除O(logN)
+        kwheel_timer_queue, // 分层时间轮，插入删除O(1)，精度1ms
+    };
+
     ///
     /// @brief 一个线程只能有一个LoopEvent对象，构造函数在构造对象的时候检查当前线程
     ///         是否已经有其他的LoopEvent对象了，如已经有就终止程序LOG_FATAL
     /// 
-    EventLoop(); 
+    explicit EventLoop(TimerQueueOption option = kdefault_timer_queue);
 
     ~EventLoop();
 
@@ -73,7 +84,7 @@ public:
     /// @prama cb 要添加的回调函数
     /// 
     /// 如果此时不是在当前线程执行，那么就将回调函数加入到队列中，之后
-    /// 再执行
+    /// 再执行。队列是无锁的，一轮DoPendingFunctors()之后只有第一次入队会写wakeup_fd_
     void QueueInLoop(Functor cb); // queues callback in the loop thread
 
     /// 
@@ -81,6 +92,33 @@ public:
     /// 
     size_t QueueSize() const; // callback queue size
 
+    ///
+    /// @brief 属于这个EventLoop、还没有断开的TcpConnection个数，可以在任意线程读取
+    ///
+    /// TcpConnection构造的时候加一，断开的时候减一，用来做负载均衡
+    int ConnectionCount() const {
+        return connection_count_.load(std::memory_order_relaxed);
+    }
+
+    void AddConnectionCount(int delta) {
+        connection_count_.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    ///
+    /// @brief 这个EventLoop中连接的ChainBuffer使用的内存块池，只能在所属线程使用
+    ///
+    BufferBlockPool* BlockPool() const {
+        return block_pool_;
+    }
+
+    ///
+    /// @brief 连接的输入缓冲区为空的时候先读到这个共享的Buffer中，处理完剩下的数据
+    ///        才拷贝到连接自己的缓冲区，这样空闲的连接不需要一直持有输入缓冲区
+    ///
+    Buffer* SharedInputBuffer() {
+        return shared_input_buffer_.get();
+    }
+
     /// 
     /// @brief 添加定时器事件，在某个具体的时间执行
     /// @prama time 回调函数执行的时间
@@ -170,6 +208,11 @@ private:
 
     typedef std::vector<Channel*> ChannelList;
 
+    struct FunctorNode : MpscNode {
+        explicit FunctorNode(Functor cb) : functor(std::move(cb)) {}
+        Functor functor;
+    };
+
     bool                        looping_; // atomic
     std::atomic<bool>           quit_;
     bool                        event_handling_; // atomic
@@ -187,8 +230,12 @@ private:
     ChannelList                 active_channels_; // 就绪的Channel
     Channel*                    curr_active_channel_; // 当前正在处理的Channel
 
-    mutable MutexLock           mutex_;
-    std::vector<Functor>        pending_functors_ GUARDED_BY(mutex_); // EventLoop需要执行的函数对象
+    MpscQueue                   pending_functors_; // EventLoop需要执行的函数对象，FunctorNode
+    std::atomic<size_t>         pending_count_; // pending_functors_中的函数个数
+    std::atomic<bool>           wakeup_pending_; // 上一次DoPendingFunctors()之后是否已经写过wakeup_fd_
+    std::atomic<int>            connection_count_;
+    BufferBlockPool*            block_pool_; // 自己管理生命周期，析构的时候Close()
+    std::unique_ptr<Buffer>     shared_input_buffer_;
 }; // class EventLoop
 
 } // namespace net
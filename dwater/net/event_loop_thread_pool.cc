@@ -10,6 +10,8 @@
 #include "dwater/net/event_loop.h"
 #include "dwater/net/event_loop_thread.h"
 
+#include <algorithm>
+
 #include <stdio.h>
 
 using namespace dwater;
@@ -20,7 +22,9 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* base_loop, const string& nam
       name_(name),
       started_(false),
       num_thread_(0),
-      next_(0) {}
+      next_(0),
+      selection_(kround_robin),
+      seed_(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this)) | 1) {}
 
 EventLoopThreadPool::~EventLoopThreadPool() {
 // 线程池不会被删除
@@ -37,6 +41,10 @@ void EventLoopThreadPool::Start(const ThreadInitCallback& cb) {
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->StartLoop());
     }
+    selected_.reset(new std::atomic<int64_t>[loops_.size()]);
+    for ( size_t i = 0; i < loops_.size(); ++i ) {
+        selected_[i].store(0, std::memory_order_relaxed);
+    }
     if ( num_thread_ == 0 && cb ) {
         cb(base_loop_);
     }
@@ -45,15 +53,83 @@ void EventLoopThreadPool::Start(const ThreadInitCallback& cb) {
 EventLoop* EventLoopThreadPool::GetNextLoop() {
     base_loop_->AssertInLoopThread();
     assert(started_);
-    EventLoop* loop = base_loop_;
-    if ( !loops_.empty() ) {
-        loop = loops_[next_];
-        ++next_;
-        if ( implicit_cast<size_t>(next_) >= loops_.size() ) {
-            next_ = 0;
+    if ( loops_.empty() ) {
+        return base_loop_;
+    }
+    size_t index = 0;
+    if ( selector_ ) {
+        EventLoop* loop = selector_(loops_);
+        index = std::find(loops_.begin(), loops_.end(), loop) - loops_.begin();
+        assert(index < loops_.size());
+    } else {
+        switch ( selection_ ) {
+        case kleast_connections:
+            index = SelectLeast(&EventLoop::ConnectionCount);
+            break;
+        case kleast_queue_size:
+            index = SelectLeast(&EventLoop::QueueSize);
+            break;
+        case kpower_of_two_choices:
+            index = SelectFromTwoChoices();
+            break;
+        case kround_robin:
+        default:
+            index = next_;
+            ++next_;
+            if ( implicit_cast<size_t>(next_) >= loops_.size() ) {
+                next_ = 0;
+            }
+            break;
         }
     }
-    return loop;
+    // 只在base_loop_中写，GetLoads()可能在别的线程读
+    selected_[index].fetch_add(1, std::memory_order_relaxed);
+    return loops_[index];
+}
+
+///
+/// 从next_开始找，负载相同的时候轮流选择，而不是总选第一个
+///
+template<typename T>
+size_t EventLoopThreadPool::SelectLeast(T (EventLoop::*load)() const) {
+    size_t best = next_;
+    T best_load = (loops_[best]->*load)();
+    for ( size_t i = 1; i < loops_.size() && best_load > 0; ++i ) {
+        size_t index = (next_ + i) % loops_.size();
+        T current = (loops_[index]->*load)();
+        if ( current < best_load ) {
+            best = index;
+            best_load = current;
+        }
+    }
+    next_ = static_cast<int>((best + 1) % loops_.size());
+    return best;
+}
+
+///
+/// 随机选两个不同的线程，连接数少的胜出，相同时比较回调队列长度
+///
+size_t EventLoopThreadPool::SelectFromTwoChoices() {
+    size_t n = loops_.size();
+    if ( n == 1 ) {
+        return 0;
+    }
+    size_t first = NextRandom() % n;
+    size_t second = (first + 1 + NextRandom() % (n - 1)) % n;
+    EventLoop* a = loops_[first];
+    EventLoop* b = loops_[second];
+    if ( a->ConnectionCount() != b->ConnectionCount() ) {
+        return a->ConnectionCount() < b->ConnectionCount() ? first : second;
+    }
+    return a->QueueSize() <= b->QueueSize() ? first : second;
+}
+
+uint32_t EventLoopThreadPool::NextRandom() {
+    // xorshift32，只在base_loop_线程中调用
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
 }
 
 EventLoop* EventLoopThreadPool::GetLoopForHash(size_t hash_code) {
@@ -74,3 +150,19 @@ std::vector<EventLoop*> EventLoopThreadPool::GetAllLoops() {
         return loops_;
     }
 }
+
+std::vector<EventLoopThreadPool::LoopLoad> EventLoopThreadPool::GetLoads() {
+    assert(started_);
+    // Start()之后loops_不再改变，不用在base_loop_中读
+    std::vector<LoopLoad> loads;
+    std::vector<EventLoop*> loops = loops_.empty() ? std::vector<EventLoop*>(1, base_loop_) : loops_;
+    for ( size_t i = 0; i < loops.size(); ++i ) {
+        LoopLoad load;
+        load.loop = loops[i];
+        load.connections = loops[i]->ConnectionCount();
+        load.queue_size = loops[i]->QueueSize();
+        load.selected = loops_.empty() ? 0 : selected_[i].load(std::memory_order_relaxed);
+        loads.push_back(load);
+    }
+    return loads;
+}
@@ -10,6 +10,7 @@
 #include "dwater/base/noncopable.h"
 #include "dwater/base/types.h"
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <functional>
@@ -28,6 +29,31 @@ class EventLoopThreadPool : noncopyable {
 public:
     typedef std::function<void (EventLoop*)> ThreadInitCallback;
 
+    ///
+    /// 自定义的选择策略，参数是所有IO线程的EventLoop，不会为空
+    ///
+    typedef std::function<EventLoop* (const std::vector<EventLoop*>&)> LoopSelector;
+
+    ///
+    /// GetNextLoop()选择IO线程的策略
+    ///
+    enum LoopSelection {
+        kround_robin,
+        kleast_connections,     // 连接数最少
+        kleast_queue_size,      // 待执行的回调函数最少
+        kpower_of_two_choices,  // 随机选两个，取连接数少的
+    };
+
+    ///
+    /// 每个IO线程的负载
+    ///
+    struct LoopLoad {
+        EventLoop*  loop;
+        int         connections;
+        size_t      queue_size;
+        int64_t     selected;   // 被GetNextLoop()选中的次数
+    };
+
     EventLoopThreadPool(EventLoop* base_loop, const string& name);
 
     ///
@@ -46,7 +72,19 @@ public:
     void Start(const ThreadInitCallback& cb = ThreadInitCallback());
 
     ///
-    /// 获取下一个线程，使用round-robin算法，返回线程里的EventLoop，没有了从0开始获取
+    /// 设置GetNextLoop()的策略，默认是kround_robin
+    ///
+    void SetLoopSelection(LoopSelection selection) {
+        selection_ = selection;
+        selector_ = LoopSelector();
+    }
+
+    void SetLoopSelector(const LoopSelector& selector) {
+        selector_ = selector;
+    }
+
+    ///
+    /// 获取下一个线程，默认使用round-robin算法，返回线程里的EventLoop，没有了从0开始获取
     /// 
     EventLoop* GetNextLoop();
 
@@ -58,15 +96,30 @@ public:
 
     std::vector<EventLoop*> GetAllLoops();
 
+    ///
+    /// 每个IO线程当前的负载，用来观察是否均衡。Start()之后任何线程都可以调用，
+    /// 各项计数是分别读的，不是同一时刻的快照
+    ///
+    std::vector<LoopLoad> GetLoads();
+
     bool Started() const { return started_; }
 
     const string& Name() const { return name_; }
 private:
+    template<typename T>
+    size_t SelectLeast(T (EventLoop::*load)() const);
+    size_t SelectFromTwoChoices();
+    uint32_t NextRandom();
+
     EventLoop*      base_loop_;
     string          name_;
     bool            started_;
     int             num_thread_;
     int             next_;
+    LoopSelection   selection_;
+    LoopSelector    selector_;
+    uint32_t        seed_;      // kpower_of_two_choices的随机数
+    std::unique_ptr<std::atomic<int64_t>[]> selected_;  // 和loops_一一对应
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
 };
@@ -1,83 +1,287 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.04.09
+// Last modified:   2021.04.17
 // Filename:        http_context.cc
-// Descripton:       
+// Descripton:
 
 #include "dwater/net/http/http_context.h"
 
 #include "dwater/net/buffer.h"
 
+#include <algorithm>
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
 using namespace dwater;
 using namespace dwater::net;
 
-bool HttpContext::ProcessRequestLine(const char* begin, const char* end) {
-    bool succeed = false;
-    const char* start = begin;
-    const char* space = std::find(start, end, ' ');
-    if ( space != end && request_.SetMethod(start, space) ) {
-        start = space + 1;
-        space = std::find(start, end, ' ');
-        if ( space != end ) {
-            const char* question = std::find(start, space, '?');
-            if ( question != space ) {
-                request_.SetPath(start, question);
-                request_.SetQuery(question, space);
-            } else {
-                request_.SetPath(start, space);
-            }
+const size_t HttpContext::kmax_header_size;
+const size_t HttpContext::kdefault_max_body_size;
+const size_t HttpContext::kmax_chunk_line;
 
-            start  = space + 1;
-            succeed = end - start == 8 && std::equal(start, end - 1, "HTTP/1.");
-            if ( succeed ) {
-                if ( *(end - 1) == '1' ) {
-                    request_.SetVersion(HttpRequest::khttp11);
-                } else if ( *(end - 1) == '0' ) {
-                    request_.SetVersion(HttpRequest::khttp10);
-                } else {
-                    succeed = false;
-                }
-            }
+namespace {
+
+int HexDigit(char c) {
+    if ( c >= '0' && c <= '9' ) {
+        return c - '0';
+    } else if ( c >= 'a' && c <= 'f' ) {
+        return c - 'a' + 10;
+    } else if ( c >= 'A' && c <= 'F' ) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+bool HttpContext::ProcessRequestLine(const char* begin, const scan::LineScan& line) {
+    // "METHOD URI HTTP/1.x"，正好两个空格，方法名是token
+    if ( line.count != 2 || line.first == begin || !line.token ||
+         line.last - line.first < 2 || line.crlf - line.last != 9 ||
+         ::memcmp(line.last + 1, "HTTP/1.", 7) != 0 ) {
+        return false;
+    }
+    char minor = line.crlf[-1];
+    if ( minor == '1' ) {
+        request_.SetVersion(HttpRequest::khttp11);
+    } else if ( minor == '0' ) {
+        request_.SetVersion(HttpRequest::khttp10);
+    } else {
+        return false;
+    }
+    if ( !request_.SetMethod(begin, line.first) ) {
+        return false;
+    }
+
+    const char* uri = line.first + 1;
+    const char* question = static_cast<const char*>(::memchr(uri, '?', line.last - uri));
+    if ( question != NULL ) {
+        request_.SetPath(uri, question);
+        request_.SetQuery(question, line.last);
+    } else {
+        request_.SetPath(uri, line.last);
+    }
+    return true;
+}
+
+bool HttpContext::ProcessHeaders(const char* begin, const char* end) {
+    // 每一行只扫描一次，同时找到行尾和分隔符，并检查字段名
+    scan::LineScan line;
+    scan::ScanLine(begin, end, ' ', &line);
+    if ( !ProcessRequestLine(begin, line) ) {
+        return false;
+    }
+    const char* start = line.crlf + 2;
+    for ( ;; ) {
+        scan::ScanField(start, end, ':', &line);
+        if ( line.crlf == start ) {
+            break;
         }
+        if ( line.first == NULL || line.first == start || !line.token ) {
+            return false;
+        }
+        request_.AddHeader(start, line.first, line.crlf);
+        start = line.crlf + 2;
     }
-    return succeed;
+    return true;
 }
 
-bool HttpContext::ParseRequest(Buffer* buf, Timestamp receive_time) {
-    bool ok = true;
-    bool has_more = true;
-    while ( has_more ) {
-        if ( state_ == kexpect_request_line ) {
+bool HttpContext::PrepareBody() {
+    StringPiece encoding = request_.GetHeader("Transfer-Encoding");
+    if ( !encoding.Empty() ) {
+        // 只支持chunked，而且必须是最后一个编码
+        if ( encoding.Size() < 7 || ::strncasecmp(encoding.End() - 7, "chunked", 7) != 0 ) {
+            return Fail(kbad_request);
+        }
+        chunked_ = true;
+        chunk_state_ = kchunk_size;
+        return true;
+    }
+
+    StringPiece length = request_.GetHeader("Content-Length");
+    size_t n = 0;
+    for ( int i = 0; i < length.Size(); ++i ) {
+        if ( !isdigit(length[i]) ) {
+            return Fail(kbad_request);
+        }
+        if ( n > max_body_size_ / 10 ) {
+            return Fail(kbody_too_large);
+        }
+        n = n * 10 + (length[i] - '0');
+    }
+    if ( n > max_body_size_ ) {
+        return Fail(kbody_too_large);
+    }
+    body_remaining_ = n;
+    return true;
+}
+
+bool HttpContext::BodyComplete(const Buffer* buf, const char* end) const {
+    return static_cast<size_t>(buf->BeginWrite() - end) >= body_remaining_;
+}
+
+size_t HttpContext::ConsumeBody(Buffer* buf, size_t len) {
+    size_t n = std::min(len, buf->ReadableBytes());
+    if ( n > 0 ) {
+        if ( body_callback_ ) {
+            body_callback_(StringPiece(buf->Peek(), static_cast<int>(n)));
+        } else {
+            request_.AppendBody(buf->Peek(), n);
+        }
+        buf->Retrieve(n);
+        body_received_ += n;
+        expect_continue_ = false;
+    }
+    return n;
+}
+
+void HttpContext::FinishBody() {
+    if ( body_callback_ ) {
+        body_callback_(StringPiece());
+    }
+    state_ = k_got_all;
+}
+
+bool HttpContext::ParseBody(Buffer* buf) {
+    if ( chunked_ ) {
+        return ParseChunked(buf);
+    }
+    body_remaining_ -= ConsumeBody(buf, body_remaining_);
+    if ( body_remaining_ == 0 ) {
+        FinishBody();
+    }
+    return true;
+}
+
+bool HttpContext::ParseChunked(Buffer* buf) {
+    while ( state_ == kexpect_body ) {
+        if ( chunk_state_ == kchunk_data ) {
+            body_remaining_ -= ConsumeBody(buf, body_remaining_);
+            if ( body_remaining_ > 0 ) {
+                break;
+            }
+            chunk_state_ = kchunk_data_crlf;
+        } else if ( chunk_state_ == kchunk_data_crlf ) {
+            if ( buf->ReadableBytes() < 2 ) {
+                break;
+            }
+            if ( buf->Peek()[0] != '\r' || buf->Peek()[1] != '\n' ) {
+                return Fail(kbad_request);
+            }
+            buf->Retrieve(2);
+            chunk_state_ = kchunk_size;
+        } else {
             const char* crlf = buf->FindCRLF();
-            if ( crlf ) {
-                ok = ProcessRequestLine(buf->Peek(), crlf);
-                if ( ok ) {
-                    request_.SetReceiveTime(receive_time);
-                    buf->RetrieveUntil(crlf + 2);
-                    state_ = kexpect_headers;
-                } else {
-                    has_more = false;
+            if ( crlf == NULL ) {
+                if ( buf->ReadableBytes() > kmax_chunk_line ) {
+                    return Fail(kbad_request);
                 }
-            } else {
-                has_more = false;
+                break;
             }
-        } else if ( state_ == kexpect_headers ) {
-            const char* crlf = buf->FindCRLF();
-            if ( crlf ) {
-                const char* colon = std::find(buf->Peek(), crlf, ':');
-                if ( colon != crlf ) {
-                    request_.AddHeader(buf->Peek(), colon, crlf);
-                } else {
-                    state_ = k_got_all;
-                    has_more = false;
+            if ( chunk_state_ == kchunk_size ) {
+                // 十六进制的大小，后面可能有";"开头的扩展，忽略
+                const char* p = buf->Peek();
+                size_t size = 0;
+                for ( ; p < crlf && *p != ';'; ++p ) {
+                    int digit = HexDigit(*p);
+                    if ( digit < 0 ) {
+                        return Fail(kbad_request);
+                    }
+                    if ( size > max_body_size_ / 16 ) {
+                        return Fail(kbody_too_large);
+                    }
+                    size = size * 16 + digit;
+                }
+                if ( p == buf->Peek() ) {
+                    return Fail(kbad_request);
+                }
+                if ( size > max_body_size_ - body_received_ ) {
+                    return Fail(kbody_too_large);
                 }
                 buf->RetrieveUntil(crlf + 2);
+                body_remaining_ = size;
+                chunk_state_ = size == 0 ? kchunk_trailer : kchunk_data;
             } else {
-                has_more = false;
+                // trailer都丢掉，空行表示结束
+                bool last = crlf == buf->Peek();
+                buf->RetrieveUntil(crlf + 2);
+                if ( last ) {
+                    FinishBody();
+                }
             }
-        } else if ( state_ == kexpect_body ) {
-            // FIXME: not write
         }
     }
-    return ok;
+    return true;
+}
+
+bool HttpContext::ParseRequest(Buffer* buf, Timestamp receive_time) {
+    if ( error_ != kno_error ) {
+        return false;
+    }
+    if ( state_ == kexpect_body ) {
+        return ParseBody(buf);
+    }
+    if ( state_ == k_got_all ) {
+        return true;
+    }
+    // 忽略请求前面多余的空行
+    while ( state_ == kexpect_request_line && buf->ReadableBytes() >= 2 &&
+            buf->Peek()[0] == '\r' && buf->Peek()[1] == '\n' ) {
+        buf->Retrieve(2);
+    }
+
+    if ( buf->ReadableBytes() > 0 ) {
+        state_ = kexpect_headers;
+    }
+
+    // 前面没有空行，第一个"\r\n\r\n"就是头部的结尾
+    const char* found = scan::FindDoubleCRLF(buf->Peek() + scanned_, buf->BeginWrite());
+    if ( found == NULL ) {
+        // 结尾可能跨过这次收到的数据，最后3个字节下次再找
+        scanned_ = buf->ReadableBytes() > 3 ? buf->ReadableBytes() - 3 : 0;
+        return buf->ReadableBytes() <= kmax_header_size || Fail(kbad_request);
+    }
+    const char* end = found + 4;
+    // 整个头部在一次读到的数据里也要检查长度
+    if ( static_cast<size_t>(end - buf->Peek()) > kmax_header_size ) {
+        return Fail(kbad_request);
+    }
+
+    if ( !ProcessHeaders(buf->Peek(), end) ) {
+        return Fail(kbad_request);
+    }
+    if ( !PrepareBody() ) {
+        return false;
+    }
+    request_.SetReceiveTime(receive_time);
+
+    if ( stream_body_callback_ && (chunked_ || body_remaining_ > 0) ) {
+        body_callback_ = stream_body_callback_(request_);
+    }
+    if ( !chunked_ && !body_callback_ && BodyComplete(buf, end) ) {
+        request_.SetBody(end, end + body_remaining_);
+        if ( mode_ == kcopy_request ) {
+            request_.Detach();
+        }
+        // Buffer::Retrieve()只移动读的位置，kview_request模式下请求引用的数据
+        // 在下一次写入Buffer之前都还在
+        buf->RetrieveUntil(end + body_remaining_);
+        body_remaining_ = 0;
+        state_ = k_got_all;
+        return true;
+    }
+
+    // body要等后面的数据，请求不能再引用buf
+    request_.Detach();
+    buf->RetrieveUntil(end);
+    if ( !chunked_ && !body_callback_ ) {
+        request_.ReserveBody(body_remaining_);
+    }
+    expect_continue_ = buf->ReadableBytes() == 0 &&
+        request_.GetHeader("Expect").Size() == 12 &&
+        ::strncasecmp(request_.GetHeader("Expect").Data(), "100-continue", 12) == 0;
+    state_ = kexpect_body;
+    return ParseBody(buf);
 }
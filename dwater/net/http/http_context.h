@@ -1,8 +1,8 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.04.09
+// Last modified:   2021.04.17
 // Filename:        http_context.h
-// Descripton:       
+// Descripton:
 
 #ifndef DWATER_NET_HTTP_HTTP_CONTEXT_H
 #define DWATER_NET_HTTP_HTTP_CONTEXT_H
@@ -10,6 +10,9 @@
 #include "dwater/base/copyable.h"
 
 #include "dwater/net/http/http_request.h"
+#include "dwater/net/simd_scan.h"
+
+#include <functional>
 
 namespace dwater {
 namespace net {
@@ -25,18 +28,98 @@ public:
         k_got_all,
     };
 
-    HttpContext() : state_(kexpect_request_line) {  }
+    ///
+    /// kview_request: 请求中的StringPiece直接指向输入Buffer，只在处理这个请求的
+    /// 回调中有效(Buffer被再次写入之前)；kcopy_request: 解析完之后拷贝到请求中
+    ///
+    enum ParseMode {
+        kcopy_request,
+        kview_request,
+    };
+
+    enum ParseError {
+        kno_error,
+        kbad_request,
+        kbody_too_large,
+    };
+
+    ///
+    /// 流式接收body时每收到一段调用一次，最后用空的 @c data 调用一次表示body结束
+    ///
+    typedef std::function<void (const StringPiece& data)> BodyCallback;
+
+    ///
+    /// 有body的请求头部解析完之后调用，返回非空的BodyCallback时body交给它，
+    /// 不保存在请求中；返回空的时候照常收齐整个body
+    ///
+    typedef std::function<BodyCallback (const HttpRequest&)> StreamBodyCallback;
+
+    static const size_t kmax_header_size = 64 * 1024; // 请求行加头部的上限
+    static const size_t kdefault_max_body_size = 1024 * 1024;
+
+    explicit HttpContext(ParseMode mode = kcopy_request)
+        : state_(kexpect_request_line),
+          mode_(mode),
+          error_(kno_error),
+          scanned_(0),
+          max_body_size_(kdefault_max_body_size),
+          chunked_(false),
+          chunk_state_(kchunk_size),
+          body_remaining_(0),
+          body_received_(0),
+          expect_continue_(false) {  }
 
+    ///
+    /// 流式接收的body也受这个限制
+    ///
+    void SetMaxBodySize(size_t max_body_size) {
+        max_body_size_ = max_body_size;
+    }
+
+    void SetStreamBodyCallback(const StreamBodyCallback& cb) {
+        stream_body_callback_ = cb;
+    }
+
+    ///
+    /// 头部完整之前不取走数据，也不解析，只记录已经扫描过的位置。
+    /// body按Content-Length或者chunked编码增量解析，收到多少处理多少
+    ///
+    /// @return 请求格式错误、头部或者body太长时返回false，原因见Error()
     bool ParseRequest(Buffer* buf, Timestamp receive_time);
 
     bool GotAll() const {
         return state_ == k_got_all;
     }
 
+    ParseError Error() const {
+        return error_;
+    }
+
+    ///
+    /// 请求带着"Expect: 100-continue"，body还没有收到，应该先回复100 Continue
+    ///
+    bool ExpectContinue() const {
+        return expect_continue_;
+    }
+
+    void ContinueSent() {
+        expect_continue_ = false;
+    }
+
     void Reset() {
         state_ = kexpect_request_line;
-        HttpRequest dummy;
-        request_.Swap(dummy);
+        scanned_ = 0;
+        chunked_ = false;
+        chunk_state_ = kchunk_size;
+        body_remaining_ = 0;
+        body_received_ = 0;
+        expect_continue_ = false;
+        body_callback_ = BodyCallback();
+        request_.Reset();
+    }
+
+    ParseMode Mode() const {
+        return mode_;
     }
 
     const HttpRequest& Requeset() const {
@@ -48,12 +131,54 @@ public:
     }
 
 private:
-    bool ProcessRequestLine(const char* begin, const char* end);
+    enum ChunkState {
+        kchunk_size,
+        kchunk_data,
+        kchunk_data_crlf,
+        kchunk_trailer,
+    };
+
+    static const size_t kmax_chunk_line = 1024; // chunk大小行和trailer行的上限
+
+    bool ProcessRequestLine(const char* begin, const scan::LineScan& line);
+
+    /// [begin, end)是完整的请求行和头部，包括最后的空行
+    bool ProcessHeaders(const char* begin, const char* end);
+
+    /// 根据Transfer-Encoding和Content-Length决定怎么接收body
+    bool PrepareBody();
+
+    /// 头部之后是否已经有完整的body，有的话直接引用，不拷贝
+    bool BodyComplete(const Buffer* buf, const char* end) const;
+
+    bool ParseBody(Buffer* buf);
+    bool ParseChunked(Buffer* buf);
+
+    /// 取走buf前面最多 @c len 字节的body数据，返回取走的字节数
+    size_t ConsumeBody(Buffer* buf, size_t len);
+
+    void FinishBody();
+
+    bool Fail(ParseError error) {
+        error_ = error;
+        return false;
+    }
 
     HttpRequestParseState state_;
+    ParseMode             mode_;
+    ParseError            error_;
+    size_t                scanned_; // 从Peek()开始已经找过头部结尾的字节数
+    size_t                max_body_size_;
+    bool                  chunked_;
+    ChunkState            chunk_state_;
+    size_t                body_remaining_; // Content-Length或者当前chunk还没有收到的字节数
+    size_t                body_received_;
+    bool                  expect_continue_;
+    StreamBodyCallback    stream_body_callback_;
+    BodyCallback          body_callback_;
     HttpRequest           request_;
 };
 }
 }
 
-#endif // DWATER_NET_HTTP_HTTP_CONTEXT_H 
+#endif // DWATER_NET_HTTP_HTTP_CONTEXT_H
@@ -0,0 +1,81 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_request.cc
+// Descripton:
+
+#include "dwater/net/http/http_request.h"
+
+#include <utility>
+
+using namespace dwater;
+using namespace dwater::net;
+
+const size_t HttpRequest::kmax_kept_body_capacity;
+
+void HttpRequest::Detach() {
+    size_t len = path_.Size() + query_.Size();
+    for ( const Header& header : headers_ ) {
+        len += header.field.Size() + header.value.Size();
+    }
+    len += body_.Size();
+    string storage;
+    storage.reserve(len);
+    storage.append(path_.Data(), path_.Size());
+    storage.append(query_.Data(), query_.Size());
+    for ( const Header& header : headers_ ) {
+        storage.append(header.field.Data(), header.field.Size());
+        storage.append(header.value.Data(), header.value.Size());
+    }
+    storage.append(body_.Data(), body_.Size());
+    storage_.swap(storage);
+    Rebind(storage_.data());
+}
+
+void HttpRequest::CopyFrom(const HttpRequest& rhs) {
+    method_ = rhs.method_;
+    version_ = rhs.version_;
+    path_ = rhs.path_;
+    query_ = rhs.query_;
+    receive_time_ = rhs.receive_time_;
+    headers_ = rhs.headers_;
+    body_ = rhs.body_;
+    body_buffer_ = rhs.body_buffer_;
+    // rhs可能还引用着输入Buffer，拷贝出来的请求总是用自己的storage_
+    Detach();
+}
+
+void HttpRequest::Swap(HttpRequest& that) {
+    bool detached = Detached();
+    bool that_detached = that.Detached();
+    std::swap(method_, that.method_);
+    std::swap(version_, that.version_);
+    std::swap(path_, that.path_);
+    std::swap(query_, that.query_);
+    std::swap(receive_time_, that.receive_time_);
+    headers_.swap(that.headers_);
+    std::swap(body_, that.body_);
+    body_buffer_.swap(that.body_buffer_);
+    storage_.swap(that.storage_);
+    // 短字符串存在string对象里面，交换之后数据的位置变了
+    if ( that_detached ) {
+        Rebind(storage_.data());
+    }
+    if ( detached ) {
+        that.Rebind(that.storage_.data());
+    }
+}
+
+void HttpRequest::Rebind(const char* base) {
+    path_.Set(base, path_.Size());
+    base += path_.Size();
+    query_.Set(base, query_.Size());
+    base += query_.Size();
+    for ( Header& header : headers_ ) {
+        header.field.Set(base, header.field.Size());
+        base += header.field.Size();
+        header.value.Set(base, header.value.Size());
+        base += header.value.Size();
+    }
+    body_.Set(base, body_.Size());
+}
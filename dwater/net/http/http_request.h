@@ -1,19 +1,28 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.04.09
+// Last modified:   2021.04.17
 // Filename:        http_request.h
-// Descripton:       
+// Descripton:
+//
+// 路径、查询参数和头部都是StringPiece，解析的时候直接指向连接的输入Buffer，
+// 不为每个请求分配字符串。需要在回调之后继续使用请求时调用Detach()，
+// 把引用的数据拷贝到请求自己的storage_中。拷贝构造和赋值总是深拷贝
 
 #ifndef DWATER_NET_HTTP_HTTPREQUEST_H
 #define DWATER_NET_HTTP_HTTPREQUEST_H
 
 #include "dwater/base/copyable.h"
+#include "dwater/base/string_piece.h"
 #include "dwater/base/timestamp.h"
 #include "dwater/base/types.h"
 
-#include <map>
+#include <vector>
+
 #include <assert.h>
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 namespace dwater {
 namespace net {
@@ -35,10 +44,28 @@ public:
         khttp11
     };
 
+    struct Header {
+        StringPiece field;
+        StringPiece value;
+    };
+
+    typedef std::vector<Header> HeaderList;
+
     HttpRequest() : method_(kinvalid), version_(kunknow) {
 
     }
 
+    HttpRequest(const HttpRequest& rhs) {
+        CopyFrom(rhs);
+    }
+
+    HttpRequest& operator=(const HttpRequest& rhs) {
+        if ( this != &rhs ) {
+            CopyFrom(rhs);
+        }
+        return *this;
+    }
+
     void SetVersion(Version version) {
         version_ = version;
     }
@@ -47,21 +74,33 @@ public:
         return version_;
     }
 
+    ///
+    /// 根据长度和前几个字节判断方法，不构造临时字符串
+    ///
     bool SetMethod(const char* start, const char* end) {
         assert(method_ == kinvalid);
-        string m(start, end);
-        if ( m == "GET" ) {
-            method_ = kget;
-        } else if ( m == "POST" ) {
-            method_ = kpost;
-        } else if ( m == "HEAD" ) {
-            m = khead;
-        } else if ( m == "PUT" ) {
-            method_ = kput;
-        } else if ( m == "DELETE" ) {
-            method_ = kdelete;
-        } else {
-            method_ = kinvalid;
+        switch ( end - start ) {
+        case 3:
+            if ( memcmp(start, "GET", 3) == 0 ) {
+                method_ = kget;
+            } else if ( memcmp(start, "PUT", 3) == 0 ) {
+                method_ = kput;
+            }
+            break;
+        case 4:
+            if ( memcmp(start, "POST", 4) == 0 ) {
+                method_ = kpost;
+            } else if ( memcmp(start, "HEAD", 4) == 0 ) {
+                method_ = khead;
+            }
+            break;
+        case 6:
+            if ( memcmp(start, "DELETE", 6) == 0 ) {
+                method_ = kdelete;
+            }
+            break;
+        default:
+            break;
         }
         return method_ != kinvalid;
     }
@@ -95,18 +134,18 @@ public:
     }
 
     void SetPath(const char* start, const char* end) {
-        path_.assign(start, end);
+        path_.Set(start, static_cast<int>(end - start));
     }
-    
-    const string& GetPath() const {
+
+    StringPiece GetPath() const {
         return path_;
     }
 
     void SetQuery(const char* start, const char* end) {
-        query_.assign(start, end);
+        query_.Set(start, static_cast<int>(end - start));
     }
 
-    const string& GetQuery() const {
+    StringPiece GetQuery() const {
         return query_;
     }
 
@@ -118,47 +157,113 @@ public:
         return receive_time_;
     }
 
+    ///
+    /// [start, colon)是字段名，去掉值两端的空白，同名的字段都保留
+    ///
     void AddHeader(const char* start, const char* colon, const char* end) {
-        string field(start, colon);
-        ++colon;
-        while ( colon < end && isspace(*colon) ) {
-            ++colon;
+        const char* value = colon + 1;
+        while ( value < end && (*value == ' ' || *value == '\t') ) {
+            ++value;
         }
-        string value(colon, end);
-        while ( !value.empty() && isspace(value[value.size() - 1]) ) {
-            value.resize(value.size() - 1);
+        while ( end > value && isspace(end[-1]) ) {
+            --end;
         }
-        headers_[field] = value;
+        Header header;
+        header.field.Set(start, static_cast<int>(colon - start));
+        header.value.Set(value, static_cast<int>(end - value));
+        headers_.push_back(header);
     }
 
-    string GetHeader(const string& field) const {
-        string result;
-        std::map<string, string>::const_iterator iter = headers_.find(field);
-        if ( iter != headers_.end() ) {
-            result = iter->second;
+    ///
+    /// 字段名不区分大小写，没有这个字段的时候返回空的StringPiece
+    ///
+    StringPiece GetHeader(const StringPiece& field) const {
+        for ( const Header& header : headers_ ) {
+            if ( header.field.Size() == field.Size() &&
+                 ::strncasecmp(header.field.Data(), field.Data(), field.Size()) == 0 ) {
+                return header.value;
+            }
         }
-        return result;;
+        return StringPiece();
     }
 
-    const std::map<string, string>& GetHeaders() const {
+    const HeaderList& GetHeaders() const {
         return headers_;
     }
 
-    void Swap(HttpRequest& that) {
-        std::swap(method_, that.method_);
-        std::swap(version_, that.version_);
-        path_.swap(that.path_);
-        query_.swap(that.query_);
-        receive_time_.swap(that.receive_time_);
-        headers_.swap(that.headers_);
+    ///
+    /// body已经完整地在输入Buffer中，直接引用
+    ///
+    void SetBody(const char* start, const char* end) {
+        body_.Set(start, static_cast<int>(end - start));
     }
+
+    ///
+    /// body分多次到达或者是chunked编码，拷贝到body_buffer_中
+    ///
+    void AppendBody(const char* data, size_t len) {
+        body_buffer_.append(data, len);
+    }
+
+    void ReserveBody(size_t len) {
+        body_buffer_.reserve(len);
+    }
+
+    StringPiece GetBody() const {
+        return body_buffer_.empty() ? body_ : StringPiece(body_buffer_);
+    }
+
+    ///
+    /// 把引用的路径、参数、头部和body拷贝到storage_中，之后不再依赖输入Buffer
+    ///
+    void Detach();
+
+    ///
+    /// 清空请求，保留headers_和storage_的容量给下一个请求
+    ///
+    void Reset() {
+        method_ = kinvalid;
+        version_ = kunknow;
+        path_.Clear();
+        query_.Clear();
+        receive_time_ = Timestamp();
+        headers_.clear();
+        storage_.clear();
+        body_.Clear();
+        if ( body_buffer_.capacity() > kmax_kept_body_capacity ) {
+            string().swap(body_buffer_);
+        } else {
+            body_buffer_.clear();
+        }
+    }
+
+    ///
+    /// 交换成员，不分配内存。引用输入Buffer的请求交换之后还是引用原来的Buffer
+    ///
+    void Swap(HttpRequest& that);
 private:
+    static const size_t kmax_kept_body_capacity = 64 * 1024; // 大的body用完就释放
+
+    /// 深拷贝，引用的数据都拷贝到自己的storage_中，和rhs的生命周期无关
+    void CopyFrom(const HttpRequest& rhs);
+
+    /// 按照Detach()拷贝的顺序，让StringPiece依次指向从 @c base 开始的数据
+    void Rebind(const char* base);
+
+    /// StringPiece指向自己的storage_，而不是输入Buffer
+    bool Detached() const {
+        return !storage_.empty() && path_.Data() == storage_.data();
+    }
+
     Method                      method_;
     Version                     version_;
-    string                      path_;
-    string                      query_;
+    StringPiece                 path_;
+    StringPiece                 query_;
     Timestamp                   receive_time_;
-    std::map<string, string>    headers_;
+    HeaderList                  headers_;
+    StringPiece                 body_;
+    string                      body_buffer_;
+    string                      storage_;   // Detach()之后StringPiece指向这里
 }; // class HttpRequest
 
 } // namespace net;
@@ -1,32 +1,106 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.04.09
+// Last modified:   2021.04.17
 // Filename:        http_response.cc
-// Descripton:       
+// Descripton:
 
 #include "dwater/net/http/http_response.h"
 
 #include "dwater/net/buffer.h"
 
-#include <stdio.h>
-
 using namespace dwater;
 using namespace dwater::net;
 
-void HttpResponse::AppendToBuffer(Buffer* output) const {
-    char buf[32];
-    snprintf(buf, sizeof(buf), "HTTP/1.1 %d ", status_code_);
-    output->Append(buf);
-    output->Append(status_message_);
-    output->Append("\r\n");
+namespace {
+
+///
+/// 常用状态码的完整状态行，没有的返回空
+///
+StringPiece StatusLine(int code) {
+    switch ( code ) {
+    case 200: return "HTTP/1.1 200 OK\r\n";
+    case 204: return "HTTP/1.1 204 No Content\r\n";
+    case 206: return "HTTP/1.1 206 Partial Content\r\n";
+    case 301: return "HTTP/1.1 301 Moved Permanently\r\n";
+    case 302: return "HTTP/1.1 302 Found\r\n";
+    case 304: return "HTTP/1.1 304 Not Modified\r\n";
+    case 400: return "HTTP/1.1 400 Bad Request\r\n";
+    case 403: return "HTTP/1.1 403 Forbidden\r\n";
+    case 404: return "HTTP/1.1 404 Not Found\r\n";
+    case 405: return "HTTP/1.1 405 Method Not Allowed\r\n";
+    case 413: return "HTTP/1.1 413 Payload Too Large\r\n";
+    case 416: return "HTTP/1.1 416 Range Not Satisfiable\r\n";
+    case 500: return "HTTP/1.1 500 Internal Server Error\r\n";
+    case 503: return "HTTP/1.1 503 Service Unavailable\r\n";
+    default: return StringPiece();
+    }
+}
+
+///
+/// 十进制，不用snprintf
+///
+void AppendDecimal(Buffer* output, size_t value) {
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do {
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while ( value != 0 );
+    output->Append(p, end - p);
+}
+
+} // namespace
+
+void HttpResponse::AddHeader(const StringPiece& key, const StringPiece& value) {
+    for ( auto& header : headers_ ) {
+        if ( StringPiece(header.first) == key ) {
+            value.CopyToString(&header.second);
+            return;
+        }
+    }
+    headers_.push_back(std::make_pair(key.AsString(), value.AsString()));
+}
+
+std::shared_ptr<const string> HttpResponse::ReleaseBody() {
+    std::shared_ptr<const string> body(shared_body_);
+    if ( !body ) {
+        body = std::make_shared<const string>(std::move(body_));
+    }
+    ClearBody();
+    return body;
+}
+
+void HttpResponse::AppendHeadersToBuffer(Buffer* output, const StringPiece& date) const {
+    // 状态行：原因短语是标准的就用预先生成的
+    StringPiece line = StatusLine(status_code_);
+    if ( !line.Empty() &&
+         (status_message_.empty() ||
+          StringPiece(line.Data() + 13, line.Size() - 15) == status_message_) ) {
+        output->Append(line.Data(), line.Size());
+    } else {
+        output->Append("HTTP/1.1 ");
+        AppendDecimal(output, status_code_);
+        output->Append(" ");
+        output->Append(status_message_);
+        output->Append("\r\n");
+    }
 
     if ( close_connection_ ) {
         output->Append("Connection: close\r\n");
     } else {
-        snprintf(buf, sizeof(buf), "Content-Length: %zd\r\n", body_.size());
-        output->Append(buf);
+        // 1xx、204和304没有body，不能带Content-Length(RFC 7230 3.3.2)
+        bool informational = status_code_ >= 100 && status_code_ < 200;
+        if ( !informational && status_code_ != k204NoContent && status_code_ != k304NotModified ) {
+            output->Append("Content-Length: ");
+            AppendDecimal(output, HasBodyFile() ? file_length_ : Body().Size());
+            output->Append("\r\n");
+        }
         output->Append("Connection: Keep-Alive\r\n");
     }
+    if ( !date.Empty() ) {
+        output->Append(date.Data(), date.Size());
+    }
 
     for ( const auto& header : headers_ ) {
         output->Append(header.first);
@@ -35,5 +109,12 @@ void HttpResponse::AppendToBuffer(Buffer* output) const {
         output->Append("\r\n");
     }
     output->Append("\r\n");
-    output->Append(body_);
+}
+
+void HttpResponse::AppendToBuffer(Buffer* output) const {
+    AppendHeadersToBuffer(output, StringPiece());
+    if ( !HasBodyFile() ) {
+        StringPiece body = Body();
+        output->Append(body.Data(), body.Size());
+    }
 }
@@ -1,6 +1,6 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.04.09
+// Last modified:   2021.04.17
 // Filename:        http_response.h
 // Descripton:      
 
@@ -8,9 +8,16 @@
 #define DWATER_NET_HTTP_HTTP_RESPONSE_H
 
 #include "dwater/base/copyable.h"
+#include "dwater/base/string_piece.h"
 #include "dwater/base/types.h"
+#include "dwater/net/chain_buffer.h"
 
-#include <map>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
 
 namespace dwater {
 namespace net {
@@ -18,22 +25,41 @@ class Buffer;
 
 class HttpResponse : public dwater::copyable {
 public:
+    typedef std::function<void()> FileDoneCallback;
+
     enum HttpStatusCode {
         kunknown,
         k200Ok = 200,
+        k204NoContent = 204,
+        k206PartialContent = 206,
         K301MovedPermanpently = 301,
+        k302Found = 302,
+        k304NotModified = 304,
         k400BadRequest = 400,
+        k403Forbidden = 403,
         k404NotFound = 404,
+        k405MethodNotAllowed = 405,
+        k413PayloadTooLarge = 413,
+        k416RangeNotSatisfiable = 416,
+        k500InternalServerError = 500,
+        k503ServiceUnavailable = 503,
     };
 
-    explicit HttpResponse(bool close) : status_code_(kunknown), close_connection_(close) {
-
+    explicit HttpResponse(bool close)
+        : status_code_(kunknown),
+          close_connection_(close),
+          file_fd_(-1),
+          file_offset_(0),
+          file_length_(0) {
     }
 
     void SetStatusCode(HttpStatusCode code) {
         status_code_ = code;
     }
 
+    ///
+    /// 不设置或者和标准的原因短语相同时，直接使用预先生成的状态行
+    ///
     void SetStatusMessage(const string& message) {
         status_message_ = message;
     }
@@ -50,23 +76,118 @@ public:
         AddHeader("Content-Type", content_type); 
     }
 
-    // FIXME: StringPiece
-    void AddHeader(const string& key, const string& value) {
-        headers_[key] = value;
-    }
+    ///
+    /// 同名的字段会被替换
+    ///
+    void AddHeader(const StringPiece& key, const StringPiece& value);
 
     void SetBody(const string& body) {
+        ClearBody();
         body_ = body;
     }
 
+    ///
+    /// 不拷贝，大的body由HttpServer直接引用发送
+    ///
+    void SetBody(string&& body) {
+        ClearBody();
+        body_ = std::move(body);
+    }
+
+    ///
+    /// 多个响应共享的body，比如缓存的文件内容
+    ///
+    void SetBody(const std::shared_ptr<const string>& body) {
+        ClearBody();
+        shared_body_ = body;
+    }
+
+    ///
+    /// 引用ChainBuffer中的一段数据，比如从别的连接读到的数据
+    ///
+    void SetBody(const BufferSlice& body) {
+        ClearBody();
+        body_slice_ = body;
+    }
+
+    ///
+    /// SetBody()设置的body，没有的时候为空
+    ///
+    StringPiece Body() const {
+        if ( shared_body_ ) {
+            return StringPiece(*shared_body_);
+        } else if ( body_slice_.Size() > 0 ) {
+            return body_slice_.ToStringPiece();
+        }
+        return StringPiece(body_);
+    }
+
+    bool HasBodySlice() const {
+        return !shared_body_ && body_slice_.Size() > 0;
+    }
+
+    const BufferSlice& BodySlice() const {
+        return body_slice_;
+    }
+
+    ///
+    /// 把字符串的body交给调用者，之后Body()为空
+    ///
+    std::shared_ptr<const string> ReleaseBody();
+
+    ///
+    /// body是文件 @c fd 中从 @c offset 开始的 @c length 字节，HttpServer用sendfile发送，
+    /// 代替SetBody()。发送完或者连接断开之后调用 @c done，可以在里面关闭文件
+    ///
+    void SetBodyFile(int fd, off_t offset, size_t length, const FileDoneCallback& done) {
+        file_fd_ = fd;
+        file_offset_ = offset;
+        file_length_ = length;
+        file_done_ = done;
+    }
+
+    bool HasBodyFile() const {
+        return file_fd_ >= 0;
+    }
+
+    int BodyFileFd() const { return file_fd_; }
+
+    off_t BodyFileOffset() const { return file_offset_; }
+
+    size_t BodyFileLength() const { return file_length_; }
+
+    const FileDoneCallback& BodyFileDoneCallback() const { return file_done_; }
+
+    ///
+    /// 状态行、头部和body，body是文件的时候只有状态行和头部
+    ///
     void AppendToBuffer(Buffer* output) const;
 
+    ///
+    /// 只有状态行和头部，@c date 是完整的"Date: ...\r\n"，为空的时候不加
+    ///
+    void AppendHeadersToBuffer(Buffer* output, const StringPiece& date) const;
+
 private:
-    std::map<string, string> headers_;
+    void ClearBody() {
+        body_.clear();
+        shared_body_.reset();
+        body_slice_ = BufferSlice();
+    }
+
+    typedef std::vector<std::pair<string, string>> HeaderList;
+
+    HeaderList               headers_;
     HttpStatusCode           status_code_;
     string                   status_message_;
     bool                     close_connection_;
     string                   body_;
+    std::shared_ptr<const string> shared_body_;
+    BufferSlice              body_slice_;
+    int                      file_fd_; // 没有文件的时候为-1
+    off_t                    file_offset_;
+    size_t                   file_length_;
+    FileDoneCallback         file_done_;
 };
 
 }
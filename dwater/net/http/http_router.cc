@@ -0,0 +1,242 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_router.cc
+// Descripton:
+
+#include "dwater/net/http/http_router.h"
+#include "dwater/net/http/http_response.h"
+#include "dwater/base/logging.h"
+
+#include <vector>
+
+#include <string.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+namespace {
+
+const int kmethod_count = HttpRequest::kdelete + 1;
+
+const char* const kmethod_names[kmethod_count] = {
+    NULL, "GET", "POST", "HEAD", "PUT", "DELETE"
+};
+
+bool IsSpecial(char c) {
+    return c == ':' || c == '*';
+}
+
+} // namespace
+
+///
+/// 静态子节点的前缀首字符各不相同，首字符单独放在indices中，查找时只比较一个字符
+///
+struct HttpRouter::Node : noncopyable {
+    Node() : has_handler(false) {}
+
+    string                              prefix;     // 静态路径，参数和通配符节点为空
+    string                              name;       // 参数和通配符的名字
+    string                              indices;
+    std::vector<std::unique_ptr<Node>>  children;
+    std::unique_ptr<Node>               param;
+    std::unique_ptr<Node>               wildcard;
+    Handler                             handlers[kmethod_count];
+    bool                                has_handler;
+};
+
+HttpRouter::HttpRouter()
+    : root_(new Node) {
+}
+
+HttpRouter::~HttpRouter() = default;
+
+void HttpRouter::Add(HttpRequest::Method method, const string& pattern, const Handler& handler) {
+    if ( pattern.empty() || pattern[0] != '/' ) {
+        LOG_FATAL << "HttpRouter::Add() pattern must begin with '/': " << pattern;
+    }
+    if ( method == HttpRequest::kinvalid || !handler ) {
+        LOG_FATAL << "HttpRouter::Add() invalid route " << pattern;
+    }
+    int params = 0;
+    for ( char c : pattern ) {
+        if ( IsSpecial(c) ) {
+            ++params;
+        }
+    }
+    if ( params > RouteParams::kmax_params ) {
+        LOG_FATAL << "HttpRouter::Add() too many parameters in " << pattern;
+    }
+    Insert(root_.get(), pattern, 0, method, handler);
+}
+
+void HttpRouter::Insert(Node* node, const string& pattern, size_t pos,
+                        HttpRequest::Method method, const Handler& handler) {
+    if ( pos == pattern.size() ) {
+        if ( node->handlers[method] ) {
+            LOG_FATAL << "HttpRouter::Add() duplicated route "
+                      << kmethod_names[method] << " " << pattern;
+        }
+        node->handlers[method] = handler;
+        node->has_handler = true;
+        return;
+    }
+
+    if ( pattern[pos] == ':' ) {
+        size_t end = pattern.find('/', pos);
+        if ( end == string::npos ) {
+            end = pattern.size();
+        }
+        string name = pattern.substr(pos + 1, end - pos - 1);
+        if ( name.empty() ) {
+            LOG_FATAL << "HttpRouter::Add() empty parameter name in " << pattern;
+        }
+        if ( !node->param ) {
+            node->param.reset(new Node);
+            node->param->name = name;
+        } else if ( node->param->name != name ) {
+            LOG_FATAL << "HttpRouter::Add() parameter :" << name << " in " << pattern
+                      << " conflicts with :" << node->param->name;
+        }
+        Insert(node->param.get(), pattern, end, method, handler);
+        return;
+    }
+
+    if ( pattern[pos] == '*' ) {
+        string name = pattern.substr(pos + 1);
+        if ( name.empty() || name.find('/') != string::npos ) {
+            LOG_FATAL << "HttpRouter::Add() wildcard must be the last segment: " << pattern;
+        }
+        if ( !node->wildcard ) {
+            node->wildcard.reset(new Node);
+            node->wildcard->name = name;
+        } else if ( node->wildcard->name != name ) {
+            LOG_FATAL << "HttpRouter::Add() wildcard *" << name << " in " << pattern
+                      << " conflicts with *" << node->wildcard->name;
+        }
+        Insert(node->wildcard.get(), pattern, pattern.size(), method, handler);
+        return;
+    }
+
+    // 静态部分到下一个参数或者通配符为止
+    size_t end = pos;
+    while ( end < pattern.size() && !IsSpecial(pattern[end]) ) {
+        ++end;
+    }
+    size_t index = node->indices.find(pattern[pos]);
+    if ( index == string::npos ) {
+        std::unique_ptr<Node> child(new Node);
+        child->prefix = pattern.substr(pos, end - pos);
+        Node* next = child.get();
+        node->indices.push_back(pattern[pos]);
+        node->children.push_back(std::move(child));
+        Insert(next, pattern, end, method, handler);
+        return;
+    }
+
+    Node* child = node->children[index].get();
+    size_t common = 0;
+    while ( common < child->prefix.size() && pos + common < end
+            && child->prefix[common] == pattern[pos + common] ) {
+        ++common;
+    }
+    if ( common < child->prefix.size() ) {
+        // 拆分已有的节点，公共前缀成为新的父节点
+        std::unique_ptr<Node> split(new Node);
+        split->prefix = child->prefix.substr(0, common);
+        child->prefix.erase(0, common);
+        split->indices.push_back(child->prefix[0]);
+        split->children.push_back(std::move(node->children[index]));
+        node->children[index] = std::move(split);
+        child = node->children[index].get();
+    }
+    Insert(child, pattern, pos + common, method, handler);
+}
+
+const HttpRouter::Node* HttpRouter::Match(const Node* node, const char* p, const char* end,
+                                          RouteParams* params) const {
+    if ( p == end ) {
+        if ( node->has_handler ) {
+            return node;
+        }
+        // "/static/"也可以匹配"/static/*path"，参数为空
+        if ( node->wildcard ) {
+            params->Push(node->wildcard->name, StringPiece(p, 0));
+            return node->wildcard.get();
+        }
+        return NULL;
+    }
+
+    const char* index = static_cast<const char*>(
+        ::memchr(node->indices.data(), *p, node->indices.size()));
+    if ( index != NULL ) {
+        const Node* child = node->children[index - node->indices.data()].get();
+        size_t len = child->prefix.size();
+        if ( static_cast<size_t>(end - p) >= len && ::memcmp(p, child->prefix.data(), len) == 0 ) {
+            const Node* found = Match(child, p + len, end, params);
+            if ( found != NULL ) {
+                return found;
+            }
+        }
+    }
+
+    if ( node->param ) {
+        const char* slash = static_cast<const char*>(::memchr(p, '/', end - p));
+        if ( slash == NULL ) {
+            slash = end;
+        }
+        if ( slash != p ) {
+            params->Push(node->param->name, StringPiece(p, static_cast<int>(slash - p)));
+            const Node* found = Match(node->param.get(), slash, end, params);
+            if ( found != NULL ) {
+                return found;
+            }
+            params->Pop();
+        }
+    }
+
+    if ( node->wildcard ) {
+        params->Push(node->wildcard->name, StringPiece(p, static_cast<int>(end - p)));
+        return node->wildcard.get();
+    }
+    return NULL;
+}
+
+bool HttpRouter::Route(const HttpRequest& req, HttpResponse* resp) const {
+    StringPiece path = req.GetPath();
+    RouteParams params;
+    const Node* node = Match(root_.get(), path.Begin(), path.End(), &params);
+    if ( node == NULL ) {
+        return false;
+    }
+
+    HttpRequest::Method method = req.GetMethod();
+    const Handler* handler = &node->handlers[method];
+    if ( !*handler && method == HttpRequest::khead ) {
+        // HEAD没有单独的路由时用GET的，HttpServer不会发送body
+        handler = &node->handlers[HttpRequest::kget];
+    }
+    if ( *handler ) {
+        (*handler)(req, params, resp);
+        return true;
+    }
+
+    string allow;
+    for ( int i = HttpRequest::kget; i < kmethod_count; ++i ) {
+        if ( node->handlers[i] ) {
+            if ( !allow.empty() ) {
+                allow += ", ";
+            }
+            allow += kmethod_names[i];
+        }
+    }
+    resp->SetStatusCode(HttpResponse::k405MethodNotAllowed);
+    resp->AddHeader("Allow", allow);
+    return true;
+}
+
+void HttpRouter::Dispatch(const HttpRequest& req, HttpResponse* resp) const {
+    if ( !Route(req, resp) ) {
+        resp->SetStatusCode(HttpResponse::k404NotFound);
+    }
+}
@@ -0,0 +1,120 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_router.h
+// Descripton:      按路径和方法分发请求
+//
+// 路径保存在压缩的基数树中，静态部分相同前缀的路由共享节点。支持路径参数
+// (/user/:id，匹配到下一个'/')和通配符(/static/*path，匹配剩下的全部)，
+// 参数的值是指向请求路径的StringPiece，匹配的时候不分配内存。
+// 所有路由在HttpServer::Start()之前添加，之后只读，IO线程同时查找不需要加锁
+
+#ifndef DWATER_NET_HTTP_HTTP_ROUTER_H
+#define DWATER_NET_HTTP_HTTP_ROUTER_H
+
+#include "dwater/base/noncopable.h"
+#include "dwater/base/string_piece.h"
+#include "dwater/base/types.h"
+#include "dwater/net/http/http_request.h"
+
+#include <functional>
+#include <memory>
+
+namespace dwater {
+namespace net {
+
+class HttpResponse;
+
+///
+/// 匹配到的路径参数，按在路径中出现的顺序
+///
+class RouteParams : noncopyable {
+public:
+    static const int kmax_params = 8;
+
+    RouteParams() : size_(0) {}
+
+    int Size() const { return size_; }
+
+    StringPiece Name(int i) const { return names_[i]; }
+
+    StringPiece Value(int i) const { return values_[i]; }
+
+    ///
+    /// 没有这个参数的时候返回空的StringPiece
+    ///
+    StringPiece Get(const StringPiece& name) const {
+        for ( int i = 0; i < size_; ++i ) {
+            if ( names_[i] == name ) {
+                return values_[i];
+            }
+        }
+        return StringPiece();
+    }
+
+private:
+    friend class HttpRouter;
+
+    void Push(const StringPiece& name, const StringPiece& value) {
+        names_[size_] = name;
+        values_[size_] = value;
+        ++size_;
+    }
+
+    void Pop() { --size_; }
+
+    StringPiece names_[kmax_params];
+    StringPiece values_[kmax_params];
+    int         size_;
+}; // class RouteParams
+
+class HttpRouter : noncopyable {
+public:
+    typedef std::function<void (const HttpRequest&,
+                                const RouteParams&,
+                                HttpResponse*)> Handler;
+
+    HttpRouter();
+    ~HttpRouter();
+
+    ///
+    /// 添加路由，@c pattern 以'/'开头，":name"是路径参数，"*name"是通配符，只能在最后。
+    /// 同一个位置的参数名必须相同，重复的路由是致命错误
+    ///
+    void Add(HttpRequest::Method method, const string& pattern, const Handler& handler);
+
+    void Get(const string& pattern, const Handler& handler) {
+        Add(HttpRequest::kget, pattern, handler);
+    }
+
+    void Post(const string& pattern, const Handler& handler) {
+        Add(HttpRequest::kpost, pattern, handler);
+    }
+
+    ///
+    /// 找到路由就调用，返回true；路径匹配但是没有这个方法时回复405，也返回true；
+    /// 路径不匹配时不修改响应，返回false
+    ///
+    bool Route(const HttpRequest& req, HttpResponse* resp) const;
+
+    ///
+    /// 可以直接作为HttpServer::HttpCallback，没有路由时回复404
+    ///
+    void Dispatch(const HttpRequest& req, HttpResponse* resp) const;
+
+private:
+    struct Node;
+
+    void Insert(Node* node, const string& pattern, size_t pos,
+                HttpRequest::Method method, const Handler& handler);
+
+    /// @c node 的前缀已经匹配，匹配剩下的[p, end)，静态路径优先，其次是参数和通配符
+    const Node* Match(const Node* node, const char* p, const char* end, RouteParams* params) const;
+
+    std::unique_ptr<Node>   root_;
+}; // class HttpRouter
+
+} // namespace net
+} // namespace dwater
+
+#endif // DWATER_NET_HTTP_HTTP_ROUTER_H
@@ -7,13 +7,18 @@
 #include "dwater/net/http/http_server.h"
 
 #include "dwater/base/logging.h"
+#include "dwater/net/event_loop.h"
 #include "dwater/net/http/http_context.h"
 #include "dwater/net/http/http_request.h"
 #include "dwater/net/http/http_response.h"
 
+#include <time.h>
+
 using namespace dwater;
 using namespace dwater::net;
 
+const size_t HttpServer::kmin_shared_body;
+
 namespace dwater {
 namespace net {
 namespace detail {
@@ -22,6 +27,59 @@ namespace detail {
         resp->SetStatusMessage("NOT FOUND");
         resp->SetCloseConnection(true);
     }
+
+    ///
+    /// 异步处理中的请求，请求从输入Buffer中拷贝出来
+    ///
+    struct AsyncResponse {
+        AsyncResponse(const HttpRequest& req, bool close)
+            : request(req), response(close) {
+            request.Detach();
+        }
+
+        HttpRequest     request;
+        HttpResponse    response;
+    };
+
+    ///
+    /// 每个IO线程缓存一个"Date: ...\r\n"，由这个线程的EventLoop上的定时器每秒刷新，
+    /// 不在每个响应中格式化时间
+    ///
+    struct DateCache {
+        EventLoop*  loop;
+        int         len;
+        char        line[64];
+    };
+
+    __thread DateCache t_date_cache;
+
+    void UpdateDate() {
+        time_t now = ::time(NULL);
+        struct tm tm_time;
+        ::gmtime_r(&now, &tm_time);
+        t_date_cache.len = static_cast<int>(::strftime(t_date_cache.line, sizeof(t_date_cache.line),
+                                                       "Date: %a, %d %b %Y %H:%M:%S GMT\r\n",
+                                                       &tm_time));
+    }
+
+    StringPiece DateHeader(EventLoop* loop) {
+        if ( t_date_cache.loop != loop ) {
+            t_date_cache.loop = loop;
+            UpdateDate();
+            loop->RunEvery(1.0, UpdateDate);
+        }
+        return StringPiece(t_date_cache.line, t_date_cache.len);
+    }
+
+    ///
+    /// 每个连接的状态，保存在TcpConnection的context中
+    ///
+    struct HttpSession {
+        explicit HttpSession(const HttpContext& ctx) : context(ctx) {}
+
+        HttpContext                     context;
+        std::shared_ptr<AsyncResponse>  pending; // 正在异步处理的请求
+    };
 }
 }
 }
@@ -31,7 +89,10 @@ HttpServer::HttpServer(EventLoop* loop,
                        const string& name,
                        TcpServer::Option option)
     : server_(loop, listen_addr, name, option),
-      http_callback_(detail::DefaultHttpCallback) {
+      http_callback_(detail::DefaultHttpCallback),
+      parse_mode_(HttpContext::kview_request),
+      max_body_size_(HttpContext::kdefault_max_body_size),
+      date_header_(true) {
     server_.SetConnectionCallback(std::bind(&HttpServer::OnConnection, this, _1));
     server_.SetMessageCallback(std::bind(&HttpServer::OnMessage, this, _1, _2, _3));
 }
@@ -44,35 +105,161 @@ void HttpServer::Start() {
 
 void HttpServer::OnConnection(const TcpConnectionPtr& conn) {
     if ( conn->Connected() ) {
-        conn->SetContext(HttpContext());
+        HttpContext context(parse_mode_);
+        context.SetMaxBodySize(max_body_size_);
+        context.SetStreamBodyCallback(stream_body_callback_);
+        conn->SetContext(detail::HttpSession(context));
     }
 }
 
 void HttpServer::OnMessage(const TcpConnectionPtr& conn,
                            Buffer* buf,
                            Timestamp receive_time) {
-    HttpContext* context = boost::any_cast<HttpContext>(conn->GetMutableContext());
-    if ( !context->ParseRequest(buf, receive_time) ) {
-        conn->Send("HTTP/1.1 400 Bad Requeset\r\n\r\n");
-        conn->Shutdown();
+    detail::HttpSession* session = boost::any_cast<detail::HttpSession>(conn->GetMutableContext());
+    if ( session->context.Error() != HttpContext::kno_error ) {
+        // 已经回复过错误，丢掉后面的数据，等待连接关闭
+        buf->RetrieveAll();
+        return;
+    }
+    if ( !session->pending ) {
+        ProcessRequests(conn, session, buf, receive_time);
+    }
+}
+
+///
+/// 输入中可能有多个流水线上的请求，全部处理完，响应按顺序写到同一个Buffer中，
+/// 最后一次发送
+///
+void HttpServer::ProcessRequests(const TcpConnectionPtr& conn,
+                                 detail::HttpSession* session,
+                                 Buffer* buf,
+                                 Timestamp receive_time) {
+    HttpContext* context = &session->context;
+    Buffer output;
+    bool close = false;
+    while ( !close && !session->pending ) {
+        if ( !context->ParseRequest(buf, receive_time) ) {
+            if ( context->Error() == HttpContext::kbody_too_large ) {
+                output.Append("HTTP/1.1 413 Payload Too Large\r\n\r\n");
+            } else {
+                output.Append("HTTP/1.1 400 Bad Requeset\r\n\r\n");
+            }
+            close = true;
+        } else if ( context->GotAll() ) {
+            close = OnRequest(conn, session, context->Requeset(), &output);
+            context->Reset();
+            if ( buf->ReadableBytes() == 0 ) {
+                break;
+            }
+        } else {
+            if ( context->ExpectContinue() ) {
+                output.Append("HTTP/1.1 100 Continue\r\n\r\n");
+                context->ContinueSent();
+            }
+            break;
+        }
     }
 
-    if ( context->GotAll() ) {
-        OnRequest(conn, context->Requeset());
-        context->Reset();
+    if ( output.ReadableBytes() > 0 ) {
+        conn->Send(&output);
+    }
+    if ( close ) {
+        // 后面流水线上的请求不再处理
+        buf->RetrieveAll();
+        conn->Shutdown();
+    } else if ( session->pending ) {
+        // 响应完成之前不再读，后面的请求留在输入Buffer中
+        conn->StopRead();
     }
 }
 
-void HttpServer::OnRequest(const TcpConnectionPtr& conn, const HttpRequest& req) {
-    const string& connection = req.GetHeader("Connection");
+bool HttpServer::OnRequest(const TcpConnectionPtr& conn,
+                           detail::HttpSession* session,
+                           const HttpRequest& req,
+                           Buffer* output) {
+    StringPiece connection = req.GetHeader("Connection");
     bool close = connection == "close" ||
         (req.GetVersion() == HttpRequest::khttp10 && connection != "Keep-Alive");
+    if ( async_http_callback_ ) {
+        std::shared_ptr<detail::AsyncResponse> pending(new detail::AsyncResponse(req, close));
+        session->pending = pending;
+        std::weak_ptr<TcpConnection> weak_conn(conn);
+        EventLoop* loop = conn->GetLoop();
+        // 总是放到队列中，回调里直接调用done也不会重入ProcessRequests()
+        async_http_callback_(pending->request, &pending->response,
+                             [this, loop, weak_conn, pending] {
+                                 loop->QueueInLoop(std::bind(&HttpServer::OnAsyncResponse,
+                                                             this, weak_conn, pending));
+                             });
+        return false;
+    }
     HttpResponse response(close);
     http_callback_(req, &response);
-    Buffer buf;
-    response.AppendToBuffer(&buf);
-    conn->Send(&buf);
-    if ( response.CloseConnection() ) {
+    return AppendResponse(conn, &response, req.GetMethod() == HttpRequest::khead, output);
+}
+
+///
+/// 小的body拷贝到 @c output 中，文件和大的body不拷贝，直接引用发送。
+/// 在MessageCallback的batch中，它们和前面的响应一起用一次writev写出。
+/// HEAD请求的响应只有头部，Content-Length还是body的长度
+///
+bool HttpServer::AppendResponse(const TcpConnectionPtr& conn,
+                                HttpResponse* response,
+                                bool head,
+                                Buffer* output) {
+    response->AppendHeadersToBuffer(output, date_header_ ? detail::DateHeader(conn->GetLoop())
+                                                         : StringPiece());
+    if ( head ) {
+        if ( response->HasBodyFile() && response->BodyFileDoneCallback() ) {
+            response->BodyFileDoneCallback()();
+        }
+    } else if ( response->HasBodyFile() ) {
+        // 之前的响应先发出去，保证顺序
+        conn->Send(output);
+        conn->SendFile(response->BodyFileFd(), response->BodyFileOffset(),
+                       response->BodyFileLength(), response->BodyFileDoneCallback());
+    } else if ( static_cast<size_t>(response->Body().Size()) < kmin_shared_body ) {
+        output->Append(response->Body());
+    } else {
+        conn->Send(output);
+        if ( response->HasBodySlice() ) {
+            ChainBuffer body;
+            body.Append(response->BodySlice());
+            conn->Send(&body);
+        } else {
+            conn->Send(response->ReleaseBody());
+        }
+    }
+    return response->CloseConnection();
+}
+
+void HttpServer::OnAsyncResponse(const std::weak_ptr<TcpConnection>& weak_conn,
+                                 const std::shared_ptr<detail::AsyncResponse>& pending) {
+    TcpConnectionPtr conn = weak_conn.lock();
+    if ( !conn || !conn->Connected() ) {
+        return;
+    }
+    detail::HttpSession* session = boost::any_cast<detail::HttpSession>(conn->GetMutableContext());
+    assert(session->pending == pending);
+    session->pending.reset();
+
+    conn->BeginBatch();
+    Buffer output;
+    bool head = pending->request.GetMethod() == HttpRequest::khead;
+    if ( AppendResponse(conn, &pending->response, head, &output) ) {
+        conn->Send(&output);
+        conn->InputBuffer()->RetrieveAll();
+        // 要继续读才能收到对方的FIN，关闭连接
+        conn->StartRead();
         conn->Shutdown();
+    } else {
+        conn->Send(&output);
+        // 继续处理等待期间已经收到的请求
+        ProcessRequests(conn, session, conn->InputBuffer(), Timestamp::Now());
+        // 出错之后OnMessage()会丢掉收到的数据，也要继续读
+        if ( !session->pending ) {
+            conn->StartRead();
+        }
     }
+    conn->EndBatch();
 }
@@ -8,6 +8,7 @@
 #define DWATER_NET_HTTP_HTTP_SERVER_H
 
 #include "dwater/net/tcp_server.h"
+#include "dwater/net/http/http_context.h"
 
 namespace dwater {
 namespace net {
@@ -15,10 +16,29 @@ namespace net {
 class HttpRequest;
 class HttpResponse;
 
+namespace detail {
+struct HttpSession;
+struct AsyncResponse;
+}
+
 class HttpServer : noncopyable {
 public:
     typedef std::function<void (const HttpRequest&, HttpResponse*)> HttpCallback;
 
+    ///
+    /// 响应填好之后调用，可以在任何线程调用，只能调用一次。done引用了HttpServer
+    /// 和IO线程的EventLoop，必须在HttpServer析构之前调用，或者保证不再调用
+    ///
+    typedef std::function<void ()> ResponseDoneCallback;
+
+    ///
+    /// 异步处理请求：请求和响应在调用 @c done 之前一直有效，可以交给线程池或者
+    /// 别的连接去处理，不阻塞IO线程
+    ///
+    typedef std::function<void (const HttpRequest&,
+                                HttpResponse*,
+                                const ResponseDoneCallback& done)> AsyncHttpCallback;
+
     HttpServer(EventLoop* loop,
                const InetAddress& listen_addr,
                const string& name,
@@ -32,23 +52,96 @@ public:
         http_callback_ = cb;
     }
 
+    ///
+    /// 设置之后代替HttpCallback。一个连接上同时只有一个请求在处理，响应完成之前
+    /// 不再读这个连接，流水线上后面的请求等前面的响应发出去之后再处理，保证顺序
+    ///
+    void SetAsyncHttpCallback(const AsyncHttpCallback& cb) {
+        async_http_callback_ = cb;
+    }
+
     void SetThreadNum(int num_threads) {
         server_.SetThreadNum(num_threads);
     }
 
+    ///
+    /// 关闭长时间空闲的keep-alive连接，见TcpServer::SetIdleTimeout()
+    ///
+    void SetIdleTimeout(int seconds) {
+        server_.SetIdleTimeout(seconds);
+    }
+
+    ///
+    /// 默认kview_request，HttpCallback中的请求直接引用连接的输入Buffer，
+    /// 回调返回之后还要用请求的话先调用HttpRequest::Detach()。必须在Start()之前调用
+    ///
+    void SetParseMode(HttpContext::ParseMode mode) {
+        parse_mode_ = mode;
+    }
+
+    ///
+    /// 请求body的上限，超过的时候回复413并关闭连接，见HttpContext::SetMaxBodySize()
+    ///
+    void SetMaxBodySize(size_t max_body_size) {
+        max_body_size_ = max_body_size;
+    }
+
+    ///
+    /// 上传之类的大body不在内存中收齐，收到一段交给BodyCallback一段，
+    /// HttpCallback在body结束之后调用，见HttpContext::StreamBodyCallback
+    ///
+    void SetStreamBodyCallback(const HttpContext::StreamBodyCallback& cb) {
+        stream_body_callback_ = cb;
+    }
+
+    ///
+    /// 响应中加上Date头部，默认打开。每个IO线程的日期字符串每秒更新一次
+    ///
+    void SetDateHeader(bool on) {
+        date_header_ = on;
+    }
+
     void Start();
 
 private:
+    static const size_t kmin_shared_body = 4096; // 不小于这个长度的body直接引用发送，不拷贝
+
     void OnConnection(const TcpConnectionPtr& conn);
 
     void OnMessage(const TcpConnectionPtr& conn,
                    Buffer* buf,
                    Timestamp receive_time);
 
-    void OnRequest(const TcpConnectionPtr&, const HttpRequest&);
-
-    TcpServer       server_;
-    HttpCallback    http_callback_;
+    ///
+    /// 处理 @c buf 中所有完整的请求，遇到异步处理的请求时停下来
+    ///
+    void ProcessRequests(const TcpConnectionPtr& conn,
+                         detail::HttpSession* session,
+                         Buffer* buf,
+                         Timestamp receive_time);
+
+    ///
+    /// 响应追加到 @c output 中，返回是否要关闭连接
+    ///
+    bool OnRequest(const TcpConnectionPtr&, detail::HttpSession*,
+                   const HttpRequest&, Buffer* output);
+
+    bool AppendResponse(const TcpConnectionPtr& conn, HttpResponse* response,
+                        bool head, Buffer* output);
+
+    ///
+    /// 异步的响应完成之后在IO线程中调用
+    ///
+    void OnAsyncResponse(const std::weak_ptr<TcpConnection>& weak_conn,
+                         const std::shared_ptr<detail::AsyncResponse>& pending);
+
+    TcpServer                   server_;
+    HttpCallback                http_callback_;
+    AsyncHttpCallback           async_http_callback_;
+    HttpContext::ParseMode      parse_mode_;
+    size_t                      max_body_size_;
+    HttpContext::StreamBodyCallback stream_body_callback_;
+    bool                        date_header_;
 };
 
 } // dwater
@@ -0,0 +1,433 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        static_file_handler.cc
+// Descripton:
+
+#include "dwater/net/http/static_file_handler.h"
+
+#include "dwater/base/logging.h"
+#include "dwater/base/timestamp.h"
+#include "dwater/net/http/http_request.h"
+#include "dwater/net/http/http_response.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+const size_t StaticFileHandler::kdefault_max_cached_files;
+
+///
+/// 一个打开的文件，最后一个引用释放的时候关闭。正在sendfile的响应也持有引用，
+/// 从缓存中淘汰不影响它们
+///
+struct StaticFileHandler::File : noncopyable {
+    File() : fd(-1), content_type(NULL) {}
+
+    ~File() {
+        if ( fd >= 0 ) {
+            ::close(fd);
+        }
+    }
+
+    string                          path;
+    int                             fd;         // 内容在内存中时为-1
+    struct stat                     st;
+    Timestamp                       checked;    // 上一次确认文件没有改变的时间
+    string                          etag;
+    string                          last_modified;
+    const char*                     content_type;
+    std::shared_ptr<const string>   content;
+};
+
+namespace {
+
+int HexValue(char c) {
+    if ( c >= '0' && c <= '9' ) {
+        return c - '0';
+    } else if ( c >= 'a' && c <= 'f' ) {
+        return c - 'a' + 10;
+    } else if ( c >= 'A' && c <= 'F' ) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+///
+/// 解码URL路径，不允许".."，目录加上index.html
+///
+bool MapPath(const StringPiece& url, string* path) {
+    if ( url.Empty() || url[0] != '/' ) {
+        return false;
+    }
+    path->reserve(url.Size());
+    for ( int i = 0; i < url.Size(); ++i ) {
+        char c = url[i];
+        if ( c == '%' ) {
+            int hi = i + 2 < url.Size() ? HexValue(url[i + 1]) : -1;
+            int lo = hi >= 0 ? HexValue(url[i + 2]) : -1;
+            if ( lo < 0 ) {
+                return false;
+            }
+            c = static_cast<char>(hi * 16 + lo);
+            i += 2;
+        }
+        if ( c == '\0' ) {
+            return false;
+        }
+        path->push_back(c);
+    }
+    if ( (*path)[path->size() - 1] == '/' ) {
+        path->append("index.html");
+    }
+    // 每一段都不能是".."
+    for ( size_t pos = path->find(".."); pos != string::npos; pos = path->find("..", pos + 2) ) {
+        bool starts = (*path)[pos - 1] == '/';
+        bool ends = pos + 2 == path->size() || (*path)[pos + 2] == '/';
+        if ( starts && ends ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* ContentType(const string& path) {
+    static const struct {
+        const char* ext;
+        const char* type;
+    } ktypes[] = {
+        { ".html", "text/html; charset=utf-8" },
+        { ".htm", "text/html; charset=utf-8" },
+        { ".css", "text/css" },
+        { ".js", "application/javascript" },
+        { ".json", "application/json" },
+        { ".txt", "text/plain; charset=utf-8" },
+        { ".xml", "application/xml" },
+        { ".png", "image/png" },
+        { ".jpg", "image/jpeg" },
+        { ".jpeg", "image/jpeg" },
+        { ".gif", "image/gif" },
+        { ".svg", "image/svg+xml" },
+        { ".ico", "image/x-icon" },
+        { ".webp", "image/webp" },
+        { ".pdf", "application/pdf" },
+        { ".wasm", "application/wasm" },
+        { ".mp4", "video/mp4" },
+        { ".woff2", "font/woff2" },
+    };
+    size_t dot = path.rfind('.');
+    if ( dot != string::npos && path.find('/', dot) == string::npos ) {
+        const char* ext = path.c_str() + dot;
+        for ( const auto& t : ktypes ) {
+            if ( ::strcasecmp(ext, t.ext) == 0 ) {
+                return t.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+string FormatHttpDate(time_t t) {
+    struct tm tm_time;
+    ::gmtime_r(&t, &tm_time);
+    char buf[64];
+    size_t len = ::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+    return string(buf, len);
+}
+
+bool ParseHttpDate(const StringPiece& str, time_t* t) {
+    string s(str.AsString());
+    struct tm tm_time;
+    ::memset(&tm_time, 0, sizeof(tm_time));
+    const char* end = ::strptime(s.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+    if ( end == NULL || *end != '\0' ) {
+        return false;
+    }
+    *t = ::timegm(&tm_time);
+    return true;
+}
+
+bool ParseNumber(const char*& p, const char* end, off_t* value) {
+    const char* start = p;
+    off_t n = 0;
+    while ( p < end && *p >= '0' && *p <= '9' ) {
+        if ( n > (static_cast<off_t>(1) << 60) ) {
+            return false;
+        }
+        n = n * 10 + (*p - '0');
+        ++p;
+    }
+    *value = n;
+    return p != start;
+}
+
+enum RangeResult {
+    kno_range,
+    krange,
+    kunsatisfiable,
+};
+
+///
+/// 只支持一个区间，多个区间或者格式不对的时候忽略Range，返回整个文件
+///
+RangeResult ParseRange(const StringPiece& range, off_t size, off_t* offset, off_t* length) {
+    if ( !range.StartWith("bytes=") ) {
+        return kno_range;
+    }
+    const char* p = range.Data() + 6;
+    const char* end = range.End();
+    off_t first = 0;
+    off_t last = 0;
+    if ( p < end && *p == '-' ) {
+        // 最后n个字节
+        ++p;
+        if ( !ParseNumber(p, end, &last) || p != end ) {
+            return kno_range;
+        }
+        if ( last == 0 || size == 0 ) {
+            return kunsatisfiable;
+        }
+        *offset = last < size ? size - last : 0;
+        *length = size - *offset;
+        return krange;
+    }
+    if ( !ParseNumber(p, end, &first) || p == end || *p != '-' ) {
+        return kno_range;
+    }
+    ++p;
+    if ( p == end ) {
+        last = size - 1;
+    } else if ( !ParseNumber(p, end, &last) || p != end || last < first ) {
+        return kno_range;
+    }
+    if ( first >= size ) {
+        return kunsatisfiable;
+    }
+    if ( last >= size ) {
+        last = size - 1;
+    }
+    *offset = first;
+    *length = last - first + 1;
+    return krange;
+}
+
+bool ReadContent(int fd, size_t size, string* content) {
+    content->resize(size);
+    size_t done = 0;
+    while ( done < size ) {
+        ssize_t n = ::pread(fd, &(*content)[done], size - done, done);
+        if ( n <= 0 ) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+bool SameFile(const struct stat& a, const struct stat& b) {
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev && a.st_size == b.st_size &&
+           a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+} // namespace
+
+StaticFileHandler::StaticFileHandler(const string& document_root)
+    : document_root_(document_root),
+      max_cached_files_(kdefault_max_cached_files),
+      max_memory_file_size_(0),
+      revalidate_interval_(1.0) {
+}
+
+StaticFileHandler::~StaticFileHandler() {
+}
+
+StaticFileHandler::Stats StaticFileHandler::GetStats() const {
+    MutexLockGuard lock(mutex_);
+    Stats stats = stats_;
+    stats.cached_files = files_.size();
+    return stats;
+}
+
+StaticFileHandler::FilePtr StaticFileHandler::OpenFile(const string& path) {
+    string full_path = document_root_ + path;
+    int fd = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( fd < 0 ) {
+        return FilePtr();
+    }
+    FilePtr file(new File);
+    file->fd = fd;
+    if ( ::fstat(fd, &file->st) != 0 || !S_ISREG(file->st.st_mode) ) {
+        return FilePtr();
+    }
+    file->path = path;
+    file->checked = Timestamp::Now();
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx\"",
+             static_cast<unsigned long>(file->st.st_size),
+             static_cast<unsigned long>(file->st.st_mtime));
+    file->etag = etag;
+    file->last_modified = FormatHttpDate(file->st.st_mtime);
+    file->content_type = ContentType(path);
+
+    size_t size = static_cast<size_t>(file->st.st_size);
+    if ( size <= max_memory_file_size_ ) {
+        std::shared_ptr<string> content(new string);
+        if ( ReadContent(fd, size, content.get()) ) {
+            file->content = content;
+            ::close(file->fd);
+            file->fd = -1;
+        }
+    }
+    return file;
+}
+
+StaticFileHandler::FilePtr StaticFileHandler::GetFile(const string& path) {
+    FilePtr file;
+    Timestamp now(Timestamp::Now());
+    {
+        MutexLockGuard lock(mutex_);
+        auto it = files_.find(path);
+        if ( it != files_.end() ) {
+            file = *it->second;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            if ( TimeDifference(now, file->checked) < revalidate_interval_ ) {
+                ++stats_.hits;
+                return file;
+            }
+        }
+    }
+
+    if ( file ) {
+        // 过了检查的间隔，文件没有改变的话继续用缓存的
+        struct stat st;
+        string full_path = document_root_ + path;
+        if ( ::stat(full_path.c_str(), &st) == 0 && SameFile(st, file->st) ) {
+            MutexLockGuard lock(mutex_);
+            file->checked = now;
+            ++stats_.hits;
+            return file;
+        }
+    }
+
+    file = OpenFile(path);
+    MutexLockGuard lock(mutex_);
+    ++stats_.misses;
+    auto it = files_.find(path);
+    if ( it != files_.end() ) {
+        RemoveFromCache(it->second);
+    }
+    if ( file ) {
+        AddToCache(file);
+    }
+    return file;
+}
+
+void StaticFileHandler::AddToCache(const FilePtr& file) {
+    if ( max_cached_files_ == 0 ) {
+        return;
+    }
+    lru_.push_front(file);
+    files_[file->path] = lru_.begin();
+    if ( file->content ) {
+        stats_.memory_bytes += file->content->size();
+    }
+    while ( files_.size() > max_cached_files_ ) {
+        RemoveFromCache(--lru_.end());
+    }
+}
+
+void StaticFileHandler::RemoveFromCache(FileList::iterator pos) {
+    const FilePtr& file = *pos;
+    if ( file->content ) {
+        stats_.memory_bytes -= file->content->size();
+    }
+    files_.erase(file->path);
+    lru_.erase(pos);
+}
+
+bool StaticFileHandler::Handle(const HttpRequest& req, HttpResponse* resp) {
+    string path;
+    if ( !MapPath(req.GetPath(), &path) ) {
+        return false;
+    }
+    FilePtr file = GetFile(path);
+    if ( !file ) {
+        return false;
+    }
+    if ( req.GetMethod() != HttpRequest::kget && req.GetMethod() != HttpRequest::khead ) {
+        resp->SetStatusCode(HttpResponse::k405MethodNotAllowed);
+        resp->AddHeader("Allow", "GET, HEAD");
+        return true;
+    }
+
+    resp->AddHeader("Last-Modified", file->last_modified);
+    resp->AddHeader("ETag", file->etag);
+
+    // If-None-Match优先于If-Modified-Since
+    StringPiece none_match = req.GetHeader("If-None-Match");
+    bool not_modified = false;
+    if ( !none_match.Empty() ) {
+        not_modified = none_match == "*" ||
+            ::memmem(none_match.Data(), none_match.Size(),
+                     file->etag.data(), file->etag.size()) != NULL;
+    } else {
+        time_t since = 0;
+        StringPiece modified_since = req.GetHeader("If-Modified-Since");
+        not_modified = !modified_since.Empty() &&
+            ParseHttpDate(modified_since, &since) && file->st.st_mtime <= since;
+    }
+    if ( not_modified ) {
+        resp->SetStatusCode(HttpResponse::k304NotModified);
+        return true;
+    }
+
+    resp->SetContentType(file->content_type);
+    resp->AddHeader("Accept-Ranges", "bytes");
+    const off_t size = file->st.st_size;
+    off_t offset = 0;
+    off_t length = size;
+    RangeResult range = kno_range;
+    StringPiece range_header = req.GetHeader("Range");
+    StringPiece if_range = req.GetHeader("If-Range");
+    if ( !range_header.Empty() &&
+         (if_range.Empty() || if_range == file->etag || if_range == file->last_modified) ) {
+        range = ParseRange(range_header, size, &offset, &length);
+    }
+
+    char content_range[96];
+    if ( range == kunsatisfiable ) {
+        snprintf(content_range, sizeof(content_range), "bytes */%ld", static_cast<long>(size));
+        resp->SetStatusCode(HttpResponse::k416RangeNotSatisfiable);
+        resp->AddHeader("Content-Range", content_range);
+        return true;
+    } else if ( range == krange ) {
+        snprintf(content_range, sizeof(content_range), "bytes %ld-%ld/%ld",
+                 static_cast<long>(offset), static_cast<long>(offset + length - 1),
+                 static_cast<long>(size));
+        resp->SetStatusCode(HttpResponse::k206PartialContent);
+        resp->AddHeader("Content-Range", content_range);
+    } else {
+        resp->SetStatusCode(HttpResponse::k200Ok);
+    }
+
+    if ( file->content ) {
+        if ( length == size ) {
+            resp->SetBody(file->content);
+        } else {
+            resp->SetBody(file->content->substr(offset, length));
+        }
+    } else if ( length > 0 ) {
+        // 响应持有文件的引用，发送完之前不会被关闭
+        FilePtr keep(file);
+        resp->SetBodyFile(file->fd, offset, length, [keep] {});
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        static_file_handler.h
+// Descripton:      把URL路径映射到文档根目录下的文件
+//
+// 打开的文件和stat的结果放在LRU缓存中，热点文件不需要每次open/fstat，文件用
+// sendfile发送。小文件可以整个读到内存中，多个响应共享同一份内容。支持
+// If-None-Match/If-Modified-Since的304响应和单个区间的Range请求
+
+#ifndef DWATER_NET_HTTP_STATIC_FILE_HANDLER_H
+#define DWATER_NET_HTTP_STATIC_FILE_HANDLER_H
+
+#include "dwater/base/mutex.h"
+#include "dwater/base/noncopable.h"
+#include "dwater/base/string_piece.h"
+#include "dwater/base/types.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace dwater {
+namespace net {
+
+class HttpRequest;
+class HttpResponse;
+
+///
+/// 可以在多个IO线程中同时使用
+///
+/// 用法：在HttpCallback中先调用Handle()，返回false的时候再处理别的路径
+class StaticFileHandler : noncopyable {
+public:
+    static const size_t kdefault_max_cached_files = 1024;
+
+    struct Stats {
+        Stats() : hits(0), misses(0), cached_files(0), memory_bytes(0) {}
+
+        size_t  hits;           // 不需要open的请求
+        size_t  misses;
+        size_t  cached_files;
+        size_t  memory_bytes;   // 内存中文件内容的总大小
+    };
+
+    explicit StaticFileHandler(const string& document_root);
+    ~StaticFileHandler();
+
+    ///
+    /// 最多缓存多少个打开的文件，0表示不缓存
+    ///
+    void SetMaxCachedFiles(size_t max_files) {
+        max_cached_files_ = max_files;
+    }
+
+    ///
+    /// 不超过 @c size 字节的文件整个读到内存中，用内存中的内容响应，不占用文件描述符。
+    /// 默认为0，不放在内存中
+    ///
+    void SetMaxMemoryFileSize(size_t size) {
+        max_memory_file_size_ = size;
+    }
+
+    ///
+    /// 缓存的stat结果超过 @c seconds 秒之后重新检查文件有没有改变，默认1秒
+    ///
+    void SetRevalidateInterval(double seconds) {
+        revalidate_interval_ = seconds;
+    }
+
+    ///
+    /// 请求的路径是文档根目录下的普通文件时填好响应，返回true；
+    /// 否则不修改响应，返回false。目录映射到其中的index.html
+    ///
+    bool Handle(const HttpRequest& req, HttpResponse* resp);
+
+    Stats GetStats() const;
+
+private:
+    struct File;
+    typedef std::shared_ptr<File> FilePtr;
+    typedef std::list<FilePtr> FileList;
+
+    /// 先查缓存，没有或者文件已经改变的时候重新打开
+    FilePtr GetFile(const string& path);
+
+    FilePtr OpenFile(const string& path);
+
+    void AddToCache(const FilePtr& file) REQUIRES(mutex_);
+
+    void RemoveFromCache(FileList::iterator pos) REQUIRES(mutex_);
+
+    const string    document_root_;
+    size_t          max_cached_files_;
+    size_t          max_memory_file_size_;
+    double          revalidate_interval_;
+
+    mutable MutexLock                               mutex_;
+    FileList                                        lru_ GUARDED_BY(mutex_); // 最近使用的在前面
+    std::unordered_map<string, FileList::iterator>  files_ GUARDED_BY(mutex_);
+    Stats                                           stats_ GUARDED_BY(mutex_);
+};
+
+} // namespace net
+} // namespace dwater
+
+#endif // DWATER_NET_HTTP_STATIC_FILE_HANDLER_H
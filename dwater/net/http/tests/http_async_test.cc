@@ -0,0 +1,161 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_async_test.cc
+// Descripton:      HttpServer::SetAsyncHttpCallback()，慢的请求在线程池中处理，
+//                  不阻塞IO线程，流水线上的响应保持请求的顺序，需要关闭的连接
+//                  在响应之后被关闭并且释放
+
+#include "dwater/net/http/http_server.h"
+#include "dwater/net/http/http_request.h"
+#include "dwater/net/http/http_response.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/base/thread_pool.h"
+
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+ThreadPool g_pool("handlers");
+
+void OnRequest(const HttpRequest& req, HttpResponse* resp,
+               const HttpServer::ResponseDoneCallback& done) {
+    resp->SetStatusCode(HttpResponse::k200Ok);
+    resp->SetStatusMessage("OK");
+    resp->SetContentType("text/plain");
+    if ( req.GetPath() == "/slow" ) {
+        // 模拟访问磁盘或者后端，请求和响应在done之前一直有效
+        g_pool.Run([&req, resp, done] {
+            ::usleep(100 * 1000);
+            resp->SetBody("slow " + req.GetQuery().AsString() + "\n");
+            done();
+        });
+    } else {
+        resp->SetBody("fast\n");
+        done();
+    }
+}
+
+int ConnectTo(uint16_t port) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr("127.0.0.1", port);
+    if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+        LOG_SYSFATAL << "connect";
+    }
+    return sockfd;
+}
+
+///
+/// 读到 @c count 个响应的body，按顺序拼起来
+///
+string ReadBodies(int sockfd, int count) {
+    string data;
+    string bodies;
+    char buf[4096];
+    while ( count > 0 ) {
+        size_t header_end = data.find("\r\n\r\n");
+        size_t body_end = header_end == string::npos ? string::npos : data.find('\n', header_end + 4);
+        if ( body_end != string::npos ) {
+            bodies += data.substr(header_end + 4, body_end + 1 - header_end - 4);
+            data.erase(0, body_end + 1);
+            --count;
+            continue;
+        }
+        ssize_t n = ::read(sockfd, buf, sizeof(buf));
+        if ( n <= 0 ) {
+            break;
+        }
+        data.append(buf, n);
+    }
+    return bodies;
+}
+
+void RunClients(EventLoop* loop, uint16_t port) {
+    // 流水线上的响应按请求的顺序返回
+    int sockfd = ConnectTo(port);
+    const char requests[] = "GET /slow?1 HTTP/1.1\r\n\r\n"
+                            "GET /fast HTTP/1.1\r\n\r\n"
+                            "GET /slow?2 HTTP/1.1\r\n\r\n"
+                            "GET /fast HTTP/1.1\r\n\r\n";
+    ::write(sockfd, requests, sizeof(requests) - 1);
+    string bodies = ReadBodies(sockfd, 4);
+    bool ordered = bodies == "slow ?1\nfast\nslow ?2\nfast\n";
+    printf("pipelined responses %s\n", ordered ? "in order" : "OUT OF ORDER");
+    ::close(sockfd);
+
+    // 4个连接同时请求，在线程池中并行处理，IO线程不被阻塞
+    std::vector<int> conns;
+    for ( int i = 0; i < 4; ++i ) {
+        conns.push_back(ConnectTo(port));
+    }
+    Timestamp start(Timestamp::Now());
+    for ( int fd : conns ) {
+        const char request[] = "GET /slow HTTP/1.1\r\n\r\n";
+        ::write(fd, request, sizeof(request) - 1);
+    }
+    int fast = ConnectTo(port);
+    const char request[] = "GET /fast HTTP/1.1\r\n\r\n";
+    ::write(fast, request, sizeof(request) - 1);
+    ReadBodies(fast, 1);
+    double fast_seconds = TimeDifference(Timestamp::Now(), start);
+    for ( int fd : conns ) {
+        ReadBodies(fd, 1);
+        ::close(fd);
+    }
+    ::close(fast);
+    printf("fast request answered after %.3f seconds, 4 slow requests took %.3f seconds\n",
+           fast_seconds, TimeDifference(Timestamp::Now(), start));
+
+    // 响应之后服务端关闭连接，客户端读到EOF；客户端关闭之后服务端要释放连接
+    const char* close_requests[] = {
+        "GET /slow HTTP/1.0\r\n\r\n",
+        "GET /fast HTTP/1.0\r\n\r\n",
+        "GET /slow HTTP/1.1\r\nConnection: close\r\n\r\n",
+        "GET /fast HTTP/1.1\r\nConnection: close\r\n\r\n",
+    };
+    int closed = 0;
+    for ( const char* request : close_requests ) {
+        int fd = ConnectTo(port);
+        ::write(fd, request, strlen(request));
+        char buf[4096];
+        string response;
+        ssize_t n;
+        while ( (n = ::read(fd, buf, sizeof(buf))) > 0 ) {
+            response.append(buf, n);
+        }
+        if ( n == 0 && response.find("HTTP/1.1 200 OK") == 0 ) {
+            ++closed;
+        }
+        ::close(fd);
+    }
+    for ( int i = 0; i < 100 && loop->ConnectionCount() > 0; ++i ) {
+        ::usleep(10 * 1000);
+    }
+    printf("%d of 4 connections closed by server, %d left open\n",
+           closed, loop->ConnectionCount());
+    loop->Quit();
+}
+
+int main() {
+    Logger::SetLogLevel(Logger::WARN);
+    g_pool.Start(4);
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress("127.0.0.1", 8002), "AsyncTest");
+    server.SetAsyncHttpCallback(OnRequest);
+    server.Start();
+
+    Thread clients(std::bind(RunClients, &loop, 8002), "clients");
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+    g_pool.Stop();
+}
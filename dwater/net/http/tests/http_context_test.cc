@@ -0,0 +1,282 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_context_test.cc
+// Descripton:
+
+#include "dwater/net/http/http_context.h"
+#include "dwater/net/buffer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using dwater::string;
+using dwater::StringPiece;
+using dwater::Timestamp;
+using dwater::net::Buffer;
+using dwater::net::HttpContext;
+using dwater::net::HttpRequest;
+
+BOOST_AUTO_TEST_CASE(testParseRequestAllInOne)
+{
+  HttpContext context(HttpContext::kview_request);
+  Buffer input;
+  input.Append("GET /index.html?a=1 HTTP/1.1\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "\r\n");
+
+  BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+  BOOST_CHECK(context.GotAll());
+  const HttpRequest& request = context.Requeset();
+  BOOST_CHECK_EQUAL(request.GetMethod(), HttpRequest::kget);
+  BOOST_CHECK(request.GetPath() == "/index.html");
+  BOOST_CHECK(request.GetQuery() == "?a=1");
+  BOOST_CHECK_EQUAL(request.GetVersion(), HttpRequest::khttp11);
+  BOOST_CHECK(request.GetHeader("Host") == "www.chenshuo.com");
+  BOOST_CHECK(request.GetHeader("host") == "www.chenshuo.com"); // 不区分大小写
+  BOOST_CHECK(request.GetHeader("User-Agent").Empty());
+  // 头部直接引用输入Buffer
+  BOOST_CHECK(request.GetPath().Data() == input.Peek() + 4);
+  BOOST_CHECK_EQUAL(input.ReadableBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testParseRequestInTwoPieces)
+{
+  string all("HEAD /index.html HTTP/1.0\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "\r\n");
+
+  for (size_t sz1 = 0; sz1 < all.size(); ++sz1)
+  {
+    HttpContext context;
+    Buffer input;
+    input.Append(all.c_str(), sz1);
+    BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+    BOOST_CHECK(!context.GotAll());
+
+    size_t sz2 = all.size() - sz1;
+    input.Append(all.c_str() + sz1, sz2);
+    BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+    BOOST_CHECK(context.GotAll());
+    const HttpRequest& request = context.Requeset();
+    BOOST_CHECK_EQUAL(request.GetMethod(), HttpRequest::khead);
+    BOOST_CHECK(request.GetPath() == "/index.html");
+    BOOST_CHECK_EQUAL(request.GetVersion(), HttpRequest::khttp10);
+    BOOST_CHECK(request.GetHeader("Host") == "www.chenshuo.com");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParseRequestCopyMode)
+{
+  HttpRequest copy;
+  {
+    HttpContext context; // kcopy_request
+    Buffer input;
+    input.Append("POST /upload HTTP/1.1\r\n"
+         "Host: x\r\n"
+         "User-Agent:  \t curl/7.61  \r\n"
+         "Accept:\r\n"
+         "\r\n");
+    BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+    BOOST_CHECK(context.GotAll());
+    input.Append(string(1000, 'x')); // 改写输入Buffer不影响拷贝出来的请求
+    copy = context.Requeset();
+  }
+  BOOST_CHECK_EQUAL(copy.GetMethod(), HttpRequest::kpost);
+  BOOST_CHECK(copy.GetPath() == "/upload");
+  BOOST_CHECK(copy.GetHeader("user-agent") == "curl/7.61");
+  BOOST_CHECK(copy.GetHeader("Accept").Empty());
+  BOOST_CHECK_EQUAL(copy.GetHeaders().size(), 3);
+
+  HttpRequest detached(copy);
+  detached.Detach();
+  BOOST_CHECK(detached.GetHeader("HOST") == "x");
+}
+
+BOOST_AUTO_TEST_CASE(testCopyViewRequest)
+{
+  HttpRequest copy;
+  HttpContext context(HttpContext::kview_request);
+  Buffer input;
+  input.Append("GET /view?q=1 HTTP/1.1\r\n"
+       "Host: y\r\n"
+       "\r\n");
+  BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+  BOOST_CHECK(context.GotAll());
+  copy = context.Requeset();
+  // 拷贝出来的请求不引用输入Buffer，改写Buffer之后仍然有效
+  BOOST_CHECK(copy.GetPath().Data() != context.Requeset().GetPath().Data());
+  input.Append(string(100, 'z'));
+  BOOST_CHECK(copy.GetPath() == "/view");
+  BOOST_CHECK(copy.GetQuery() == "?q=1");
+  BOOST_CHECK(copy.GetHeader("host") == "y");
+}
+
+BOOST_AUTO_TEST_CASE(testSwapRequest)
+{
+  // storage_很短，数据在string对象里面，交换之后要重新指向
+  HttpContext copy_context;
+  Buffer input;
+  input.Append("GET /a HTTP/1.1\r\nH: b\r\n\r\n");
+  BOOST_CHECK(copy_context.ParseRequest(&input, Timestamp::Now()));
+  HttpRequest detached;
+  detached.Swap(copy_context.Requeset());
+
+  HttpContext view_context(HttpContext::kview_request);
+  input.Append("POST /view HTTP/1.1\r\nHost: y\r\n\r\n");
+  BOOST_CHECK(view_context.ParseRequest(&input, Timestamp::Now()));
+  HttpRequest view;
+  view.Swap(view_context.Requeset());
+  const char* view_path = view.GetPath().Data();
+
+  view.Swap(detached);
+  BOOST_CHECK_EQUAL(view.GetMethod(), HttpRequest::kget);
+  BOOST_CHECK(view.GetPath() == "/a");
+  BOOST_CHECK(view.GetHeader("h") == "b");
+  BOOST_CHECK_EQUAL(detached.GetMethod(), HttpRequest::kpost);
+  BOOST_CHECK(detached.GetPath() == "/view");
+  BOOST_CHECK(detached.GetPath().Data() == view_path); // 还是引用输入Buffer
+  BOOST_CHECK(detached.GetHeader("host") == "y");
+
+  HttpRequest other(view);
+  other.Swap(view);
+  BOOST_CHECK(other.GetPath() == "/a" && view.GetHeader("H") == "b");
+}
+
+BOOST_AUTO_TEST_CASE(testParseRequestBad)
+{
+  HttpContext context;
+  Buffer input;
+  input.Append("GET / HTTP/1.1\r\n"
+       "NoColon\r\n"
+       "\r\n");
+  BOOST_CHECK(!context.ParseRequest(&input, Timestamp::Now()));
+
+  HttpContext context2;
+  Buffer input2;
+  input2.Append("GET /" + string(HttpContext::kmax_header_size, 'a'));
+  BOOST_CHECK(!context2.ParseRequest(&input2, Timestamp::Now()));
+
+  // 超长的头部和结尾的空行一起到达
+  HttpContext context4;
+  Buffer input4;
+  input4.Append("GET / HTTP/1.1\r\nX-Big: " + string(HttpContext::kmax_header_size, 'a') +
+                "\r\n\r\n");
+  BOOST_CHECK(!context4.ParseRequest(&input4, Timestamp::Now()));
+  BOOST_CHECK_EQUAL(context4.Error(), HttpContext::kbad_request);
+
+  // 字段名必须是token，冒号前面不能有空格
+  const char* bad_requests[] = {
+    "GET / HTTP/1.1\r\nHost : a\r\n\r\n",
+    "GET / HTTP/1.1\r\n: a\r\n\r\n",
+    "GET / HTTP/1.1\r\nX(y): a\r\n\r\n",
+    "GET /a b HTTP/1.1\r\n\r\n",
+    "GET / HTTP/2.0\r\n\r\n",
+  };
+  for (const char* request : bad_requests)
+  {
+    HttpContext context3;
+    Buffer input3;
+    input3.Append(request);
+    BOOST_CHECK_MESSAGE(!context3.ParseRequest(&input3, Timestamp::Now()), request);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParseContentLengthBody)
+{
+  const string body(3000, 'b');
+  const string all = "POST /echo HTTP/1.1\r\n"
+       "Content-Length: 3000\r\n"
+       "\r\n" + body + "GET / HTTP/1.1\r\n\r\n";
+
+  // 一次收齐，body直接引用输入Buffer
+  {
+    HttpContext context(HttpContext::kview_request);
+    Buffer input;
+    input.Append(all);
+    BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+    BOOST_CHECK(context.GotAll());
+    BOOST_CHECK(context.Requeset().GetBody() == body);
+    BOOST_CHECK(input.toStringPiece() == "GET / HTTP/1.1\r\n\r\n"); // 下一个请求留在Buffer中
+  }
+
+  // 每次一个字节
+  HttpContext context;
+  Buffer input;
+  for (size_t i = 0; i < all.size() && !context.GotAll(); ++i)
+  {
+    input.Append(all.data() + i, 1);
+    BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+  }
+  BOOST_CHECK(context.GotAll());
+  BOOST_CHECK(context.Requeset().GetBody() == body);
+  BOOST_CHECK(context.Requeset().GetHeader("content-length") == "3000");
+}
+
+BOOST_AUTO_TEST_CASE(testParseChunkedBody)
+{
+  const string all = "POST /upload HTTP/1.1\r\n"
+       "Transfer-Encoding: chunked\r\n"
+       "\r\n"
+       "5\r\nhello\r\n"
+       "1a;name=value\r\nabcdefghijklmnopqrstuvwxyz\r\n"
+       "0\r\n"
+       "Trailer: x\r\n"
+       "\r\n";
+
+  for (size_t step = 1; step <= all.size(); step *= 3)
+  {
+    HttpContext context;
+    Buffer input;
+    for (size_t i = 0; i < all.size(); i += step)
+    {
+      input.Append(all.data() + i, std::min(step, all.size() - i));
+      BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+    }
+    BOOST_CHECK(context.GotAll());
+    BOOST_CHECK(context.Requeset().GetBody() == "helloabcdefghijklmnopqrstuvwxyz");
+    BOOST_CHECK_EQUAL(input.ReadableBytes(), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParseStreamBody)
+{
+  string received;
+  int ends = 0;
+  HttpContext context;
+  context.SetMaxBodySize(100);
+  context.SetStreamBodyCallback([&](const HttpRequest& req) {
+    BOOST_CHECK(req.GetPath() == "/upload");
+    return HttpContext::BodyCallback([&](const StringPiece& data) {
+      if (data.Empty()) ++ends; else received += data.AsString();
+    });
+  });
+
+  Buffer input;
+  input.Append("PUT /upload HTTP/1.1\r\nContent-Length: 90\r\n\r\n");
+  for (int i = 0; i < 9; ++i)
+  {
+    input.Append(string(10, static_cast<char>('0' + i)));
+    BOOST_CHECK(context.ParseRequest(&input, Timestamp::Now()));
+    BOOST_CHECK_EQUAL(input.ReadableBytes(), 0); // 不在内存中收齐
+    BOOST_CHECK_EQUAL(received.size(), 10 * (i + 1));
+  }
+  BOOST_CHECK(context.GotAll());
+  BOOST_CHECK_EQUAL(ends, 1);
+  BOOST_CHECK(context.Requeset().GetBody().Empty());
+
+  // 超过上限
+  context.Reset();
+  input.Append("PUT /upload HTTP/1.1\r\nContent-Length: 101\r\n\r\n");
+  BOOST_CHECK(!context.ParseRequest(&input, Timestamp::Now()));
+  BOOST_CHECK_EQUAL(context.Error(), HttpContext::kbody_too_large);
+
+  HttpContext chunked;
+  chunked.SetMaxBodySize(100);
+  input.RetrieveAll();
+  input.Append("PUT /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+               "60\r\n" + string(0x60, 'x') + "\r\n5\r\n");
+  BOOST_CHECK(!chunked.ParseRequest(&input, Timestamp::Now()));
+  BOOST_CHECK_EQUAL(chunked.Error(), HttpContext::kbody_too_large);
+}
@@ -0,0 +1,102 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_pipeline_bench.cc
+// Descripton:      流水线上的GET请求，比较不同深度下每秒处理的请求数
+//
+// usage: http_pipeline_bench [requests_per_depth]
+
+#include "dwater/net/http/http_server.h"
+#include "dwater/net/http/http_request.h"
+#include "dwater/net/http/http_response.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_requests = 100000;
+
+void OnRequest(const HttpRequest&, HttpResponse* resp) {
+    resp->SetStatusCode(HttpResponse::k200Ok);
+    resp->SetStatusMessage("OK");
+    resp->SetContentType("text/plain");
+    resp->SetBody("hello, world!\n");
+}
+
+///
+/// 每次写出depth个请求，读到depth个响应之后再发下一批，返回读到的响应数
+///
+int RunPipeline(int sockfd, int depth) {
+    const char request[] = "GET /hello HTTP/1.1\r\nHost: bench\r\n\r\n";
+    string batch;
+    for ( int i = 0; i < depth; ++i ) {
+        batch += request;
+    }
+    int responses = 0;
+    char buf[65536];
+    string pending;
+    for ( int sent = 0; sent < g_requests; sent += depth ) {
+        if ( ::write(sockfd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size()) ) {
+            break;
+        }
+        int got = 0;
+        while ( got < depth ) {
+            ssize_t n = ::read(sockfd, buf, sizeof(buf));
+            if ( n <= 0 ) {
+                return responses;
+            }
+            pending.append(buf, n);
+            // 每个响应以body "hello, world!\n"结尾
+            size_t pos;
+            while ( (pos = pending.find("world!\n")) != string::npos ) {
+                pending.erase(0, pos + 7);
+                ++got;
+            }
+        }
+        responses += got;
+    }
+    return responses;
+}
+
+void RunClients(EventLoop* loop, uint16_t port) {
+    const int depths[] = { 1, 4, 16, 64 };
+    for ( int depth : depths ) {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        InetAddress addr("127.0.0.1", port);
+        if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+            LOG_SYSFATAL << "connect";
+        }
+        Timestamp start(Timestamp::Now());
+        int responses = RunPipeline(sockfd, depth);
+        double seconds = TimeDifference(Timestamp::Now(), start);
+        printf("depth %2d: %d responses in %.3f seconds, %.0f req/s\n",
+               depth, responses, seconds, responses / seconds);
+        ::close(sockfd);
+    }
+    loop->Quit();
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_requests = atoi(argv[1]);
+
+    Logger::SetLogLevel(Logger::WARN);
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress("127.0.0.1", 8001), "PipelineBench");
+    server.SetHttpCallback(OnRequest);
+    server.SetThreadNum(1);
+    server.Start();
+
+    Thread clients(std::bind(RunClients, &loop, 8001), "clients");
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+}
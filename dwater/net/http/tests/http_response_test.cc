@@ -0,0 +1,79 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_response_test.cc
+// Descripton:
+
+#include "dwater/net/http/http_response.h"
+#include "dwater/net/buffer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using dwater::string;
+using dwater::net::Buffer;
+using dwater::net::HttpResponse;
+
+BOOST_AUTO_TEST_CASE(testStatusLine)
+{
+  HttpResponse resp(false);
+  resp.SetStatusCode(HttpResponse::k200Ok);
+  resp.SetStatusMessage("OK");
+  resp.SetBody("hello");
+  Buffer output;
+  resp.AppendToBuffer(&output);
+  BOOST_CHECK_EQUAL(output.RetrieveAllAsString(),
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Length: 5\r\n"
+                    "Connection: Keep-Alive\r\n"
+                    "\r\n"
+                    "hello");
+
+  // 不设置原因短语的时候用标准的，304没有Content-Length
+  HttpResponse not_modified(false);
+  not_modified.SetStatusCode(HttpResponse::k304NotModified);
+  not_modified.AppendHeadersToBuffer(&output, "Date: Sat, 17 Apr 2021 08:00:00 GMT\r\n");
+  BOOST_CHECK_EQUAL(output.RetrieveAllAsString(),
+                    "HTTP/1.1 304 Not Modified\r\n"
+                    "Connection: Keep-Alive\r\n"
+                    "Date: Sat, 17 Apr 2021 08:00:00 GMT\r\n"
+                    "\r\n");
+
+  HttpResponse custom(true);
+  custom.SetStatusCode(HttpResponse::k404NotFound);
+  custom.SetStatusMessage("NOT FOUND");
+  custom.AppendToBuffer(&output);
+  BOOST_CHECK_EQUAL(output.RetrieveAllAsString(),
+                    "HTTP/1.1 404 NOT FOUND\r\n"
+                    "Connection: close\r\n"
+                    "\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(testHeadersAndBody)
+{
+  HttpResponse resp(false);
+  resp.SetStatusCode(HttpResponse::k200Ok);
+  resp.SetContentType("text/plain");
+  resp.AddHeader("Server", "dwater");
+  resp.SetContentType("text/html"); // 同名的字段被替换
+
+  string body(100000, 'b');
+  const char* data = body.data();
+  resp.SetBody(std::move(body));
+  BOOST_CHECK(resp.Body().Data() == data); // 移动，不拷贝
+
+  Buffer output;
+  resp.AppendHeadersToBuffer(&output, dwater::StringPiece());
+  BOOST_CHECK_EQUAL(output.RetrieveAllAsString(),
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Length: 100000\r\n"
+                    "Connection: Keep-Alive\r\n"
+                    "Content-Type: text/html\r\n"
+                    "Server: dwater\r\n"
+                    "\r\n");
+
+  std::shared_ptr<const string> released = resp.ReleaseBody();
+  BOOST_CHECK(released->data() == data);
+  BOOST_CHECK(resp.Body().Empty());
+}
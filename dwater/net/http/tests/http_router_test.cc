@@ -0,0 +1,167 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        http_router_test.cc
+// Descripton:
+
+#include "dwater/net/http/http_router.h"
+#include "dwater/net/http/http_context.h"
+#include "dwater/net/http/http_response.h"
+#include "dwater/net/buffer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+
+using dwater::string;
+using dwater::StringPiece;
+using dwater::Timestamp;
+using dwater::net::Buffer;
+using dwater::net::HttpContext;
+using dwater::net::HttpRequest;
+using dwater::net::HttpResponse;
+using dwater::net::HttpRouter;
+using dwater::net::RouteParams;
+
+namespace {
+
+HttpRequest MakeRequest(const string& method, const string& path) {
+  HttpContext context;
+  Buffer input;
+  input.Append(method + " " + path + " HTTP/1.1\r\n\r\n");
+  BOOST_REQUIRE(context.ParseRequest(&input, Timestamp::Now()));
+  BOOST_REQUIRE(context.GotAll());
+  return context.Requeset();
+}
+
+string StatusLine(const HttpResponse& resp) {
+  Buffer output;
+  resp.AppendHeadersToBuffer(&output, StringPiece());
+  string headers = output.RetrieveAllAsString();
+  return headers.substr(0, headers.find("\r\n"));
+}
+
+/// 处理函数把路由名和参数写到body中
+HttpRouter::Handler Reply(const string& route) {
+  return [route](const HttpRequest&, const RouteParams& params, HttpResponse* resp) {
+    string body = route;
+    for (int i = 0; i < params.Size(); ++i)
+      body += " " + params.Name(i).AsString() + "=" + params.Value(i).AsString();
+    resp->SetStatusCode(HttpResponse::k200Ok);
+    resp->SetBody(body);
+  };
+}
+
+string Route(const HttpRouter& router, const string& method, const string& path) {
+  HttpRequest req = MakeRequest(method, path);
+  HttpResponse resp(false);
+  if (!router.Route(req, &resp))
+    return "none";
+  if (resp.Body().Empty())
+    return StatusLine(resp);
+  return resp.Body().AsString();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testStaticRoutes)
+{
+  HttpRouter router;
+  router.Get("/", Reply("root"));
+  router.Get("/user", Reply("user"));
+  router.Get("/users", Reply("users"));
+  router.Get("/user/list", Reply("list"));
+  router.Get("/upload", Reply("upload")); // 拆分"/u"公共前缀
+
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/"), "root");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user"), "user");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/users"), "users");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/list"), "list");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/upload"), "upload");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/us"), "none");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/"), "none");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/userx"), "none");
+}
+
+BOOST_AUTO_TEST_CASE(testParamsAndWildcard)
+{
+  HttpRouter router;
+  router.Get("/user/:id", Reply("user"));
+  router.Get("/user/:id/posts/:post", Reply("post"));
+  router.Get("/user/new", Reply("new"));
+  router.Get("/static/*path", Reply("static"));
+
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/42"), "user id=42");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/42/posts/7"), "post id=42 post=7");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/new"), "new"); // 静态路径优先
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/newer"), "user id=newer");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/42/posts"), "none");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/user/"), "none");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/static/css/a.css"), "static path=css/a.css");
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/static/"), "static path=");
+
+  // 参数的值指向请求中的路径，不拷贝
+  const char* value = NULL;
+  router.Get("/item/:id", [&value](const HttpRequest&, const RouteParams& params, HttpResponse*) {
+    value = params.Get("id").Data();
+  });
+  HttpRequest req = MakeRequest("GET", "/item/9");
+  HttpResponse resp(false);
+  BOOST_CHECK(router.Route(req, &resp));
+  BOOST_CHECK(value == req.GetPath().Data() + 6);
+}
+
+BOOST_AUTO_TEST_CASE(testMethods)
+{
+  HttpRouter router;
+  router.Get("/item/:id", Reply("get"));
+  router.Add(HttpRequest::kput, "/item/:id", Reply("put"));
+
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/item/1"), "get id=1");
+  BOOST_CHECK_EQUAL(Route(router, "PUT", "/item/1"), "put id=1");
+  BOOST_CHECK_EQUAL(Route(router, "HEAD", "/item/1"), "get id=1"); // HEAD用GET的处理函数
+
+  HttpRequest req = MakeRequest("DELETE", "/item/1");
+  HttpResponse resp(false);
+  BOOST_CHECK(router.Route(req, &resp));
+  Buffer output;
+  resp.AppendHeadersToBuffer(&output, StringPiece());
+  string headers = output.RetrieveAllAsString();
+  BOOST_CHECK(headers.find("HTTP/1.1 405") == 0);
+  BOOST_CHECK(headers.find("\r\nAllow: GET, PUT\r\n") != string::npos);
+
+  HttpResponse missing(false);
+  router.Dispatch(MakeRequest("GET", "/nothing"), &missing);
+  BOOST_CHECK_EQUAL(StatusLine(missing), "HTTP/1.1 404 Not Found");
+}
+
+BOOST_AUTO_TEST_CASE(testManyRoutes)
+{
+  HttpRouter router;
+  char pattern[64];
+  for (int i = 0; i < 100; ++i)
+  {
+    snprintf(pattern, sizeof pattern, "/api/v1/resource%d", i);
+    router.Get(pattern, Reply(pattern));
+    snprintf(pattern, sizeof pattern, "/api/v1/resource%d/:id", i);
+    router.Get(pattern, Reply(pattern));
+    snprintf(pattern, sizeof pattern, "/api/v2/r%d/items/:id/detail", i);
+    router.Get(pattern, Reply(pattern));
+  }
+
+  char path[64];
+  for (int i = 0; i < 100; ++i)
+  {
+    snprintf(path, sizeof path, "/api/v1/resource%d", i);
+    BOOST_CHECK_EQUAL(Route(router, "GET", path), path);
+    snprintf(path, sizeof path, "/api/v1/resource%d/%d", i, i * 7);
+    snprintf(pattern, sizeof pattern, "/api/v1/resource%d/:id id=%d", i, i * 7);
+    BOOST_CHECK_EQUAL(Route(router, "GET", path), pattern);
+    snprintf(path, sizeof path, "/api/v2/r%d/items/x%d/detail", i, i);
+    snprintf(pattern, sizeof pattern, "/api/v2/r%d/items/:id/detail id=x%d", i, i);
+    BOOST_CHECK_EQUAL(Route(router, "GET", path), pattern);
+  }
+  BOOST_CHECK_EQUAL(Route(router, "GET", "/api/v1/resource100"), "none");
+}
@@ -7,30 +7,40 @@
 #include "dwater/net/http/http_server.h"
 #include "dwater/net/http/http_request.h"
 #include "dwater/net/http/http_response.h"
+#include "dwater/net/http/static_file_handler.h"
 #include "dwater/net/event_loop.h"
 #include "dwater/base/logging.h"
 
 #include <iostream>
-#include <map>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace dwater;
 using namespace dwater::net;
 
 extern char favicon[555];
 bool benchmark = false;
+StaticFileHandler* g_files = NULL;
 
 void onRequest(const HttpRequest& req, HttpResponse* resp)
 {
-  std::cout << "Headers " << req.MethodString() << " " << req.GetPath() << std::endl;
+  std::cout << "Headers " << req.MethodString() << " " << req.GetPath().AsString() << std::endl;
   if (!benchmark)
   {
-    const std::map<string, string>& headers = req.GetHeaders();
-    for (const auto& header : headers)
+    for (const HttpRequest::Header& header : req.GetHeaders())
     {
-      std::cout << header.first << ": " << header.second << std::endl;
+      std::cout << header.field.AsString() << ": " << header.value.AsString() << std::endl;
     }
   }
 
+  if (g_files && g_files->Handle(req, resp))
+  {
+    return;
+  }
+
   if (req.GetPath() == "/")
   {
     resp->SetStatusCode(HttpResponse::k200Ok);
@@ -57,6 +67,34 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
     resp->AddHeader("Server", "Muduo");
     resp->SetBody("hello, world!\n");
   }
+  else if (req.GetPath() == "/echo")
+  {
+    // 把请求的body原样返回
+    resp->SetStatusCode(HttpResponse::k200Ok);
+    resp->SetStatusMessage("OK");
+    resp->SetContentType("application/octet-stream");
+    resp->SetBody(req.GetBody().AsString());
+  }
+  else if (req.GetPath() == "/file")
+  {
+    // 用sendfile发送这个程序自己
+    int fd = ::open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && ::fstat(fd, &st) == 0)
+    {
+      resp->SetStatusCode(HttpResponse::k200Ok);
+      resp->SetStatusMessage("OK");
+      resp->SetContentType("application/octet-stream");
+      resp->SetBodyFile(fd, 0, st.st_size, [fd] { ::close(fd); });
+    }
+    else
+    {
+      if (fd >= 0) ::close(fd);
+      resp->SetStatusCode(HttpResponse::k404NotFound);
+      resp->SetStatusMessage("Not Found");
+      resp->SetCloseConnection(true);
+    }
+  }
   else
   {
     resp->SetStatusCode(HttpResponse::k404NotFound);
@@ -74,6 +112,14 @@ int main(int argc, char* argv[])
     Logger::SetLogLevel(Logger::WARN);
     numThreads = atoi(argv[1]);
   }
+  std::unique_ptr<StaticFileHandler> files;
+  if (argc > 2)
+  {
+    // 第二个参数是静态文件的根目录
+    files.reset(new StaticFileHandler(argv[2]));
+    files->SetMaxMemoryFileSize(16 * 1024);
+    g_files = files.get();
+  }
   EventLoop loop;
   HttpServer server(&loop, InetAddress("127.0.0.1", 8000), "dummy");
   server.SetHttpCallback(onRequest);
@@ -0,0 +1,198 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        static_file_handler_test.cc
+// Descripton:
+
+#include "dwater/net/http/static_file_handler.h"
+#include "dwater/net/http/http_context.h"
+#include "dwater/net/http/http_response.h"
+#include "dwater/net/buffer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using dwater::string;
+using dwater::Timestamp;
+using dwater::net::Buffer;
+using dwater::net::HttpContext;
+using dwater::net::HttpRequest;
+using dwater::net::HttpResponse;
+using dwater::net::StaticFileHandler;
+
+namespace {
+
+HttpRequest MakeRequest(const string& method, const string& path, const string& headers = "") {
+  HttpContext context;
+  Buffer input;
+  input.Append(method + " " + path + " HTTP/1.1\r\n" + headers + "\r\n");
+  BOOST_REQUIRE(context.ParseRequest(&input, Timestamp::Now()));
+  BOOST_REQUIRE(context.GotAll());
+  return context.Requeset();
+}
+
+string Headers(const HttpResponse& resp) {
+  Buffer output;
+  resp.AppendHeadersToBuffer(&output, dwater::StringPiece());
+  return output.RetrieveAllAsString();
+}
+
+string Header(const string& headers, const string& field) {
+  size_t pos = headers.find("\r\n" + field + ": ");
+  if (pos == string::npos)
+    return string();
+  pos += field.size() + 4;
+  return headers.substr(pos, headers.find("\r\n", pos) - pos);
+}
+
+struct DocumentRoot {
+  DocumentRoot() {
+    char tmpl[] = "/tmp/static_file_test_XXXXXX";
+    root = ::mkdtemp(tmpl);
+    Write("/index.html", "<html>index</html>");
+    Write("/data.bin", string(100000, 'd'));
+    ::mkdir((root + "/sub").c_str(), 0755);
+    Write("/sub/a.txt", "0123456789");
+  }
+
+  ~DocumentRoot() {
+    ::system(("rm -rf " + root).c_str());
+  }
+
+  void Write(const string& path, const string& content) {
+    FILE* fp = ::fopen((root + path).c_str(), "w");
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+  }
+
+  string root;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(testServeFile)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+
+  HttpResponse resp(false);
+  BOOST_CHECK(handler.Handle(MakeRequest("GET", "/data.bin"), &resp));
+  string headers = Headers(resp);
+  BOOST_CHECK(headers.find("HTTP/1.1 200 OK\r\n") == 0);
+  BOOST_CHECK_EQUAL(Header(headers, "Content-Length"), "100000");
+  BOOST_CHECK(resp.HasBodyFile()); // 大文件用sendfile发送
+  BOOST_CHECK_EQUAL(resp.BodyFileLength(), 100000);
+  resp.BodyFileDoneCallback()();
+
+  HttpResponse index(false);
+  BOOST_CHECK(handler.Handle(MakeRequest("GET", "/"), &index));
+  BOOST_CHECK_EQUAL(Header(Headers(index), "Content-Type"), "text/html; charset=utf-8");
+
+  HttpResponse missing(false);
+  BOOST_CHECK(!handler.Handle(MakeRequest("GET", "/nothing"), &missing));
+  BOOST_CHECK(!handler.Handle(MakeRequest("GET", "/sub/../../etc/passwd"), &missing));
+  BOOST_CHECK(!handler.Handle(MakeRequest("GET", "/sub/%2e%2e/%2e%2e/etc/passwd"), &missing));
+  BOOST_CHECK(!handler.Handle(MakeRequest("GET", "/sub"), &missing)); // 目录
+
+  HttpResponse post(false);
+  BOOST_CHECK(handler.Handle(MakeRequest("POST", "/sub/a.txt"), &post));
+  BOOST_CHECK(Headers(post).find("HTTP/1.1 405") == 0);
+
+  // 第二次请求不需要重新打开
+  StaticFileHandler::Stats before = handler.GetStats();
+  HttpResponse again(false);
+  BOOST_CHECK(handler.Handle(MakeRequest("GET", "/data.bin"), &again));
+  BOOST_CHECK_EQUAL(handler.GetStats().hits, before.hits + 1);
+  BOOST_CHECK_EQUAL(handler.GetStats().misses, before.misses);
+}
+
+BOOST_AUTO_TEST_CASE(testNotModified)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+
+  HttpResponse resp(false);
+  BOOST_CHECK(handler.Handle(MakeRequest("GET", "/sub/a.txt"), &resp));
+  string headers = Headers(resp);
+  string etag = Header(headers, "ETag");
+  string last_modified = Header(headers, "Last-Modified");
+  BOOST_CHECK(!etag.empty());
+  BOOST_CHECK(!last_modified.empty());
+
+  HttpResponse by_etag(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt", "If-None-Match: " + etag + "\r\n"), &by_etag);
+  BOOST_CHECK(Headers(by_etag).find("HTTP/1.1 304 Not Modified") == 0);
+  BOOST_CHECK(Headers(by_etag).find("Content-Length") == string::npos);
+  BOOST_CHECK(Header(Headers(by_etag), "ETag") == etag);
+  BOOST_CHECK(by_etag.Body().Empty() && !by_etag.HasBodyFile());
+
+  HttpResponse by_date(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt", "If-Modified-Since: " + last_modified + "\r\n"), &by_date);
+  BOOST_CHECK(Headers(by_date).find("HTTP/1.1 304 Not Modified") == 0);
+
+  HttpResponse old_date(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt",
+                             "If-Modified-Since: Thu, 01 Jan 1970 00:00:00 GMT\r\n"), &old_date);
+  BOOST_CHECK(Headers(old_date).find("HTTP/1.1 200 OK") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(testRange)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  handler.SetMaxMemoryFileSize(1024);
+
+  HttpResponse resp(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt", "Range: bytes=2-5\r\n"), &resp);
+  string headers = Headers(resp);
+  BOOST_CHECK(headers.find("HTTP/1.1 206 Partial Content") == 0);
+  BOOST_CHECK_EQUAL(Header(headers, "Content-Range"), "bytes 2-5/10");
+  BOOST_CHECK(resp.Body() == "2345"); // 小文件在内存中
+
+  HttpResponse suffix(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt", "Range: bytes=-3\r\n"), &suffix);
+  BOOST_CHECK(suffix.Body() == "789");
+
+  HttpResponse big(false);
+  handler.Handle(MakeRequest("GET", "/data.bin", "Range: bytes=99990-\r\n"), &big);
+  BOOST_CHECK_EQUAL(Header(Headers(big), "Content-Range"), "bytes 99990-99999/100000");
+  BOOST_CHECK_EQUAL(big.BodyFileOffset(), 99990);
+  BOOST_CHECK_EQUAL(big.BodyFileLength(), 10);
+  big.BodyFileDoneCallback()();
+
+  HttpResponse unsatisfiable(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt", "Range: bytes=10-\r\n"), &unsatisfiable);
+  headers = Headers(unsatisfiable);
+  BOOST_CHECK(headers.find("HTTP/1.1 416") == 0);
+  BOOST_CHECK_EQUAL(Header(headers, "Content-Range"), "bytes */10");
+
+  // 多个区间不支持，返回整个文件
+  HttpResponse multi(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt", "Range: bytes=0-1,3-4\r\n"), &multi);
+  BOOST_CHECK(multi.Body() == "0123456789");
+  BOOST_CHECK_EQUAL(handler.GetStats().memory_bytes, 10);
+}
+
+BOOST_AUTO_TEST_CASE(testRevalidate)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  handler.SetMaxMemoryFileSize(1024);
+  handler.SetRevalidateInterval(0);
+
+  HttpResponse resp(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt"), &resp);
+  BOOST_CHECK(resp.Body() == "0123456789");
+
+  doc.Write("/sub/a.txt", "changed");
+  HttpResponse changed(false);
+  handler.Handle(MakeRequest("GET", "/sub/a.txt"), &changed);
+  BOOST_CHECK(changed.Body() == "changed");
+  BOOST_CHECK_EQUAL(handler.GetStats().cached_files, 1);
+}
@@ -0,0 +1,73 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.15
+// Filename:        idle_connection_list.cc
+// Descripton:
+
+#include "dwater/net/idle_connection_list.h"
+
+#include "dwater/base/logging.h"
+#include "dwater/base/weak_callback.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/tcp_connection.h"
+
+using namespace dwater;
+using namespace dwater::net;
+
+IdleConnectionList::IdleConnectionList(EventLoop* loop, int timeout_seconds)
+    : loop_(CHECK_NOTNULL(loop)),
+      timeout_(timeout_seconds),
+      tick_(0),
+      size_(0) {
+}
+
+IdleConnectionList::~IdleConnectionList() {
+    // 连接持有链表的shared_ptr，析构的时候链表中已经没有连接了
+    assert(size_ == 0);
+}
+
+///
+/// 定时器只持有weak_ptr，TcpServer析构之后由Stop()取消
+///
+void IdleConnectionList::Start() {
+    loop_->AssertInLoopThread();
+    timer_id_ = loop_->RunEvery(1.0, MakeWeakCallback(shared_from_this(), &IdleConnectionList::Sweep));
+}
+
+void IdleConnectionList::Stop() {
+    loop_->AssertInLoopThread();
+    loop_->Cancel(timer_id_);
+}
+
+void IdleConnectionList::Add(TcpConnection* conn, Entry* entry) {
+    loop_->AssertInLoopThread();
+    assert(!entry->linked);
+    Item item = { conn, entry, tick_ };
+    entry->pos = items_.insert(items_.end(), item);
+    entry->linked = true;
+    ++size_;
+}
+
+void IdleConnectionList::Remove(Entry* entry) {
+    loop_->AssertInLoopThread();
+    if ( entry->linked ) {
+        items_.erase(entry->pos);
+        entry->linked = false;
+        --size_;
+    }
+}
+
+///
+/// 最后一次活动的tick距离现在超过timeout_就关闭，所以空闲时间在
+/// [timeout_, timeout_ + 1)秒之间
+///
+void IdleConnectionList::Sweep() {
+    loop_->AssertInLoopThread();
+    ++tick_;
+    while ( !items_.empty() && tick_ - items_.front().tick > timeout_ ) {
+        TcpConnection* conn = items_.front().conn;
+        Remove(items_.front().entry);
+        LOG_DEBUG << "IdleConnectionList::Sweep close idle connection " << conn->Name();
+        conn->ForceClose();
+    }
+}
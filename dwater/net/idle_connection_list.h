@@ -0,0 +1,93 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.15
+// Filename:        idle_connection_list.h
+// Descripton:      一个EventLoop中按照最近活动时间排序的连接链表，用来关闭空闲连接
+//
+// 时间按秒分成tick，链表从前到后tick递增，相当于把一圈bucket首尾相连。
+// 连接有读写的时候如果不在当前tick就移到链表尾部，每个tick只需要从头部开始关闭
+// 超时的连接，不需要为每个连接设置一个定时器
+
+#ifndef DWATER_NET_IDLE_CONNECTION_LIST_H
+#define DWATER_NET_IDLE_CONNECTION_LIST_H
+
+#include "dwater/base/noncopable.h"
+#include "dwater/net/timerid.h"
+
+#include <list>
+#include <memory>
+
+namespace dwater {
+
+namespace net {
+
+class EventLoop;
+class TcpConnection;
+
+///
+/// 除了构造函数，都只能在所属的EventLoop中调用
+///
+class IdleConnectionList : noncopyable,
+                           public std::enable_shared_from_this<IdleConnectionList> {
+public:
+    struct Entry;
+
+private:
+    struct Item {
+        TcpConnection*  conn;
+        Entry*          entry;
+        int64_t         tick; // 最后一次活动的tick
+    };
+    typedef std::list<Item> ItemList;
+
+public:
+    ///
+    /// 连接在链表中的位置，由TcpConnection持有
+    ///
+    struct Entry {
+        Entry() : linked(false) {}
+
+        ItemList::iterator  pos;
+        bool                linked;
+    };
+
+    IdleConnectionList(EventLoop* loop, int timeout_seconds);
+    ~IdleConnectionList();
+
+    /// 开始每秒检查一次
+    void Start();
+
+    void Stop();
+
+    void Add(TcpConnection* conn, Entry* entry);
+
+    void Remove(Entry* entry);
+
+    ///
+    /// 连接有读写，每个tick最多移动一次
+    ///
+    void Touch(Entry* entry) {
+        if ( entry->linked && entry->pos->tick != tick_ ) {
+            items_.splice(items_.end(), items_, entry->pos);
+            entry->pos->tick = tick_;
+        }
+    }
+
+    size_t Size() const { return size_; }
+
+private:
+    void Sweep();
+
+    EventLoop*  loop_;
+    const int   timeout_;
+    int64_t     tick_;
+    ItemList    items_;
+    size_t      size_; // std::list::size()在C++11之前不是O(1)的
+    TimerId     timer_id_;
+}; // class IdleConnectionList
+
+} // namespace net
+
+} // namespace dwater
+
+#endif // DWATER_NET_IDLE_CONNECTION_LIST_H
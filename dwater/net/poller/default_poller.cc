@@ -1,11 +1,13 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.03.23
+// Last modified:   2021.04.12
 // Filename:        default_poller.cc
 // Descripton:      
 
 #include "dwater/net/poller.h"
+#include "dwater/base/logging.h"
 #include "dwater/net/poller/epoll_poller.h"
+#include "dwater/net/poller/io_uring_poller.h"
 #include "dwater/net/poller/poll_poller.h"
 
 #include <stdlib.h>
@@ -15,10 +17,17 @@ using namespace dwater::net;
 Poller* Poller::NewDefaultPoller(EventLoop* loop) {
     if ( getenv("DWATER_USE_POLL") ) {
         return new PollPoller(loop);
-    } else {
-        return new EpollPoller(loop);
     }
+#ifndef NO_IO_URING
+    if ( getenv("DWATER_USE_IO_URING") ) {
+        IoUringPoller* poller = new IoUringPoller(loop);
+        if ( poller->Valid() ) {
+            return poller;
+        }
+        // 内核不支持io_uring，退回到epoll
+        LOG_WARN << "io_uring is not available, fall back to epoll";
+        delete poller;
+    }
+#endif
+    return new EpollPoller(loop);
 }
-
-
-
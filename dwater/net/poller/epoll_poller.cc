@@ -137,6 +137,9 @@ void EpollPoller::Update(int operation, Channel* channel) {
     struct epoll_event event;
     MemZero(&event, sizeof(event));
     event.events = channel->Events();
+    if ( channel->EdgeTriggered() ) {
+        event.events |= EPOLLET;
+    }
     event.data.ptr = channel;
     int fd  = channel->Fd();
     LOG_TRACE << "epoll_ctl op = " << OperationToString(operation)
@@ -0,0 +1,365 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.12
+// Filename:        io_uring_poller.cc
+// Descripton:
+
+#ifndef NO_IO_URING
+
+#include "dwater/net/poller/io_uring_poller.h"
+
+#include "dwater/base/logging.h"
+#include "dwater/base/types.h"
+#include "dwater/net/channel.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+static_assert(sizeof(struct __kernel_timespec) == 16, "timeout_ layout");
+
+namespace {
+    const int knew = -1;
+    const int kadded = 1;
+    const int kdelete = 2;
+
+    // user_data: 低32位是fd，31位generation，最高位标记内部请求(timeout, poll remove)
+    const uint64_t kinternal_tag = 1ULL << 63;
+
+    uint64_t MakeUserData(int fd, uint32_t generation) {
+        return (static_cast<uint64_t>(generation & 0x7fffffff) << 32)
+               | static_cast<uint32_t>(fd);
+    }
+
+    int IoUringSetup(unsigned entries, struct io_uring_params* params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int IoUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                          min_complete, flags, NULL, 0));
+    }
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop) : Poller(loop),
+    ring_fd_(-1),
+    sq_entries_(0),
+    sq_ring_ptr_(MAP_FAILED),
+    sq_ring_size_(0),
+    cq_ring_ptr_(MAP_FAILED),
+    cq_ring_size_(0),
+    sqes_(NULL),
+    sqes_size_(0),
+    sq_head_(NULL),
+    sq_tail_(NULL),
+    sq_mask_(NULL),
+    sq_array_(NULL),
+    sq_local_tail_(0),
+    cq_head_(NULL),
+    cq_tail_(NULL),
+    cq_mask_(NULL),
+    cqes_(NULL) {
+    if ( !SetupRing() ) {
+        LOG_SYSERR << "IoUringPoller::IoUringPoller";
+        UnmapRing();
+    }
+}
+
+IoUringPoller::~IoUringPoller() {
+    UnmapRing();
+}
+
+bool IoUringPoller::SetupRing() {
+    struct io_uring_params params;
+    MemZero(&params, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kring_entries * 4; // 一个fd同时可能有POLL_ADD和POLL_REMOVE的完成事件
+    ring_fd_ = IoUringSetup(kring_entries, &params);
+    if ( ring_fd_ < 0 ) {
+        return false;
+    }
+    sq_entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        cq_ring_size_ = sq_ring_size_;
+    }
+    sq_ring_ptr_ = ::mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if ( sq_ring_ptr_ == MAP_FAILED ) {
+        return false;
+    }
+    if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+        cq_ring_ptr_ = sq_ring_ptr_;
+    } else {
+        cq_ring_ptr_ = ::mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if ( cq_ring_ptr_ == MAP_FAILED ) {
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if ( sqes == MAP_FAILED ) {
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring_ptr_);
+    sq_head_  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_local_tail_ = *sq_tail_;
+
+    char* cq = static_cast<char*>(cq_ring_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_    = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void IoUringPoller::UnmapRing() {
+    if ( sqes_ ) {
+        ::munmap(sqes_, sqes_size_);
+        sqes_ = NULL;
+    }
+    if ( cq_ring_ptr_ != MAP_FAILED && cq_ring_ptr_ != sq_ring_ptr_ ) {
+        ::munmap(cq_ring_ptr_, cq_ring_size_);
+    }
+    cq_ring_ptr_ = MAP_FAILED;
+    if ( sq_ring_ptr_ != MAP_FAILED ) {
+        ::munmap(sq_ring_ptr_, sq_ring_size_);
+        sq_ring_ptr_ = MAP_FAILED;
+    }
+    if ( ring_fd_ >= 0 ) {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+Timestamp IoUringPoller::Poll(int timeout_ms, ChannelList* active_channels) {
+    LOG_TRACE << "fd total count is " << channels_.size();
+    ArmDirtyChannels();
+
+    // 超时用一个count为1的IORING_OP_TIMEOUT实现，任意一个完成事件都会让它结束
+    unsigned min_complete = 0;
+    if ( timeout_ms != 0 ) {
+        min_complete = 1;
+        if ( timeout_ms > 0 ) {
+            timeout_.tv_sec = timeout_ms / 1000;
+            timeout_.tv_nsec = static_cast<int64_t>(timeout_ms % 1000) * 1000 * 1000;
+            struct io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<uint64_t>(&timeout_);
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = kinternal_tag;
+        }
+    }
+
+    int ret = Enter(PendingSubmissions(), min_complete, IORING_ENTER_GETEVENTS);
+    int saved_errno = errno;
+    Timestamp now(Timestamp::Now());
+    int num_events = FillActiveChannels(active_channels);
+    if ( num_events > 0 ) {
+        LOG_TRACE << num_events << " events happened";
+    } else if ( ret >= 0 ) {
+        LOG_TRACE << "nothing happened";
+    } else {
+        if ( saved_errno != EINTR ) {
+            errno = saved_errno;
+            LOG_SYSERR << "IoUringPoller::Poll()";
+        }
+    }
+    return now;
+}
+
+void IoUringPoller::UpdateChannel(Channel* channel) {
+    Poller::AssertInLoopThread();
+    const int index = channel->Index();
+    const int fd = channel->Fd();
+    LOG_TRACE << "fd = " << fd << " events = " << channel->Events()
+              << " index = " << index;
+    if ( index == knew ) {
+        assert(channels_.find(fd) == channels_.end());
+        channels_[fd] = channel;
+    } else {
+        assert(channels_.find(fd) != channels_.end());
+        assert(channels_[fd] == channel);
+    }
+    channel->SetIndex(channel->IsNoneEvent() ? kdelete : kadded);
+
+    Registration* reg = GetRegistration(fd);
+    assert(reg->channel == NULL || reg->channel == channel);
+    reg->channel = channel;
+    MarkDirty(fd, reg);
+}
+
+void IoUringPoller::RemoveChannel(Channel* channel) {
+    Poller::AssertInLoopThread();
+    int fd = channel->Fd();
+    LOG_TRACE << "fd = " << fd;
+    assert(channels_.find(fd) != channels_.end());
+    assert(channels_[fd] == channel);
+    assert(channel->IsNoneEvent());
+    int index = channel->Index();
+    assert(index == kadded || index == kdelete); (void)index;
+    size_t n = channels_.erase(fd); (void)n;
+    assert(n == 1);
+
+    // fd马上就会被关闭，必须立即取消，之后到达的完成事件通过generation丢弃
+    Registration* reg = GetRegistration(fd);
+    if ( reg->armed ) {
+        PrepPollRemove(fd, *reg);
+        reg->armed = false;
+    }
+    reg->channel = NULL;
+    ++reg->generation;
+    channel->SetIndex(knew);
+}
+
+IoUringPoller::Registration* IoUringPoller::GetRegistration(int fd) {
+    assert(fd >= 0);
+    if ( implicit_cast<size_t>(fd) >= registrations_.size() ) {
+        Registration empty = { NULL, 0, 0, false, false };
+        registrations_.resize(fd + 1, empty);
+    }
+    return &registrations_[fd];
+}
+
+void IoUringPoller::MarkDirty(int fd, Registration* reg) {
+    if ( !reg->dirty ) {
+        reg->dirty = true;
+        dirty_fds_.push_back(fd);
+    }
+}
+
+struct io_uring_sqe* IoUringPoller::GetSqe() {
+    if ( PendingSubmissions() == sq_entries_ ) {
+        // 提交队列满了，先提交一批
+        if ( Enter(PendingSubmissions(), 0, 0) < 0 ) {
+            LOG_SYSFATAL << "IoUringPoller::GetSqe";
+        }
+    }
+    unsigned index = sq_local_tail_ & *sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    MemZero(sqe, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+void IoUringPoller::PrepPollAdd(int fd, Registration* reg) {
+    struct io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // little endian下poll32_events的低16位就是旧内核使用的poll_events
+    sqe->poll32_events = static_cast<uint32_t>(reg->channel->Events());
+    sqe->user_data = MakeUserData(fd, reg->generation);
+    reg->armed = true;
+    reg->armed_events = reg->channel->Events();
+}
+
+void IoUringPoller::PrepPollRemove(int fd, const Registration& reg) {
+    struct io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = MakeUserData(fd, reg.generation);
+    sqe->user_data = kinternal_tag;
+}
+
+void IoUringPoller::ArmDirtyChannels() {
+    for ( int fd : dirty_fds_ ) {
+        Registration* reg = &registrations_[fd];
+        reg->dirty = false;
+        if ( reg->channel == NULL ) {
+            continue;
+        }
+        int events = reg->channel->Events();
+        if ( reg->armed && reg->armed_events == events ) {
+            continue;
+        }
+        if ( reg->armed ) {
+            PrepPollRemove(fd, *reg);
+            reg->armed = false;
+            ++reg->generation;
+        }
+        if ( events != 0 ) {
+            PrepPollAdd(fd, reg);
+        }
+    }
+    dirty_fds_.clear();
+}
+
+unsigned IoUringPoller::PendingSubmissions() const {
+    return sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+}
+
+int IoUringPoller::Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    int ret = IoUringEnter(ring_fd_, to_submit, min_complete, flags);
+    if ( ret < 0 && errno == EBUSY ) {
+        // 完成队列满了，内核暂时不接受新的请求，等收割之后再提交
+        ret = 0;
+    }
+    return ret;
+}
+
+int IoUringPoller::FillActiveChannels(ChannelList* active_channels) {
+    int num_events = 0;
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for ( ; head != tail; ++head ) {
+        const struct io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+        uint64_t user_data = cqe.user_data;
+        if ( user_data & kinternal_tag ) {
+            continue;
+        }
+        int fd = static_cast<int>(user_data & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(user_data >> 32);
+        if ( implicit_cast<size_t>(fd) >= registrations_.size() ) {
+            continue;
+        }
+        Registration* reg = &registrations_[fd];
+        if ( reg->channel == NULL || !reg->armed
+            || (reg->generation & 0x7fffffff) != generation ) {
+            continue; // 已经被取消或者fd已经被复用
+        }
+        reg->armed = false; // one-shot, 下一次Poll()重新注册
+        MarkDirty(fd, reg);
+        if ( cqe.res < 0 ) {
+            if ( cqe.res != -ECANCELED ) {
+                LOG_ERROR << "IoUringPoller::FillActiveChannels fd = " << fd
+                          << " " << strerror_tl(-cqe.res);
+            }
+            continue;
+        }
+#ifndef NDEBUG
+        ChannelMap::const_iterator it = channels_.find(fd);
+        assert(it != channels_.end());
+        assert(it->second == reg->channel);
+#endif
+        reg->channel->SetRevents(cqe.res);
+        active_channels->push_back(reg->channel);
+        ++num_events;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return num_events;
+}
+
+#endif // NO_IO_URING
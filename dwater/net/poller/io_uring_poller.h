@@ -0,0 +1,129 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.12
+// Filename:        io_uring_poller.h
+// Descripton:      poller with io_uring
+
+#ifndef DWATER_NET_POLLER_IO_URING_POLLER_H
+#define DWATER_NET_POLLER_IO_URING_POLLER_H
+
+#include "dwater/net/poller.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace dwater {
+
+namespace net {
+
+///
+/// 用io_uring实现的poller
+///
+/// 每个Channel在内核中对应一个one-shot的IORING_OP_POLL_ADD，事件完成之后在下一次
+/// Poll()中重新注册，因此语义和EpollPoller的水平触发一致，Channel/EventLoop不需要
+/// 任何改动。所有的注册、修改、删除以及等待都在一次io_uring_enter(2)中批量提交，
+/// 每轮循环只有一次系统调用，而不是epoll_wait + 若干次epoll_ctl
+///
+class IoUringPoller : public Poller {
+public:
+    IoUringPoller(EventLoop* loop);
+
+    ~IoUringPoller() override;
+
+    ///
+    /// 内核不支持io_uring（或者被seccomp禁用）时返回false，调用方应该换用EpollPoller
+    ///
+    bool Valid() const { return ring_fd_ >= 0; }
+
+    Timestamp Poll(int time_out_ms, ChannelList* active_channels) override;
+
+    ///
+    /// 只记录Channel关心的事件，真正的POLL_ADD/POLL_REMOVE在下一次Poll()中提交
+    ///
+    void UpdateChannel(Channel* channel) override;
+
+    void RemoveChannel(Channel* channel) override;
+
+private:
+    ///
+    /// 每个fd的注册状态，generation用来识别已经过期的完成事件（fd被关闭后复用）
+    ///
+    struct Registration {
+        Channel*    channel;
+        uint32_t    generation;
+        int         armed_events;   // 已经提交给内核的事件
+        bool        armed;          // 内核中是否有未完成的POLL_ADD
+        bool        dirty;          // 是否在dirty_fds_中
+    };
+
+    static const unsigned kring_entries = 256;
+
+    bool SetupRing();
+
+    void UnmapRing();
+
+    Registration* GetRegistration(int fd);
+
+    void MarkDirty(int fd, Registration* reg);
+
+    struct io_uring_sqe* GetSqe();
+
+    void PrepPollAdd(int fd, Registration* reg);
+
+    void PrepPollRemove(int fd, const Registration& reg);
+
+    ///
+    /// 把dirty_fds_中事件有变化或者已经触发过的fd重新提交给内核
+    ///
+    void ArmDirtyChannels();
+
+    unsigned PendingSubmissions() const;
+
+    int Enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+
+    ///
+    /// 收割完成队列，将有效的事件插入到active_channels中
+    ///
+    int FillActiveChannels(ChannelList* active_channels);
+
+    int         ring_fd_;
+    unsigned    sq_entries_;
+
+    void*       sq_ring_ptr_;
+    size_t      sq_ring_size_;
+    void*       cq_ring_ptr_;
+    size_t      cq_ring_size_;
+    struct io_uring_sqe* sqes_;
+    size_t      sqes_size_;
+
+    unsigned*   sq_head_;
+    unsigned*   sq_tail_;
+    unsigned*   sq_mask_;
+    unsigned*   sq_array_;
+    unsigned    sq_local_tail_;
+
+    unsigned*   cq_head_;
+    unsigned*   cq_tail_;
+    unsigned*   cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    std::vector<Registration>   registrations_; // fd->Registration
+    std::vector<int>            dirty_fds_;
+
+    // 和struct __kernel_timespec布局一致，提交之前必须一直有效
+    struct {
+        int64_t tv_sec;
+        int64_t tv_nsec;
+    }                           timeout_;
+}; // class IoUringPoller
+
+} // namespace net
+
+} // namespace dwater
+
+#endif // DWATER_NET_POLLER_IO_URING_POLLER_H
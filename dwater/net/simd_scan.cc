@@ -0,0 +1,433 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        simd_scan.cc
+// Descripton:
+
+#include "dwater/net/simd_scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DWATER_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace dwater {
+namespace net {
+namespace scan {
+
+namespace {
+
+///
+/// RFC 7230 token字符：除了分隔符之外的可见ASCII字符
+///
+struct TokenTable {
+    TokenTable() {
+        for ( int c = 0x21; c < 0x7f; ++c ) {
+            table[c] = ::strchr("\"(),/:;<=>?@[\\]{}", c) == NULL;
+        }
+    }
+
+    bool table[256] = {};
+};
+
+const TokenTable g_token_table;
+
+inline bool IsToken(char c) {
+    return g_token_table.table[static_cast<unsigned char>(c)];
+}
+
+void InitLine(LineScan* result) {
+    result->crlf = NULL;
+    result->first = NULL;
+    result->last = NULL;
+    result->count = 0;
+    result->token = true;
+}
+
+const char* FindCRLFScalar(const char* begin, const char* end) {
+    const char* p = begin;
+    while ( end - p >= 2 ) {
+        const char* cr = static_cast<const char*>(::memchr(p, '\r', end - p - 1));
+        if ( cr == NULL ) {
+            break;
+        }
+        if ( cr[1] == '\n' ) {
+            return cr;
+        }
+        p = cr + 1;
+    }
+    return NULL;
+}
+
+const char* FindDoubleCRLFScalar(const char* begin, const char* end) {
+    const char* p = begin;
+    while ( end - p >= 4 ) {
+        const char* cr = static_cast<const char*>(::memchr(p, '\r', end - p - 3));
+        if ( cr == NULL ) {
+            break;
+        }
+        if ( cr[1] == '\n' && cr[2] == '\r' && cr[3] == '\n' ) {
+            return cr;
+        }
+        p = cr + 1;
+    }
+    return NULL;
+}
+
+///
+/// 逐字节找第一个分隔符，同时检查前面的字符是不是token。字段名和方法都很短，
+/// 逐字节比memchr快。找到时返回分隔符后面的位置，行在分隔符之前结束时返回NULL
+///
+const char* ScanFirst(const char* p, const char* end, char delim, LineScan* result) {
+    for ( ; p < end; ++p ) {
+        char c = *p;
+        if ( c == delim ) {
+            result->first = p;
+            result->last = p;
+            ++result->count;
+            return p + 1;
+        }
+        // '\r'不是token字符，只有不是token的时候才需要检查行尾
+        if ( !IsToken(c) ) {
+            if ( c == '\r' && p + 1 < end && p[1] == '\n' ) {
+                result->crlf = p;
+                return NULL;
+            }
+            result->token = false;
+        }
+    }
+    return NULL;
+}
+
+/// 扫描[p, end)，接着result已有的状态。第一个分隔符之后用memchr找行尾和其他分隔符
+void ScanTail(const char* p, const char* end, char delim, LineScan* result) {
+    if ( result->first == NULL ) {
+        p = ScanFirst(p, end, delim, result);
+        if ( p == NULL ) {
+            return;
+        }
+    }
+    const char* crlf = FindCRLFScalar(p, end);
+    const char* line_end = crlf != NULL ? crlf : end;
+    while ( p < line_end ) {
+        const char* found = static_cast<const char*>(::memchr(p, delim, line_end - p));
+        if ( found == NULL ) {
+            break;
+        }
+        result->last = found;
+        ++result->count;
+        p = found + 1;
+    }
+    result->crlf = crlf;
+}
+
+void ScanLineScalar(const char* begin, const char* end, char delim, LineScan* result) {
+    InitLine(result);
+    ScanTail(begin, end, delim, result);
+}
+
+// 第一个分隔符之后只找行尾，不再数分隔符
+void ScanFieldScalar(const char* begin, const char* end, char delim, LineScan* result) {
+    InitLine(result);
+    const char* p = ScanFirst(begin, end, delim, result);
+    if ( p != NULL ) {
+        result->crlf = FindCRLFScalar(p, end);
+    }
+}
+
+#ifdef DWATER_SCAN_X86
+
+// 块内的辅助函数必须展开，否则__m256i经过内存传递
+#define DWATER_INLINE inline __attribute__((always_inline))
+
+///
+/// 一个块的掩码已经算好，第i位对应p[i]。更新result，找到行尾时返回true
+///
+/// @param crlf     "\r\n"开始的位置
+/// @param delim    分隔符的位置
+/// @param token    token字符的位置
+DWATER_INLINE bool ConsumeBlock(const char* p, int width,
+                         uint32_t crlf, uint32_t delim, uint32_t token, LineScan* result) {
+    uint32_t live = width == 32 ? 0xffffffffu : (1u << width) - 1;
+    int stop = width;
+    if ( crlf != 0 ) {
+        stop = __builtin_ctz(crlf);
+        live = (1u << stop) - 1;
+    }
+    delim &= live;
+    bool had_first = result->first != NULL;
+    if ( delim != 0 ) {
+        if ( !had_first ) {
+            result->first = p + __builtin_ctz(delim);
+        }
+        result->last = p + 31 - __builtin_clz(delim);
+        result->count += __builtin_popcount(delim);
+    }
+    if ( !had_first && result->token ) {
+        uint32_t check = live;
+        if ( result->first != NULL ) {
+            check &= (1u << (result->first - p)) - 1;
+        }
+        if ( ~token & check ) {
+            result->token = false;
+        }
+    }
+    if ( stop < width ) {
+        result->crlf = p + stop;
+        return true;
+    }
+    return false;
+}
+
+// SSE2，x86-64上总是可用
+
+DWATER_INLINE __m128i InRange(__m128i v, char lo, char hi) {
+    __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(static_cast<char>(hi - lo))), offset);
+}
+
+DWATER_INLINE __m128i Equal(__m128i v, char c) {
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+DWATER_INLINE uint32_t TokenMask(__m128i v) {
+    __m128i separator = _mm_or_si128(InRange(v, ':', '@'), InRange(v, '[', ']'));
+    separator = _mm_or_si128(separator, InRange(v, '(', ')'));
+    separator = _mm_or_si128(separator, _mm_or_si128(Equal(v, '"'), Equal(v, ',')));
+    separator = _mm_or_si128(separator, _mm_or_si128(Equal(v, '/'), Equal(v, '{')));
+    separator = _mm_or_si128(separator, Equal(v, '}'));
+    return _mm_movemask_epi8(_mm_andnot_si128(separator, InRange(v, '!', '~')));
+}
+
+const char* FindCRLFSse2(const char* begin, const char* end) {
+    const char* p = begin;
+    for ( ; end - p >= 17; p += 16 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(Equal(v, '\r'), Equal(next, '\n')));
+        if ( mask != 0 ) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindCRLFScalar(p, end);
+}
+
+const char* FindDoubleCRLFSse2(const char* begin, const char* end) {
+    const char* p = begin;
+    for ( ; end - p >= 19; p += 16 ) {
+        __m128i cr = Equal(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), '\r');
+        __m128i lf = Equal(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), '\n');
+        __m128i cr2 = Equal(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2)), '\r');
+        __m128i lf2 = Equal(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 3)), '\n');
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(cr, lf), _mm_and_si128(cr2, lf2)));
+        if ( mask != 0 ) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindDoubleCRLFScalar(p, end);
+}
+
+void ScanLineSse2(const char* begin, const char* end, char delim, LineScan* result) {
+    InitLine(result);
+    const char* p = begin;
+    for ( ; end - p >= 17; p += 16 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        uint32_t crlf = _mm_movemask_epi8(_mm_and_si128(Equal(v, '\r'), Equal(next, '\n')));
+        uint32_t delims = _mm_movemask_epi8(Equal(v, delim));
+        // 找到第一个分隔符之后不再需要检查token
+        uint32_t token = result->first == NULL ? TokenMask(v) : 0xffff;
+        if ( ConsumeBlock(p, 16, crlf, delims, token, result) ) {
+            return;
+        }
+    }
+    ScanTail(p, end, delim, result);
+}
+
+// AVX2，运行时检查CPU
+
+#define DWATER_AVX2 __attribute__((target("avx2")))
+
+DWATER_AVX2 DWATER_INLINE __m256i InRange(__m256i v, char lo, char hi) {
+    __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(static_cast<char>(hi - lo))), offset);
+}
+
+DWATER_AVX2 DWATER_INLINE __m256i Equal(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+DWATER_AVX2 DWATER_INLINE uint32_t TokenMask(__m256i v) {
+    __m256i separator = _mm256_or_si256(InRange(v, ':', '@'), InRange(v, '[', ']'));
+    separator = _mm256_or_si256(separator, InRange(v, '(', ')'));
+    separator = _mm256_or_si256(separator, _mm256_or_si256(Equal(v, '"'), Equal(v, ',')));
+    separator = _mm256_or_si256(separator, _mm256_or_si256(Equal(v, '/'), Equal(v, '{')));
+    separator = _mm256_or_si256(separator, Equal(v, '}'));
+    return _mm256_movemask_epi8(_mm256_andnot_si256(separator, InRange(v, '!', '~')));
+}
+
+DWATER_AVX2 const char* FindCRLFAvx2(const char* begin, const char* end) {
+    const char* p = begin;
+    const char* crlf = NULL;
+    for ( ; end - p >= 33; p += 32 ) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(Equal(v, '\r'), Equal(next, '\n')));
+        if ( mask != 0 ) {
+            crlf = p + __builtin_ctz(mask);
+            break;
+        }
+    }
+    // 回到SSE代码之前清掉ymm的高位，编译器不优化的时候不会自动插入
+    _mm256_zeroupper();
+    return crlf != NULL ? crlf : FindCRLFSse2(p, end);
+}
+
+DWATER_AVX2 const char* FindDoubleCRLFAvx2(const char* begin, const char* end) {
+    const char* p = begin;
+    const char* found = NULL;
+    for ( ; end - p >= 35; p += 32 ) {
+        __m256i cr = Equal(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), '\r');
+        __m256i lf = Equal(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), '\n');
+        __m256i cr2 = Equal(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2)), '\r');
+        __m256i lf2 = Equal(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 3)), '\n');
+        uint32_t mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_and_si256(cr, lf), _mm256_and_si256(cr2, lf2)));
+        if ( mask != 0 ) {
+            found = p + __builtin_ctz(mask);
+            break;
+        }
+    }
+    _mm256_zeroupper();
+    return found != NULL ? found : FindDoubleCRLFSse2(p, end);
+}
+
+DWATER_AVX2 void ScanLineAvx2(const char* begin, const char* end, char delim, LineScan* result) {
+    InitLine(result);
+    const char* p = begin;
+    for ( ; end - p >= 33; p += 32 ) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        uint32_t crlf = _mm256_movemask_epi8(_mm256_and_si256(Equal(v, '\r'), Equal(next, '\n')));
+        uint32_t delims = _mm256_movemask_epi8(Equal(v, delim));
+        uint32_t token = result->first == NULL ? TokenMask(v) : 0xffffffffu;
+        if ( ConsumeBlock(p, 32, crlf, delims, token, result) ) {
+            break;
+        }
+    }
+    _mm256_zeroupper();
+    if ( result->crlf == NULL ) {
+        ScanTail(p, end, delim, result);
+    }
+}
+
+#undef DWATER_AVX2
+#undef DWATER_INLINE
+
+#endif // DWATER_SCAN_X86
+
+struct Implementation {
+    Level   level;
+    const char* (*find_crlf)(const char* begin, const char* end);
+    const char* (*find_double_crlf)(const char* begin, const char* end);
+    void (*scan_line)(const char* begin, const char* end, char delim, LineScan* result);
+    void (*scan_field)(const char* begin, const char* end, char delim, LineScan* result);
+};
+
+// 常量初始化，其他全局对象的构造函数里也可以用
+Implementation g_impl = { kscalar, FindCRLFScalar, FindDoubleCRLFScalar, ScanLineScalar,
+                          ScanFieldScalar };
+
+bool Supported(Level level) {
+#ifdef DWATER_SCAN_X86
+    __builtin_cpu_init();
+    switch ( level ) {
+    case kscalar:
+        return true;
+    case ksse2:
+        return __builtin_cpu_supports("sse2");
+    case kavx2:
+        return __builtin_cpu_supports("avx2");
+    }
+    return false;
+#else
+    return level == kscalar;
+#endif
+}
+
+struct Detector {
+    Detector() {
+        if ( !SetLevel(kavx2) ) {
+            SetLevel(ksse2);
+        }
+    }
+};
+
+Detector g_detector;
+
+} // namespace
+
+const char* FindCRLF(const char* begin, const char* end) {
+    return g_impl.find_crlf(begin, end);
+}
+
+const char* FindDoubleCRLF(const char* begin, const char* end) {
+    return g_impl.find_double_crlf(begin, end);
+}
+
+void ScanLine(const char* begin, const char* end, char delim, LineScan* result) {
+    g_impl.scan_line(begin, end, delim, result);
+}
+
+void ScanField(const char* begin, const char* end, char delim, LineScan* result) {
+    g_impl.scan_field(begin, end, delim, result);
+}
+
+Level CurrentLevel() {
+    return g_impl.level;
+}
+
+const char* LevelName(Level level) {
+    switch ( level ) {
+    case kscalar:
+        return "scalar";
+    case ksse2:
+        return "sse2";
+    case kavx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+bool SetLevel(Level level) {
+    if ( !Supported(level) ) {
+        return false;
+    }
+    switch ( level ) {
+    case kscalar:
+        g_impl = Implementation{ kscalar, FindCRLFScalar, FindDoubleCRLFScalar, ScanLineScalar,
+                                 ScanFieldScalar };
+        break;
+#ifdef DWATER_SCAN_X86
+    case ksse2:
+        g_impl = Implementation{ ksse2, FindCRLFSse2, FindDoubleCRLFSse2, ScanLineSse2,
+                                 ScanLineSse2 };
+        break;
+    case kavx2:
+        g_impl = Implementation{ kavx2, FindCRLFAvx2, FindDoubleCRLFAvx2, ScanLineAvx2,
+                                 ScanLineAvx2 };
+        break;
+#else
+    default:
+        return false;
+#endif
+    }
+    return true;
+}
+
+} // namespace scan
+} // namespace net
+} // namespace dwater
@@ -0,0 +1,73 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        simd_scan.h
+// Descripton:      查找分隔符的SIMD实现，用于Buffer和HTTP解析
+//
+// x86上一次比较16(SSE2)或者32(AVX2)个字节，启动的时候根据CPU选择实现，
+// 其他平台只有逐字节的实现
+
+#ifndef DWATER_NET_SIMD_SCAN_H
+#define DWATER_NET_SIMD_SCAN_H
+
+namespace dwater {
+namespace net {
+namespace scan {
+
+enum Level {
+    kscalar,
+    ksse2,
+    kavx2
+};
+
+///
+/// 一行的扫描结果，行指的是到第一个"\r\n"为止
+///
+struct LineScan {
+    const char* crlf;       // "\r\n"的位置，没有完整的一行时为NULL
+    const char* first;      // 行中第一个分隔符，没有时为NULL
+    const char* last;       // 行中最后一个分隔符
+    int         count;      // 行中分隔符的个数
+    bool        token;      // first之前(没有分隔符时为整行)都是RFC 7230的token字符
+};
+
+///
+/// 返回[begin, end)中第一个"\r\n"的位置，没有时返回NULL
+///
+const char* FindCRLF(const char* begin, const char* end);
+
+///
+/// 返回[begin, end)中第一个"\r\n\r\n"的位置，用来判断头部是否完整
+///
+const char* FindDoubleCRLF(const char* begin, const char* end);
+
+///
+/// 一次扫描同时找到行尾和行中的 @c delim ，并检查第一个 @c delim 之前的字符，
+/// 头部"field: value"用':'，请求行"METHOD URI VERSION"用' '
+///
+void ScanLine(const char* begin, const char* end, char delim, LineScan* result);
+
+///
+/// 和ScanLine()一样，但是只保证crlf、first和token，last和count没有意义。
+/// 头部只需要第一个':'，逐字节的实现不用再数值里面的':'
+///
+void ScanField(const char* begin, const char* end, char delim, LineScan* result);
+
+///
+/// 当前使用的实现
+///
+Level CurrentLevel();
+
+const char* LevelName(Level level);
+
+///
+/// 用于测试和benchmark，CPU不支持的时候返回false，不改变当前实现。
+/// 必须在其他线程开始扫描之前调用
+///
+bool SetLevel(Level level);
+
+} // namespace scan
+} // namespace net
+} // namespace dwater
+
+#endif // DWATER_NET_SIMD_SCAN_H
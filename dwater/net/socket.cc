@@ -78,6 +78,22 @@ void Socket::SetTcpNoDelay(bool on) {
     ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY, &optval, static_cast<socklen_t>(sizeof(optval)));
 }
 
+bool Socket::SetZeroCopy(bool on) {
+#ifdef SO_ZEROCOPY
+    int optval = on ? 1 : 0;
+    int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, static_cast<socklen_t>(sizeof(optval)));
+    if ( ret < 0 && on ) {
+        LOG_SYSERR << "SO_ZEROCOPY failed.";
+    }
+    return ret == 0;
+#else
+    if ( on ) {
+        LOG_ERROR << "SO_ZEROCOPY is not supported.";
+    }
+    return false;
+#endif
+}
+
 void Socket::SetReuseAddr(bool on) {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &optval, static_cast<socklen_t>(sizeof(optval)));
@@ -74,6 +74,12 @@ public:
     /// 
     void SetTcpNoDelay(bool on);
 
+    ///
+    /// 开启关闭 SO_ZEROCOPY，之后才能用MSG_ZEROCOPY发送
+    ///
+    /// @return 内核不支持的时候返回false
+    bool SetZeroCopy(bool on);
+
     ///
     /// 开启关闭 SO_REUSEADDR
     /// 
@@ -12,7 +12,9 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/uio.h> // for struct iovec
 #include <unistd.h>
@@ -142,6 +144,55 @@ ssize_t socket::Write(int sockfd, const void* buf, size_t count) {
     return ::write(sockfd, buf, count);
 }
 
+ssize_t socket::Writev(int sockfd, const struct iovec* iov, int iovcnt) {
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t socket::SendFile(int sockfd, int fd, off_t* offset, size_t count) {
+    return ::sendfile(sockfd, fd, offset, count);
+}
+
+ssize_t socket::SendZeroCopy(int sockfd, const void* buf, size_t count) {
+#ifdef MSG_ZEROCOPY
+    return ::send(sockfd, buf, count, MSG_ZEROCOPY);
+#else
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+int socket::ReadZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied) {
+    char control[128];
+    struct msghdr msg;
+    MemZero(&msg, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if ( ::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0 ) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if ( cmsg == NULL ) {
+        return 0;
+    }
+    if ( !((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+           (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) ) {
+        errno = EPROTO;
+        return -1;
+    }
+    const struct sock_extended_err* serr =
+        reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cmsg));
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    if ( serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY ) {
+        *lo = serr->ee_info;
+        *hi = serr->ee_data;
+        *copied = (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+        return 1;
+    }
+#endif
+    errno = serr->ee_errno;
+    return -1;
+}
+
 void socket::Close(int sockfd) {
     if ( ::close(sockfd) < 0 ) {
         LOG_SYSERR << "socket::Close";
@@ -31,6 +31,26 @@ ssize_t Readv(int sockfd, const iovec* iov, int iovcnt);
 
 ssize_t Write(int sockfd, const void* buf, size_t count);
 
+ssize_t Writev(int sockfd, const struct iovec* iov, int iovcnt);
+
+///
+/// sendfile(2)，从文件 @c fd 的 @c *offset 开始发送，成功的时候更新 @c *offset
+///
+ssize_t SendFile(int sockfd, int fd, off_t* offset, size_t count);
+
+///
+/// 带MSG_ZEROCOPY的send(2)，socket必须先开启SO_ZEROCOPY。每次成功的调用
+/// 按顺序占用一个序号，内核不再使用 @c buf 之后在错误队列中通知这个序号
+///
+ssize_t SendZeroCopy(int sockfd, const void* buf, size_t count);
+
+///
+/// 从错误队列中读一个MSG_ZEROCOPY的完成通知，序号 [*lo, *hi] 的发送都已经完成，
+/// @c *copied 为true表示内核没有做到零拷贝，还是拷贝了数据
+///
+/// @return 1 读到一个通知，0 错误队列为空，-1 错误队列中是别的错误，保存在errno
+int ReadZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied);
+
 void Close(int sockfd);
 
 void ShutdownWrite(int sockfd);
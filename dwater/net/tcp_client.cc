@@ -41,6 +41,7 @@ TcpClient::TcpClient(EventLoop* loop,
       message_callback_(DefaultMessageCallback),
       retry_(false),
       connect_(true),
+      edge_triggered_(false),
       next_conn_id_(1) {
     
           connector_->SetNewConnectionCallback(
@@ -112,8 +113,10 @@ void TcpClient::NewConnection(int sockfd) {
                                             peer_addr));
     conn->SetConnectionCallback(connection_callback_);
     conn->SetMessageCallback(message_callback_);
+    conn->SetChainMessageCallback(chain_message_callback_);
     conn->SetWriteCompleteCallback(write_complete_callback_);
     conn->SetCloseCallback(std::bind(&TcpClient::RemoveConnection, this, _1));
+    conn->SetEdgeTriggered(edge_triggered_);
     {
         MutexLockGuard lock(mutex_);
         connection_ = conn;
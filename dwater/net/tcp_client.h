@@ -59,10 +59,21 @@ public:
         message_callback_ =std::move(cb);
     }
 
+    void SetChainMessageCallback(ChainMessageCallback cb) {
+        chain_message_callback_ = std::move(cb);
+    }
+
     void SetWriteCompleteCallback(WriteCompleteCallback cb) {
         write_complete_callback_ =std::move(cb);
     }
 
+    ///
+    /// 新建立的连接使用边缘触发，必须在Connect()之前调用
+    ///
+    void SetEdgeTriggered(bool on) {
+        edge_triggered_ = on;
+    }
+
 private:
     void NewConnection(int sockfd);
 
@@ -73,9 +84,11 @@ private:
     const string                        name_;
     ConnectionCallback                  connection_callback_;
     MessageCallback                     message_callback_;
+    ChainMessageCallback                chain_message_callback_;
     WriteCompleteCallback               write_complete_callback_;
     bool                                retry_;
     bool                                connect_;
+    bool                                edge_triggered_;
     int                                 next_conn_id_;
     mutable MutexLock                   mutex_;
     TcpConnectionPtr                    connection_ GUARDED_BY(mutex_);
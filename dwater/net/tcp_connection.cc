@@ -18,6 +18,13 @@
 using namespace dwater;
 using namespace dwater::net;
 
+namespace {
+// EventLoop共享的输入Buffer被一次大的读撑大之后缩小到默认大小
+const size_t kmax_shared_input_buffer = 1024 * 1024;
+// 一次sendfile(2)最多发送的字节数，避免一个连接占用太长时间
+const size_t kmax_send_file = 1024 * 1024;
+} // unnamed namespace
+
 void dwater::net::DefaultConnectionCallback(const TcpConnectionPtr& conn) {
     LOG_TRACE << conn->LocalAddress().ToIpPort() << " -> "
               << conn->PeerAddress().ToIpPort() << " is "
@@ -39,17 +46,29 @@ TcpConnection::TcpConnection(EventLoop* loop,
       name_(name_arg),
       state_(kconnecting),
       reading_(true),
+      edge_triggered_(false),
       socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)),
       local_addr_(local_addr),
       peer_addr_(peer_addr),
-      high_water_mark_(64 * 1024 * 1024) {
+      high_water_mark_(64 * 1024 * 1024),
+      input_buffer_(0),
+      batch_depth_(0),
+      pending_segment_bytes_(0),
+      buffered_before_segments_(0),
+      zerocopy_next_seq_(0),
+      zerocopy_threshold_(0),
+      zerocopy_stats_{ 0, 0, 0 } {
+    input_chain_.SetBlockPool(loop_->BlockPool());
+    output_buffer_.SetBlockPool(loop_->BlockPool());
     channel_->SetReadCallback(std::bind(&TcpConnection::HandleRead, this, _1));
     channel_->SetWriteCallback(std::bind(&TcpConnection::HandleWrite, this));
     channel_->SetCloseCallback(std::bind(&TcpConnection::HandleClose, this));
     channel_->SetErrorCallback(std::bind(&TcpConnection::HandleError, this));
     LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] at " << this << " fd = " <<  sockfd;
     socket_->SetKeepAlive(true);
+    // 在选择EventLoop的线程中同步计数，连续建立的连接马上能看到
+    loop_->AddConnectionCount(1);
 }
 
 TcpConnection::~TcpConnection() {
@@ -102,6 +121,20 @@ void TcpConnection::Send(Buffer* buf) {
     }
 }
 
+void TcpConnection::Send(ChainBuffer* buf) {
+    if ( state_ == kconnected ) {
+        if ( loop_->IsInLoopThread() ) {
+            SendInLoop(buf);
+        } else {
+            std::shared_ptr<ChainBuffer> message(new ChainBuffer);
+            message->Append(buf);
+            loop_->RunInLoop(std::bind(&TcpConnection::SendChainInLoop,
+                                       this,
+                                       message));
+        }
+    }
+}
+
 void TcpConnection::SendInLoop(const StringPiece&  message) {
     SendInLoop(message.Data(), message.Size());
 }
@@ -115,7 +148,7 @@ void TcpConnection::SendInLoop(const void* data, size_t len) {
         LOG_WARN << "disconnected, give up writing";
         return;
     }
-    if ( !channel_->IsWriting() && output_buffer_.ReadableBytes() == 0 ) {
+    if ( !channel_->IsWriting() && OutputEmpty() && batch_depth_ == 0 ) {
         n_wrote = socket::Write(channel_->Fd(), data, len);
         if ( n_wrote >= 0 ) {
             remaining = len - n_wrote;
@@ -135,17 +168,337 @@ void TcpConnection::SendInLoop(const void* data, size_t len) {
 
     assert(remaining <= len);
     if ( !fault_error && remaining > 0 ) {
-        size_t old_len = output_buffer_.ReadableBytes();
-        // 超过高水位，就触发高水位回调发送数据
-        if ( old_len + remaining >= high_water_mark_
-            && old_len < high_water_mark_
-            && high_water_mark_callback_) {
-            loop_->QueueInLoop(std::bind(high_water_mark_callback_, shared_from_this(), old_len + remaining));
-        }
+        CheckHighWaterMark(remaining);
         output_buffer_.Append(static_cast<const char*>(data) + n_wrote, remaining);
-        if ( !channel_->IsWriting() ) {
+        // batch中等EndBatch()一起写
+        if ( !channel_->IsWriting() && batch_depth_ == 0 ) {
+            channel_->EnableWriting();
+        }
+    }
+}
+
+void TcpConnection::SendChainInLoop(const std::shared_ptr<ChainBuffer>& message) {
+    SendInLoop(GetPointer(message));
+}
+
+///
+/// 和SendInLoop(const void*, size_t)一样，output_buffer_为空的时候先直接写，
+/// 剩下的slice移动到output_buffer_中
+///
+void TcpConnection::SendInLoop(ChainBuffer* message) {
+    loop_->AssertInLoopThread();
+    bool fault_error = false;
+    if ( state_ == kdisconnected ) {
+        LOG_WARN << "disconnected, give up writing";
+        message->RetrieveAll();
+        return;
+    }
+    if ( !channel_->IsWriting() && OutputEmpty() && batch_depth_ == 0 ) {
+        int saved_errno = 0;
+        ssize_t n_wrote = message->WriteFd(channel_->Fd(), &saved_errno);
+        if ( n_wrote >= 0 ) {
+            if ( message->ReadableBytes() == 0 && write_complete_callback_ ) {
+                loop_->QueueInLoop(std::bind(write_complete_callback_, shared_from_this()));
+            }
+        } else if ( saved_errno != EWOULDBLOCK ) {
+            errno = saved_errno;
+            LOG_SYSERR << "TcpConnection::SendInLoop";
+            if ( errno == EPIPE || errno == ECONNRESET ) {
+                fault_error = true;
+            }
+        }
+    }
+
+    size_t remaining = message->ReadableBytes();
+    if ( !fault_error && remaining > 0 ) {
+        CheckHighWaterMark(remaining);
+        output_buffer_.Append(message);
+        if ( !channel_->IsWriting() && batch_depth_ == 0 ) {
+            channel_->EnableWriting();
+        }
+    }
+    message->RetrieveAll();
+}
+
+void TcpConnection::SendExternal(const void* data, size_t len,
+                                 const ExternalBuffer::DoneCallback& done) {
+    if ( state_ == kconnected ) {
+        if ( loop_->IsInLoopThread() ) {
+            SendExternalInLoop(data, len, done);
+        } else {
+            loop_->RunInLoop(std::bind(&TcpConnection::SendExternalInLoop,
+                                       this, data, len, done));
+        }
+    } else if ( done ) {
+        done();
+    }
+}
+
+///
+/// 先追加到output_buffer_中，和前面还没有写出的数据一起用一次writev写出
+///
+void TcpConnection::SendExternalInLoop(const void* data, size_t len,
+                                       const ExternalBuffer::DoneCallback& done) {
+    loop_->AssertInLoopThread();
+    if ( state_ == kdisconnected ) {
+        LOG_WARN << "disconnected, give up writing";
+        if ( done ) {
+            done();
+        }
+        return;
+    }
+    CheckHighWaterMark(len);
+    output_buffer_.AppendExternal(data, len, done);
+    if ( batch_depth_ == 0 ) {
+        FlushOutput();
+    }
+}
+
+const size_t TcpConnection::kdefault_zerocopy_threshold;
+
+void TcpConnection::SendFile(int fd, off_t offset, size_t length,
+                             const ExternalBuffer::DoneCallback& done) {
+    if ( state_ == kconnected ) {
+        if ( loop_->IsInLoopThread() ) {
+            SendFileInLoop(fd, offset, length, done);
+        } else {
+            loop_->RunInLoop(std::bind(&TcpConnection::SendFileInLoop,
+                                       this, fd, offset, length, done));
+        }
+    } else if ( done ) {
+        done();
+    }
+}
+
+void TcpConnection::SendFileInLoop(int fd, off_t offset, size_t length,
+                                   const ExternalBuffer::DoneCallback& done) {
+    loop_->AssertInLoopThread();
+    if ( state_ == kdisconnected || length == 0 ) {
+        if ( state_ == kdisconnected ) {
+            LOG_WARN << "disconnected, give up sending file";
+        }
+        if ( done ) {
+            done();
+        }
+        return;
+    }
+    AppendSegment(fd, offset, length, done, std::shared_ptr<const string>());
+}
+
+void TcpConnection::Send(const std::shared_ptr<const string>& message) {
+    if ( state_ == kconnected ) {
+        if ( loop_->IsInLoopThread() ) {
+            SendSharedInLoop(message);
+        } else {
+            loop_->RunInLoop(std::bind(&TcpConnection::SendSharedInLoop, this, message));
+        }
+    }
+}
+
+///
+/// 小消息作为ExternalBuffer追加到output_buffer_中，完成回调持有消息的引用
+///
+void TcpConnection::SendSharedInLoop(const std::shared_ptr<const string>& message) {
+    loop_->AssertInLoopThread();
+    if ( zerocopy_threshold_ == 0 || message->size() < zerocopy_threshold_ ) {
+        std::shared_ptr<const string> hold(message);
+        SendExternalInLoop(message->data(), message->size(), [hold] {});
+    } else if ( state_ == kdisconnected ) {
+        LOG_WARN << "disconnected, give up writing";
+    } else {
+        AppendSegment(-1, 0, message->size(), ExternalBuffer::DoneCallback(), message);
+    }
+}
+
+///
+/// 这一段之后Send()的数据也追加到output_buffer_中，等这一段发送完再发送
+///
+void TcpConnection::AppendSegment(int file_fd, off_t offset, size_t length,
+                                  const ExternalBuffer::DoneCallback& done,
+                                  const std::shared_ptr<const string>& message) {
+    CheckHighWaterMark(length);
+    size_t buffered_before = output_buffer_.ReadableBytes() - buffered_before_segments_;
+    pending_segments_.push_back(
+            PendingSegment{ file_fd, offset, length, buffered_before, done, message });
+    pending_segment_bytes_ += length;
+    buffered_before_segments_ += buffered_before;
+    if ( batch_depth_ == 0 ) {
+        FlushOutput();
+    }
+}
+
+bool TcpConnection::EnableZeroCopy(size_t threshold) {
+    loop_->AssertInLoopThread();
+    assert(threshold > 0);
+    if ( !socket_->SetZeroCopy(true) ) {
+        return false;
+    }
+    zerocopy_threshold_ = threshold;
+    channel_->SetErrorQueueCallback(std::bind(&TcpConnection::HandleErrorQueue, this));
+    return true;
+}
+
+ssize_t TcpConnection::WriteOutput(int* saved_errno) {
+    ssize_t total = 0;
+    while ( !pending_segments_.empty() ) {
+        PendingSegment& segment = pending_segments_.front();
+        ssize_t n = 0;
+        if ( segment.buffered_before > 0 ) {
+            n = output_buffer_.WriteFd(channel_->Fd(), segment.buffered_before, saved_errno);
+            if ( n > 0 ) {
+                segment.buffered_before -= n;
+                buffered_before_segments_ -= n;
+                total += n;
+                if ( segment.buffered_before > 0 ) {
+                    return total; // socket写满了
+                }
+                continue;
+            }
+            return total > 0 ? total : n;
+        }
+
+        if ( segment.file_fd >= 0 ) {
+            n = socket::SendFile(channel_->Fd(), segment.file_fd, &segment.offset,
+                                 std::min(segment.remaining, kmax_send_file));
+        } else {
+            const char* data = segment.message->data() + segment.offset;
+            n = socket::SendZeroCopy(channel_->Fd(), data, segment.remaining);
+            if ( n > 0 ) {
+                zerocopy_sends_.push_back(ZeroCopySend{ zerocopy_next_seq_++, false, segment.message });
+                ++zerocopy_stats_.sends;
+            } else if ( n < 0 && errno == ENOBUFS ) {
+                // 锁住的页面超过了optmem的限制，这一次普通地发送
+                n = socket::Write(channel_->Fd(), data, segment.remaining);
+            }
+            if ( n > 0 ) {
+                segment.offset += n;
+            }
+        }
+        if ( n > 0 ) {
+            segment.remaining -= n;
+            pending_segment_bytes_ -= n;
+            total += n;
+            if ( segment.remaining > 0 ) {
+                return total;
+            }
+            ExternalBuffer::DoneCallback done;
+            done.swap(segment.done);
+            pending_segments_.pop_front();
+            if ( done ) {
+                done();
+            }
+            continue;
+        }
+
+        *saved_errno = n == 0 ? EIO : errno;
+        if ( segment.file_fd >= 0 && *saved_errno != EWOULDBLOCK
+             && *saved_errno != EPIPE && *saved_errno != ECONNRESET ) {
+            // 文件出错或者比指定的长度短，后面的数据已经没有意义了
+            errno = *saved_errno;
+            LOG_SYSERR << "TcpConnection::WriteOutput sendfile";
+            ForceClose();
+        }
+        return total > 0 ? total : -1;
+    }
+    if ( output_buffer_.ReadableBytes() == 0 ) {
+        return total;
+    }
+    ssize_t n = output_buffer_.WriteFd(channel_->Fd(), saved_errno);
+    return n > 0 ? total + n : (total > 0 ? total : n);
+}
+
+void TcpConnection::DropPendingSegments() {
+    std::deque<PendingSegment> segments;
+    segments.swap(pending_segments_);
+    pending_segment_bytes_ = 0;
+    buffered_before_segments_ = 0;
+    for ( PendingSegment& segment : segments ) {
+        if ( segment.done ) {
+            segment.done();
+        }
+    }
+}
+
+///
+/// 读空错误队列，完成的发送按序号从zerocopy_sends_的头部释放。
+/// 错误队列里没有完成通知的时候是真正的错误
+///
+void TcpConnection::HandleErrorQueue() {
+    loop_->AssertInLoopThread();
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    bool copied = false;
+    bool got_completion = false;
+    int ret = 0;
+    while ( (ret = socket::ReadZeroCopyCompletion(channel_->Fd(), &lo, &hi, &copied)) > 0 ) {
+        got_completion = true;
+        zerocopy_stats_.completions += hi - lo + 1;
+        if ( copied ) {
+            ++zerocopy_stats_.copied;
+        }
+        // zerocopy_sends_中的序号是连续的，序号会回绕，都用uint32_t计算
+        for ( uint32_t seq = lo; seq != hi + 1 && !zerocopy_sends_.empty(); ++seq ) {
+            uint32_t index = seq - zerocopy_sends_.front().seq;
+            if ( index < zerocopy_sends_.size() ) {
+                zerocopy_sends_[index].completed = true;
+            }
+        }
+    }
+    while ( !zerocopy_sends_.empty() && zerocopy_sends_.front().completed ) {
+        zerocopy_sends_.pop_front();
+    }
+    if ( ret < 0 || !got_completion ) {
+        HandleError();
+    }
+}
+
+void TcpConnection::BeginBatch() {
+    loop_->AssertInLoopThread();
+    ++batch_depth_;
+}
+
+void TcpConnection::EndBatch() {
+    loop_->AssertInLoopThread();
+    assert(batch_depth_ > 0);
+    if ( --batch_depth_ == 0 ) {
+        FlushOutput();
+    }
+}
+
+void TcpConnection::FlushOutput() {
+    if ( state_ == kdisconnected || channel_->IsWriting() ) {
+        return;
+    }
+    if ( !OutputEmpty() ) {
+        int saved_errno = 0;
+        ssize_t n = WriteOutput(&saved_errno);
+        if ( n < 0 && saved_errno != EWOULDBLOCK ) {
+            errno = saved_errno;
+            LOG_SYSERR << "TcpConnection::FlushOutput";
+            if ( saved_errno == EPIPE || saved_errno == ECONNRESET ) {
+                return;
+            }
+        }
+        if ( !OutputEmpty() ) {
             channel_->EnableWriting();
+            return;
         }
+        if ( write_complete_callback_ ) {
+            loop_->QueueInLoop(std::bind(write_complete_callback_, shared_from_this()));
+        }
+    }
+    if ( state_ == kdisconnecting ) {
+        ShutdownInLoop();
+    }
+}
+
+void TcpConnection::CheckHighWaterMark(size_t appending) {
+    size_t old_len = output_buffer_.ReadableBytes() + pending_segment_bytes_;
+    // 超过高水位，就触发高水位回调发送数据
+    if ( old_len + appending >= high_water_mark_
+        && old_len < high_water_mark_
+        && high_water_mark_callback_) {
+        loop_->QueueInLoop(std::bind(high_water_mark_callback_, shared_from_this(), old_len + appending));
     }
 }
 
@@ -158,7 +511,8 @@ void TcpConnection::Shutdown() {
 
 void TcpConnection::ShutdownInLoop() {
     loop_->AssertInLoopThread();
-    if ( !channel_->IsWriting() ) {
+    // batch中还没有写出的数据也在output_buffer_中，FlushOutput()写完之后再关闭
+    if ( !channel_->IsWriting() && OutputEmpty() ) {
         socket_->ShutdownWrite();
     }
 }
@@ -186,6 +540,13 @@ void TcpConnection::ForceCloseInLoop() {
     }
 }
 
+void TcpConnection::SetState(StateE state) {
+    if ( state == kdisconnected && state_ != kdisconnected ) {
+        loop_->AddConnectionCount(-1);
+    }
+    state_ = state;
+}
+
 const char* TcpConnection::StateToString() const {
     switch (state_) {
     case kdisconnected:
@@ -205,6 +566,12 @@ void TcpConnection::SetTcpNoDelay(bool on) {
     socket_->SetTcpNoDelay(on);
 }
 
+void TcpConnection::SetEdgeTriggered(bool on) {
+    assert(state_ == kconnecting);
+    edge_triggered_ = on;
+    channel_->SetEdgeTriggered(on);
+}
+
 void TcpConnection::StartRead() {
     loop_->RunInLoop(std::bind(&TcpConnection::StartReadInLoop, this));
 }
@@ -235,55 +602,119 @@ void TcpConnection::ConnectionEstablished() {
     SetState(kconnected);
     channel_->Tie(shared_from_this());
     channel_->EnableReading();
+    if ( idle_list_ ) {
+        idle_list_->Add(this, &idle_entry_);
+    }
     connection_callback_(shared_from_this());
 }
 
 void TcpConnection::ConnectionDestroyed() {
     loop_->AssertInLoopThread();
-    if ( state_ == kconnected ) {
+    // Shutdown()之后对方还没有关闭的时候TcpServer析构，也要先DisableAll()
+    if ( state_ == kconnected || state_ == kdisconnecting ) {
         SetState(kdisconnected);
         channel_->DisableAll();
         connection_callback_(shared_from_this());
     }
+    RemoveFromIdleList();
+    DropPendingSegments();
     // 主动移除自己
     channel_->Remove();
 }
 
 void TcpConnection::HandleRead(Timestamp receive_time) {
     loop_->AssertInLoopThread();
-    int saved_errno = 0;
-    ssize_t n = input_buffer_.ReadFd(channel_->Fd(), &saved_errno);
-    if ( n > 0 ) {
-        message_callback_(shared_from_this(), &input_buffer_, receive_time);
-    } else if (n == 0) {
-        HandleClose();
-    }else {
-        errno = saved_errno;
-        LOG_SYSERR << "TcpConnection::HandleRead";
-        HandleError();
+    if ( idle_list_ ) {
+        idle_list_->Touch(&idle_entry_);
+    }
+    // 回调中Send()的数据在最后用一次writev写出
+    BeginBatch();
+    // 水平触发只读一次，边缘触发要一直读到EAGAIN，否则剩下的数据不会再有通知
+    do {
+        int saved_errno = 0;
+        ssize_t n = 0;
+        if ( chain_message_callback_ ) {
+            n = input_chain_.ReadFd(channel_->Fd(), &saved_errno);
+            if ( n > 0 ) {
+                chain_message_callback_(shared_from_this(), &input_chain_, receive_time);
+            }
+        } else if ( input_buffer_.ReadableBytes() > 0 ) {
+            n = input_buffer_.ReadFd(channel_->Fd(), &saved_errno);
+            if ( n > 0 ) {
+                message_callback_(shared_from_this(), &input_buffer_, receive_time);
+                ReleaseInputBufferIfEmpty();
+            }
+        } else {
+            // 没有剩下的数据，读到EventLoop共享的Buffer中，处理不完的才拷贝出来
+            Buffer* shared = loop_->SharedInputBuffer();
+            assert(shared->ReadableBytes() == 0);
+            n = shared->ReadFd(channel_->Fd(), &saved_errno);
+            if ( n > 0 ) {
+                message_callback_(shared_from_this(), shared, receive_time);
+                if ( shared->ReadableBytes() > 0 ) {
+                    input_buffer_.Append(shared->Peek(), shared->ReadableBytes());
+                    shared->RetrieveAll();
+                }
+                if ( shared->InternalCapacity() > kmax_shared_input_buffer ) {
+                    shared->Shrink(0);
+                }
+            }
+        }
+        if ( n == 0 ) {
+            HandleClose();
+            break;
+        } else if ( n < 0 ) {
+            if ( edge_triggered_ && saved_errno == EWOULDBLOCK ) {
+                break;
+            }
+            errno = saved_errno;
+            LOG_SYSERR << "TcpConnection::HandleRead";
+            HandleError();
+            break;
+        }
+    } while ( edge_triggered_ && state_ != kdisconnected && reading_ );
+    EndBatch();
+}
+
+///
+/// 输入缓冲区中的数据都处理完之后释放它的内存
+///
+void TcpConnection::ReleaseInputBufferIfEmpty() {
+    if ( input_buffer_.ReadableBytes() == 0
+         && input_buffer_.InternalCapacity() > Buffer::kcheap_prepend ) {
+        Buffer empty(0);
+        input_buffer_.Swap(empty);
     }
 }
 
 void TcpConnection::HandleWrite() {
     loop_->AssertInLoopThread();
+    if ( idle_list_ ) {
+        idle_list_->Touch(&idle_entry_);
+    }
     if ( channel_->IsWriting() ) {
-        ssize_t n = socket::Write(channel_->Fd(),
-                                  output_buffer_.Peek(),
-                                  output_buffer_.ReadableBytes());
-        if ( n > 0 ) {
-            output_buffer_.Retrieve(n);
-            if ( output_buffer_.ReadableBytes() == 0 ) {
-                channel_->DisableWriting();
-                if ( write_complete_callback_ ) {
-                    loop_->QueueInLoop(std::bind(write_complete_callback_, shared_from_this()));
+        do {
+            int saved_errno = 0;
+            ssize_t n = WriteOutput(&saved_errno);
+            if ( n > 0 ) {
+                if ( OutputEmpty() ) {
+                    channel_->DisableWriting();
+                    if ( write_complete_callback_ ) {
+                        loop_->QueueInLoop(std::bind(write_complete_callback_, shared_from_this()));
+                    }
+                    if ( state_ == kdisconnecting ) {
+                        ShutdownInLoop();
+                    }
+                    break;
                 }
-                if ( state_ == kdisconnecting ) {
-                    ShutdownInLoop();
+            } else {
+                errno = saved_errno;
+                if ( !edge_triggered_ || errno != EWOULDBLOCK ) {
+                    LOG_SYSERR << "TcpConnection::HandleWrite";
                 }
+                break;
             }
-        } else {
-            LOG_SYSERR << "TcpConnection::HandleWrite";
-        }
+        } while ( edge_triggered_ );
     } else {
         LOG_TRACE << "Connection fd = " << channel_->Fd() << "  is down, no more writing";
     }
@@ -295,6 +726,8 @@ void TcpConnection::HandleClose() {
     assert(state_ == kconnected || state_ == kdisconnecting);
     SetState(kdisconnected);
     channel_->DisableAll();
+    RemoveFromIdleList();
+    DropPendingSegments();
     
     TcpConnectionPtr guard_this(shared_from_this());
     connection_callback_(guard_this);
@@ -12,8 +12,11 @@
 #include "dwater/base/types.h"
 #include "dwater/net/callbacks.h"
 #include "dwater/net/buffer.h"
+#include "dwater/net/chain_buffer.h"
+#include "dwater/net/idle_connection_list.h"
 #include "dwater/net/inet_address.h"
 
+#include <deque>
 #include <memory>
 #include <boost/any.hpp>
 
@@ -62,6 +65,59 @@ public:
 
     void Send(Buffer* message);
 
+    ///
+    /// 发送链式buffer中的全部数据，只移动slice不拷贝数据，用writev写出
+    ///
+    void Send(ChainBuffer* message);
+
+    ///
+    /// 发送用户自己的内存，不拷贝。数据写完或者连接断开丢弃之后在IO线程中调用
+    /// @c done，在这之前 @c data 必须一直有效
+    ///
+    void SendExternal(const void* data, size_t len, const ExternalBuffer::DoneCallback& done);
+
+    ///
+    /// 用sendfile(2)发送文件 @c fd 中从 @c offset 开始的 @c length 字节，不经过用户空间
+    ///
+    /// 和前后Send()的数据保持顺序，socket可写的时候一段一段地发送，没有发送的部分
+    /// 也计入高水位。发送完或者连接断开丢弃之后在IO线程中调用 @c done，
+    /// 在这之前不能关闭 @c fd
+    void SendFile(int fd, off_t offset, size_t length, const ExternalBuffer::DoneCallback& done);
+
+    ///
+    /// 发送共享的只读消息，不拷贝到output_buffer_中，发送完之后释放引用
+    ///
+    /// 开启了EnableZeroCopy()并且消息不小于阈值的时候用MSG_ZEROCOPY发送，
+    /// 内核通知完成之前一直持有消息
+    void Send(const std::shared_ptr<const string>& message);
+
+    static const size_t kdefault_zerocopy_threshold = 256 * 1024;
+
+    ///
+    /// 不小于 @c threshold 字节的Send(shared_ptr)用MSG_ZEROCOPY发送，只能在IO线程调用
+    ///
+    /// 零拷贝要锁住页面、处理错误队列中的完成通知，只有大消息才划算，
+    /// 见tests/zerocopy_bench.cc
+    /// @return 内核不支持的时候返回false
+    bool EnableZeroCopy(size_t threshold = kdefault_zerocopy_threshold);
+
+    struct ZeroCopyStats {
+        int64_t sends;          // 用MSG_ZEROCOPY的send(2)次数
+        int64_t completions;    // 完成的发送次数
+        int64_t copied;         // 完成的时候内核报告还是拷贝了数据的通知数，比如loopback
+    };
+
+    const ZeroCopyStats& GetZeroCopyStats() const { return zerocopy_stats_; }
+
+    ///
+    /// 在BeginBatch()和EndBatch()之间Send()的数据只追加到output_buffer_中，
+    /// EndBatch()的时候用一次writev写出。只能在IO线程调用，可以嵌套
+    ///
+    /// MessageCallback已经在一个batch中调用，回调中分开发送的多个消息合并成一次writev
+    void BeginBatch();
+
+    void EndBatch();
+
     void Shutdown(); 
 
     void ForceClose();
@@ -70,6 +126,24 @@ public:
 
     void SetTcpNoDelay(bool on);
 
+    ///
+    /// 使用边缘触发，必须在ConnectionEstablished()之前调用
+    ///
+    /// 读事件一直读到EAGAIN，写事件一直写到output_buffer_为空或者EAGAIN，
+    /// 残留的数据不会让epoll_wait在每一轮循环中都被唤醒
+    void SetEdgeTriggered(bool on);
+
+    bool EdgeTriggered() const { return edge_triggered_; }
+
+    ///
+    /// 加入所在EventLoop的空闲连接链表，长时间没有读写会被关闭，
+    /// 必须在ConnectionEstablished()之前调用
+    ///
+    void SetIdleConnectionList(const std::shared_ptr<IdleConnectionList>& idle_list) {
+        assert(state_ == kconnecting);
+        idle_list_ = idle_list;
+    }
+
     void StartRead();
 
     void StopRead();
@@ -90,6 +164,13 @@ public:
         message_callback_ = cb;
     }
 
+    ///
+    /// 设置之后数据读到ChainBuffer中，代替MessageCallback
+    ///
+    void SetChainMessageCallback(const ChainMessageCallback& cb) {
+        chain_message_callback_ = cb;
+    }
+
     void SetWriteCompleteCallback(const WriteCompleteCallback& cb) {
         write_complete_callback_ = cb;
     }
@@ -107,7 +188,11 @@ public:
         return &input_buffer_;
     }
 
-    Buffer* OutputBuffer() {
+    ChainBuffer* InputChain() {
+        return &input_chain_;
+    }
+
+    ChainBuffer* OutputBuffer() {
         return &output_buffer_;
     }
 
@@ -117,16 +202,65 @@ public:
 private:
     enum StateE { kdisconnected, kconnecting, kconnected, kdisconnecting };
     void HandleRead(Timestamp receive_time);
+    void ReleaseInputBufferIfEmpty();
     void HandleWrite();
     void HandleClose();
     void HandleError();
+    void HandleErrorQueue();
 
     void SendInLoop(const StringPiece& message);
     void SendInLoop(const void* Message, size_t len);
+    void SendInLoop(ChainBuffer* message);
+    void SendChainInLoop(const std::shared_ptr<ChainBuffer>& message);
     void ShutdownInLoop();
 
     void ForceCloseInLoop();
-    void SetState(StateE state) { state_ = state; }
+    void SendExternalInLoop(const void* data, size_t len, const ExternalBuffer::DoneCallback& done);
+    void SendFileInLoop(int fd, off_t offset, size_t length,
+                        const ExternalBuffer::DoneCallback& done);
+    void SendSharedInLoop(const std::shared_ptr<const string>& message);
+
+    ///
+    /// 追加一段文件或者零拷贝消息，记下output_buffer_中有多少数据要在它之前发送
+    ///
+    void AppendSegment(int file_fd, off_t offset, size_t length,
+                       const ExternalBuffer::DoneCallback& done,
+                       const std::shared_ptr<const string>& message);
+
+    ///
+    /// output_buffer_和pending_segments_都发送完了
+    ///
+    bool OutputEmpty() const {
+        return output_buffer_.ReadableBytes() == 0 && pending_segments_.empty();
+    }
+
+    ///
+    /// 按顺序写output_buffer_中的数据、文件和零拷贝消息，直到都写完或者socket写满
+    ///
+    /// @return 写出的字节数，一个字节都没有写出的时候返回-1并保存errno
+    ssize_t WriteOutput(int* saved_errno);
+
+    ///
+    /// 连接断开的时候丢弃还没有发送的文件和消息，调用完成回调
+    ///
+    void DropPendingSegments();
+
+    ///
+    /// 没有在等待可写事件的时候把output_buffer_中的数据写出去，写不完的等可写事件
+    ///
+    void FlushOutput();
+
+    ///
+    /// 追加到output_buffer_之前检查是否超过高水位
+    ///
+    void CheckHighWaterMark(size_t appending);
+
+    void RemoveFromIdleList() {
+        if ( idle_list_ ) {
+            idle_list_->Remove(&idle_entry_);
+        }
+    }
+    void SetState(StateE state);
 
     const char* StateToString() const;
     void StartReadInLoop();
@@ -136,6 +270,7 @@ private:
     const string    name_;
     StateE          state_;
     bool            reading_;
+    bool            edge_triggered_;
 
     std::unique_ptr<Socket>     socket_;
     std::unique_ptr<Channel>    channel_;
@@ -143,13 +278,47 @@ private:
     const InetAddress           peer_addr_;
     ConnectionCallback          connection_callback_;
     MessageCallback             message_callback_;
+    ChainMessageCallback        chain_message_callback_;
     WriteCompleteCallback       write_complete_callback_;
     HighWaterMarkCallback       high_water_mark_callback_;
     CloseCallback               close_callback_;
     size_t                      high_water_mark_;
     Buffer                      input_buffer_;
-    Buffer                      output_buffer_;
+    ChainBuffer                 input_chain_;   // 设置了chain_message_callback_时使用
+    ChainBuffer                 output_buffer_;
+    int                         batch_depth_;   // BeginBatch()嵌套的层数
+
+    ///
+    /// 不在output_buffer_中、要按顺序发送的一段：用sendfile发送的文件，
+    /// 或者用MSG_ZEROCOPY发送的消息
+    ///
+    struct PendingSegment {
+        int                             file_fd;         // 零拷贝消息为-1
+        off_t                           offset;          // 下一个要发送的位置
+        size_t                          remaining;
+        size_t                          buffered_before; // output_buffer_中在这一段之前的字节数
+        ExternalBuffer::DoneCallback    done;
+        std::shared_ptr<const string>   message;
+    };
+    std::deque<PendingSegment>  pending_segments_; // 和output_buffer_交替发送
+    size_t                      pending_segment_bytes_;     // pending_segments_中remaining的和
+    size_t                      buffered_before_segments_;  // pending_segments_中buffered_before的和
+
+    ///
+    /// 一次MSG_ZEROCOPY的send(2)，内核通知完成之前不能释放消息
+    ///
+    struct ZeroCopySend {
+        uint32_t                        seq;
+        bool                            completed;
+        std::shared_ptr<const string>   message;
+    };
+    std::deque<ZeroCopySend>    zerocopy_sends_;    // 按序号排列
+    uint32_t                    zerocopy_next_seq_; // 内核给下一次成功的调用的序号
+    size_t                      zerocopy_threshold_; // 0表示没有开启
+    ZeroCopyStats               zerocopy_stats_;
     boost::any                  context_;
+    std::shared_ptr<IdleConnectionList> idle_list_;
+    IdleConnectionList::Entry           idle_entry_;
 };
 } // namespace net
 } // namespace dwater
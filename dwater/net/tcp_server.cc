@@ -6,6 +6,7 @@
 
 #include "dwater/net/tcp_server.h"
 
+#include "dwater/base/count_down_latch.h"
 #include "dwater/base/logging.h"
 #include "dwater/net/acceptor.h"
 #include "dwater/net/event_loop.h"
@@ -22,16 +23,24 @@ TcpServer::TcpServer(EventLoop* loop,
                      const string& name,
                      Option option) 
     : loop_(CHECK_NOTNULL(loop)),
+      listen_addr_(listen_addr),
       ip_port_(listen_addr.ToIpPort()),
       name_(name),
-      acceptor_(new Acceptor(loop, listen_addr, option == kreuser_port)),
+      option_(option),
+      acceptor_(option == kreuse_port_per_loop
+                ? NULL
+                : new Acceptor(loop, listen_addr, option == kreuser_port)),
       thread_pool_(new EventLoopThreadPool(loop, name_)),
       connection_callback_(DefaultConnectionCallback),
       message_callback_(DefaultMessageCallback),
+      edge_triggered_(false),
+      idle_timeout_(0),
       next_connid_(1) {
-          acceptor_->SetNewConnnectionCallback(
-                  std::bind(&TcpServer::NewConnection, this, _1, _2)
-                  );
+    if ( acceptor_ ) {
+        acceptor_->SetNewConnnectionCallback(
+                std::bind(&TcpServer::NewConnection, this, _1, _2)
+                );
+    }
 }
 
 TcpServer::~TcpServer() {
@@ -44,6 +53,17 @@ TcpServer::~TcpServer() {
                 std::bind(&TcpConnection::ConnectionDestroyed, conn)
                 );
     }
+    if ( !shards_.empty() ) {
+        // 连接的回调函数中有this，必须等所有IO线程清理完
+        CountDownLatch latch(static_cast<int>(shards_.size()));
+        for ( auto& shard : shards_ ) {
+            shard->loop->RunInLoop(std::bind(&TcpServer::DestroyShard, GetPointer(shard), &latch));
+        }
+        latch.Wait();
+    }
+    for ( auto& item : idle_lists_ ) {
+        item.first->RunInLoop(std::bind(&IdleConnectionList::Stop, item.second));
+    }
 }
 
 void TcpServer::SetThreadNum(int num_thread) {
@@ -55,8 +75,21 @@ void TcpServer::Start() {
     if ( started_.GetAndSet(1) == 0 ) {
         thread_pool_->Start(thread_init_callback_);
 
-        assert(!acceptor_->Listening());
-        loop_->RunInLoop(std::bind(&Acceptor::Listen, GetPointer(acceptor_)));
+        if ( idle_timeout_ > 0 ) {
+            for ( EventLoop* io_loop : thread_pool_->GetAllLoops() ) {
+                std::shared_ptr<IdleConnectionList> idle_list(
+                        new IdleConnectionList(io_loop, idle_timeout_));
+                idle_lists_[io_loop] = idle_list;
+                io_loop->RunInLoop(std::bind(&IdleConnectionList::Start, idle_list));
+            }
+        }
+
+        if ( option_ == kreuse_port_per_loop ) {
+            StartShards();
+        } else {
+            assert(!acceptor_->Listening());
+            loop_->RunInLoop(std::bind(&Acceptor::Listen, GetPointer(acceptor_)));
+        }
     }
 }
 
@@ -70,14 +103,25 @@ void TcpServer::NewConnection(int sockfd, const InetAddress& peer_addr) {
     LOG_INFO << "TcpServer::NewConnection [" << name_
              << "] - new connection [" << conn_name
              << "] from " << peer_addr.ToIpPort();
+    TcpConnectionPtr conn(CreateConnection(io_loop, conn_name, sockfd, peer_addr));
+    connections_[conn_name] = conn;
+    conn->SetCloseCallback(std::bind(&TcpServer::RemoveConnection, this, _1));
+    io_loop->RunInLoop(std::bind(&TcpConnection::ConnectionEstablished, conn));
+}
+
+TcpConnectionPtr TcpServer::CreateConnection(EventLoop* io_loop, const string& conn_name,
+                                             int sockfd, const InetAddress& peer_addr) {
     InetAddress local_addr(socket::GetLocalAddr(sockfd));
     TcpConnectionPtr conn(new TcpConnection(io_loop, conn_name, sockfd, local_addr, peer_addr));
-    connections_[conn_name] = conn;
     conn->SetConnectionCallback(connection_callback_);
     conn->SetMessageCallback(message_callback_);
+    conn->SetChainMessageCallback(chain_message_callback_);
     conn->SetWriteCompleteCallback(write_complete_callback_);
-    conn->SetCloseCallback(std::bind(&TcpServer::RemoveConnection, this, _1));
-    io_loop->RunInLoop(std::bind(&TcpConnection::ConnectionEstablished, conn));
+    conn->SetEdgeTriggered(edge_triggered_);
+    if ( idle_timeout_ > 0 ) {
+        conn->SetIdleConnectionList(idle_lists_.find(io_loop)->second);
+    }
+    return conn;
 }
 
 void TcpServer::RemoveConnection(const TcpConnectionPtr& conn) {
@@ -94,3 +138,59 @@ void TcpServer::RemoveConenctionInLoop(const TcpConnectionPtr& conn) {
     EventLoop* io_loop = conn->GetLoop();
     io_loop->QueueInLoop(std::bind(&TcpConnection::ConnectionDestroyed, conn));
 }
+
+///
+/// 每个IO线程一个绑定同一个地址的SO_REUSEPORT socket，由内核分配新连接，
+/// accept和建立TcpConnection都在这个线程中完成，不需要跨线程唤醒
+///
+void TcpServer::StartShards() {
+    std::vector<EventLoop*> loops = thread_pool_->GetAllLoops();
+    for ( size_t i = 0; i < loops.size(); ++i ) {
+        std::unique_ptr<LoopShard> shard(new LoopShard);
+        shard->loop = loops[i];
+        shard->index = static_cast<int>(i);
+        shard->acceptor.reset(new Acceptor(loops[i], listen_addr_, true));
+        shard->acceptor->SetNewConnnectionCallback(
+                std::bind(&TcpServer::NewConnectionInShard, this, GetPointer(shard), _1, _2));
+        shard->next_connid = 1;
+        loops[i]->RunInLoop(std::bind(&Acceptor::Listen, GetPointer(shard->acceptor)));
+        shards_.push_back(std::move(shard));
+    }
+}
+
+void TcpServer::NewConnectionInShard(LoopShard* shard, int sockfd, const InetAddress& peer_addr) {
+    shard->loop->AssertInLoopThread();
+    char buf[64];
+    snprintf(buf, sizeof(buf), "-%s#%d-%d", ip_port_.c_str(), shard->index, shard->next_connid);
+    ++shard->next_connid;
+    string conn_name = name_ + buf;
+    LOG_INFO << "TcpServer::NewConnectionInShard [" << name_
+             << "] - new connection [" << conn_name
+             << "] from " << peer_addr.ToIpPort();
+    TcpConnectionPtr conn(CreateConnection(shard->loop, conn_name, sockfd, peer_addr));
+    shard->connections[conn_name] = conn;
+    conn->SetCloseCallback(std::bind(&TcpServer::RemoveConnectionInShard, this, shard, _1));
+    conn->ConnectionEstablished();
+}
+
+void TcpServer::RemoveConnectionInShard(LoopShard* shard, const TcpConnectionPtr& conn) {
+    shard->loop->AssertInLoopThread();
+    LOG_INFO << "TcpServer::RemoveConnectionInShard [" << name_
+             << "] - connection " << conn->Name();
+    size_t n = shard->connections.erase(conn->Name());
+    (void)n;
+    assert(n == 1);
+    shard->loop->QueueInLoop(std::bind(&TcpConnection::ConnectionDestroyed, conn));
+}
+
+void TcpServer::DestroyShard(LoopShard* shard, CountDownLatch* latch) {
+    shard->loop->AssertInLoopThread();
+    shard->acceptor.reset();
+    for ( auto& item : shard->connections ) {
+        TcpConnectionPtr conn(item.second);
+        item.second.reset();
+        conn->ConnectionDestroyed();
+    }
+    shard->connections.clear();
+    latch->CountDown();
+}
@@ -12,9 +12,12 @@
 #include "dwater/base/types.h"
 
 #include <map>
+#include <vector>
 
 namespace dwater {
 
+class CountDownLatch;
+
 namespace net {
 
 class Acceptor;
@@ -30,6 +33,7 @@ public:
     enum Option {
         kno_reuse_port,
         kreuser_port,
+        kreuse_port_per_loop, // 每个IO线程一个SO_REUSEPORT的Acceptor，在本线程建立连接
     };
 
     TcpServer(EventLoop* loop,
@@ -65,9 +69,33 @@ public:
         message_callback_ = cb;
     }
 
+    ///
+    /// 连接的数据读到ChainBuffer中，见TcpConnection::SetChainMessageCallback()
+    ///
+    void SetChainMessageCallback(const ChainMessageCallback& cb) {
+        chain_message_callback_ = cb;
+    }
+
     void SetWriteCompleteCallback(const WriteCompleteCallback& cb) {
         write_complete_callback_ = cb;
     }
+
+    ///
+    /// 新建立的连接使用边缘触发，必须在Start()之前调用
+    ///
+    void SetEdgeTriggered(bool on) {
+        edge_triggered_ = on;
+    }
+
+    ///
+    /// 超过 @c seconds 秒没有读写的连接会被强制关闭，0表示不关闭，
+    /// 必须在Start()之前调用
+    ///
+    /// 每个IO线程只有一个每秒触发的定时器，不需要每个连接一个定时器
+    void SetIdleTimeout(int seconds) {
+        assert(seconds >= 0);
+        idle_timeout_ = seconds;
+    }
 private:
     void NewConnection(int sockfd, const InetAddress& peer_addr);
 
@@ -75,20 +103,50 @@ private:
     void RemoveConenctionInLoop(const TcpConnectionPtr& conn);
 
     typedef std::map<string, TcpConnectionPtr> ConnectionMap;
+    typedef std::map<EventLoop*, std::shared_ptr<IdleConnectionList>> IdleListMap;
+
+    ///
+    /// kreuse_port_per_loop模式下每个IO线程的Acceptor和连接，只在这个线程中访问
+    ///
+    struct LoopShard {
+        EventLoop*                  loop;
+        int                         index;
+        std::unique_ptr<Acceptor>   acceptor;
+        int                         next_connid;
+        ConnectionMap               connections;
+    };
+
+    void StartShards();
+    void NewConnectionInShard(LoopShard* shard, int sockfd, const InetAddress& peer_addr);
+    void RemoveConnectionInShard(LoopShard* shard, const TcpConnectionPtr& conn);
+    static void DestroyShard(LoopShard* shard, CountDownLatch* latch);
+
+    ///
+    /// 新建连接，设置好回调函数
+    ///
+    TcpConnectionPtr CreateConnection(EventLoop* io_loop, const string& conn_name,
+                                      int sockfd, const InetAddress& peer_addr);
 
     EventLoop*                              loop_;
+    const InetAddress                       listen_addr_;
     const string                            ip_port_;
     const string                            name_;
-    std::unique_ptr<Acceptor>               acceptor_;
+    const Option                            option_;
+    std::unique_ptr<Acceptor>               acceptor_; // kreuse_port_per_loop模式下为空
     std::shared_ptr<EventLoopThreadPool>    thread_pool_;
     ConnectionCallback                      connection_callback_;
     MessageCallback                         message_callback_;
+    ChainMessageCallback                    chain_message_callback_;
     WriteCompleteCallback                   write_complete_callback_;
     ThreadInitCallback                      thread_init_callback_;
     AtomicInt32                             started_;
+    bool                                    edge_triggered_;
+    int                                     idle_timeout_;
+    IdleListMap                             idle_lists_; // 每个IO线程一个
 
     int                                     next_connid_;
     ConnectionMap                           connections_;
+    std::vector<std::unique_ptr<LoopShard>> shards_;
 };
 
 } // namespace 
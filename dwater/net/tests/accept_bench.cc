@@ -0,0 +1,96 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.15
+// Filename:        accept_bench.cc
+// Descripton:      短连接的建立速度，比较单个Acceptor和每个IO线程一个SO_REUSEPORT
+// Acceptor两种模式
+//
+// usage: accept_bench [io_threads] [client_threads] [connections_per_client]
+
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_io_threads = 4;
+int g_client_threads = 8;
+int g_connections = 2000;
+
+///
+/// 连接建立之后马上发一个字节并关闭写端
+///
+void OnConnection(const TcpConnectionPtr& conn) {
+    if ( conn->Connected() ) {
+        conn->Send("x", 1);
+        conn->Shutdown();
+    }
+}
+
+void Client(uint16_t port) {
+    InetAddress addr("127.0.0.1", port);
+    for ( int i = 0; i < g_connections; ++i ) {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+            LOG_SYSFATAL << "connect";
+        }
+        char buf[16];
+        while ( ::read(sockfd, buf, sizeof(buf)) > 0 ) {
+        }
+        ::close(sockfd);
+    }
+}
+
+void RunClients(EventLoop* loop, uint16_t port, TcpServer::Option option) {
+    std::vector<std::unique_ptr<Thread>> threads;
+    Timestamp start(Timestamp::Now());
+    for ( int i = 0; i < g_client_threads; ++i ) {
+        threads.emplace_back(new Thread(std::bind(Client, port), "client"));
+        threads.back()->Start();
+    }
+    for ( auto& thr : threads ) {
+        thr->Join();
+    }
+    double seconds = TimeDifference(Timestamp::Now(), start);
+    int total = g_client_threads * g_connections;
+    printf("%s: %d connections in %.2f seconds, %.0f connections/s, base loop wakeups %lld\n",
+           option == TcpServer::kreuse_port_per_loop ? "acceptor per loop" : "single acceptor ",
+           total, seconds, total / seconds,
+           static_cast<long long>(loop->Iteration()));
+    loop->Quit();
+}
+
+void Bench(TcpServer::Option option, uint16_t port) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "AcceptBench", option);
+    server.SetConnectionCallback(OnConnection);
+    server.SetThreadNum(g_io_threads);
+    server.Start();
+
+    Thread clients(std::bind(RunClients, &loop, port, option), "clients");
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_io_threads = atoi(argv[1]);
+    if ( argc > 2 ) g_client_threads = atoi(argv[2]);
+    if ( argc > 3 ) g_connections = atoi(argv[3]);
+
+    Logger::SetLogLevel(Logger::WARN);
+    printf("io threads = %d, client threads = %d, connections per client = %d\n",
+           g_io_threads, g_client_threads, g_connections);
+    Bench(TcpServer::kno_reuse_port, 9981);
+    Bench(TcpServer::kreuse_port_per_loop, 9982);
+}
@@ -0,0 +1,144 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.16
+// Filename:        buffer_pool_bench.cc
+// Descripton:      大量空闲连接加少量活跃连接时，每个IO线程BufferBlockPool的命中率
+// 和占用的内存
+//
+// 每个连接先收发一次 @c msg_size 字节，然后大部分连接保持空闲，只有 @c active 个连接
+// 继续收发数据。空闲连接不持有缓冲区，所以内存只和活跃连接的数据量有关
+//
+// usage: buffer_pool_bench [io_threads] [connections] [active] [msg_size]
+
+#include "dwater/base/count_down_latch.h"
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/buffer_block_pool.h"
+#include "dwater/net/chain_buffer.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/event_loop_thread_pool.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_io_threads = 4;
+int g_connections = 5000;
+int g_active = 50;
+int g_msg_size = 32 * 1024;
+const int kround = 200;
+
+void OnMessage(const TcpConnectionPtr& conn, ChainBuffer* buf, Timestamp) {
+    conn->Send(buf);
+}
+
+int ConnectTo(uint16_t port) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr("127.0.0.1", port);
+    if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+        LOG_SYSFATAL << "connect";
+    }
+    return sockfd;
+}
+
+void PingPong(int sockfd, const string& msg) {
+    if ( ::write(sockfd, msg.data(), msg.size()) != static_cast<ssize_t>(msg.size()) ) {
+        LOG_SYSFATAL << "write";
+    }
+    char buf[64 * 1024];
+    size_t received = 0;
+    while ( received < msg.size() ) {
+        ssize_t n = ::read(sockfd, buf, sizeof(buf));
+        if ( n <= 0 ) {
+            LOG_SYSFATAL << "read";
+        }
+        received += n;
+    }
+}
+
+void CollectStats(EventLoop* loop, BufferBlockPool::Stats* stats, CountDownLatch* latch) {
+    *stats = loop->BlockPool()->GetStats();
+    latch->CountDown();
+}
+
+void PrintStats(const std::vector<EventLoop*>& loops, const char* phase) {
+    std::vector<BufferBlockPool::Stats> stats(loops.size());
+    CountDownLatch latch(static_cast<int>(loops.size()));
+    for ( size_t i = 0; i < loops.size(); ++i ) {
+        loops[i]->RunInLoop(std::bind(CollectStats, loops[i], &stats[i], &latch));
+    }
+    latch.Wait();
+    printf("%s\n", phase);
+    size_t total = 0;
+    for ( size_t i = 0; i < loops.size(); ++i ) {
+        printf("  loop %zu: %5d conns  acquires %8ld  hit rate %5.1f%%  "
+               "in use %4zu  free %4zu  held %7.1f KB\n",
+               i, loops[i]->ConnectionCount(), stats[i].acquires, stats[i].HitRate() * 100,
+               stats[i].in_use_blocks, stats[i].free_blocks, stats[i].MemoryHeld() / 1024.0);
+        total += stats[i].MemoryHeld();
+    }
+    printf("  total held %.1f KB, %.1f bytes per connection\n",
+           total / 1024.0, static_cast<double>(total) / g_connections);
+}
+
+void RunClients(EventLoop* loop, const std::vector<EventLoop*>& loops, uint16_t port) {
+    const string msg(g_msg_size, 'x');
+    std::vector<int> fds;
+    for ( int i = 0; i < g_connections; ++i ) {
+        fds.push_back(ConnectTo(port));
+        PingPong(fds.back(), msg);
+    }
+    PrintStats(loops, "after one round trip on every connection (all idle now):");
+
+    Timestamp start(Timestamp::Now());
+    for ( int round = 0; round < kround; ++round ) {
+        for ( int i = 0; i < g_active; ++i ) {
+            PingPong(fds[i], msg);
+        }
+    }
+    double seconds = TimeDifference(Timestamp::Now(), start);
+    char phase[128];
+    snprintf(phase, sizeof(phase), "after %d rounds on %d active connections (%.1f MiB/s):",
+             kround, g_active,
+             2.0 * kround * g_active * g_msg_size / seconds / 1024 / 1024);
+    PrintStats(loops, phase);
+
+    for ( int fd : fds ) {
+        ::close(fd);
+    }
+    loop->RunInLoop(std::bind(&EventLoop::Quit, loop));
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_io_threads = atoi(argv[1]);
+    if ( argc > 2 ) g_connections = atoi(argv[2]);
+    if ( argc > 3 ) g_active = atoi(argv[3]);
+    if ( argc > 4 ) g_msg_size = atoi(argv[4]);
+
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+
+    Logger::SetLogLevel(Logger::WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(9981), "BufferPoolBench");
+    server.SetChainMessageCallback(OnMessage);
+    server.SetThreadNum(g_io_threads);
+    server.Start();
+
+    std::vector<EventLoop*> loops = server.ThreadPool()->GetAllLoops();
+    Thread clients(std::bind(RunClients, &loop, loops, 9981), "clients");
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+}
@@ -0,0 +1,180 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.16
+// Filename:        chain_buffer_test.cc
+// Descripton:
+
+#include "dwater/net/chain_buffer.h"
+#include "dwater/net/buffer_block_pool.h"
+#include "dwater/base/thread.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using dwater::string;
+using dwater::net::BufferBlock;
+using dwater::net::BufferBlockPool;
+using dwater::net::ChainBuffer;
+
+BOOST_AUTO_TEST_CASE(testChainBufferAppendRetrieve)
+{
+  ChainBuffer buf;
+  BOOST_CHECK_EQUAL(buf.ReadableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.SliceCount(), 0);
+
+  const string str(200, 'x');
+  buf.Append(str);
+  buf.Append(str);
+  BOOST_CHECK_EQUAL(buf.ReadableBytes(), 2*str.size());
+  BOOST_CHECK_EQUAL(buf.SliceCount(), 1); // 连续写入同一个块，合并成一个slice
+
+  const string str2 = buf.RetrieveAsString(50);
+  BOOST_CHECK_EQUAL(str2, string(50, 'x'));
+  BOOST_CHECK_EQUAL(buf.ReadableBytes(), 350);
+
+  buf.RetrieveAll();
+  BOOST_CHECK_EQUAL(buf.ReadableBytes(), 0);
+  BOOST_CHECK_EQUAL(buf.SliceCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferCrossBlocks)
+{
+  ChainBuffer buf;
+  string str;
+  for ( size_t i = 0; i < 3*BufferBlock::ksize; ++i ) {
+    str.push_back(static_cast<char>('a' + i % 26));
+  }
+  buf.Append(str);
+  BOOST_CHECK_EQUAL(buf.ReadableBytes(), str.size());
+  BOOST_CHECK_EQUAL(buf.SliceCount(), 3);
+  BOOST_CHECK_EQUAL(buf.FirstSlice().Size(), BufferBlock::ksize);
+
+  buf.Retrieve(BufferBlock::ksize + 10);
+  BOOST_CHECK_EQUAL(buf.SliceCount(), 2);
+  BOOST_CHECK_EQUAL(buf.RetrieveAllAsString(), str.substr(BufferBlock::ksize + 10));
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferMove)
+{
+  ChainBuffer input;
+  ChainBuffer output;
+  input.Append(string(100, 'a'));
+  input.Append(string(100, 'b'));
+
+  output.Append(&input, 150); // 边界上的slice被拆开
+  BOOST_CHECK_EQUAL(input.ReadableBytes(), 50);
+  BOOST_CHECK_EQUAL(output.ReadableBytes(), 150);
+
+  input.Append(string(10, 'c')); // input继续往自己的块里写，不影响output
+  output.Append(string(10, 'd'));
+  BOOST_CHECK_EQUAL(output.RetrieveAllAsString(),
+                    string(100, 'a') + string(50, 'b') + string(10, 'd'));
+
+  output.Append(&input);
+  BOOST_CHECK_EQUAL(input.ReadableBytes(), 0);
+  BOOST_CHECK_EQUAL(output.RetrieveAllAsString(), string(50, 'b') + string(10, 'c'));
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferReadWriteFd)
+{
+  int fds[2];
+  BOOST_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  int sndbuf = 1024 * 1024;
+  ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  ChainBuffer out;
+  const string str(40000, 'z');
+  out.Append(str);
+  int saved_errno = 0;
+  ssize_t n = out.WriteFd(fds[0], &saved_errno);
+  BOOST_CHECK_EQUAL(n, static_cast<ssize_t>(str.size()));
+  BOOST_CHECK_EQUAL(out.ReadableBytes(), 0);
+
+  ChainBuffer in;
+  size_t total = 0;
+  while ( total < str.size() ) {
+    n = in.ReadFd(fds[1], &saved_errno);
+    BOOST_REQUIRE(n > 0);
+    total += n;
+  }
+  BOOST_CHECK_EQUAL(in.RetrieveAllAsString(), str);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(testBufferBlockPoolReuse)
+{
+  BufferBlockPool* pool = new BufferBlockPool;
+  {
+    ChainBuffer buf;
+    buf.SetBlockPool(pool);
+    buf.Append(string(100, 'a'));
+    BOOST_CHECK_EQUAL(pool->GetStats().in_use_blocks, 1);
+    buf.RetrieveAll(); // 空的ChainBuffer不占用块
+    BOOST_CHECK_EQUAL(pool->GetStats().in_use_blocks, 0);
+    BOOST_CHECK_EQUAL(pool->GetStats().free_blocks, 1);
+
+    buf.Append(string(100, 'b'));
+    BufferBlockPool::Stats stats = pool->GetStats();
+    BOOST_CHECK_EQUAL(stats.acquires, 2);
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.free_blocks, 0);
+  }
+  BOOST_CHECK_EQUAL(pool->GetStats().in_use_blocks, 0);
+  pool->Close();
+}
+
+BOOST_AUTO_TEST_CASE(testBufferBlockPoolRemoteRelease)
+{
+  BufferBlockPool* pool = new BufferBlockPool;
+  ChainBuffer buf;
+  buf.SetBlockPool(pool);
+  buf.Append(string(3*BufferBlock::ksize, 'x'));
+  BOOST_CHECK_EQUAL(pool->GetStats().in_use_blocks, 3);
+
+  // 在别的线程释放，下一次分配的时候取回来
+  ChainBuffer* moved = new ChainBuffer;
+  moved->Append(&buf);
+  dwater::Thread thread([moved] { delete moved; });
+  thread.Start();
+  thread.Join();
+  BOOST_CHECK_EQUAL(pool->GetStats().in_use_blocks, 0);
+  BOOST_CHECK_EQUAL(pool->GetStats().free_blocks, 0);
+
+  buf.Append(string(10, 'y'));
+  BOOST_CHECK_EQUAL(pool->GetStats().hits, 1);
+  BOOST_CHECK_EQUAL(pool->GetStats().free_blocks, 2);
+
+  // 关闭之后还在外面的块释放时直接删除，最后一个块释放的时候删除池
+  pool->Close();
+  buf.RetrieveAll();
+}
+
+BOOST_AUTO_TEST_CASE(testChainBufferAppendExternal)
+{
+  const string body(1000, 'e');
+  int done = 0;
+  ChainBuffer buf;
+  buf.Append(string("header"));
+  buf.AppendExternal(body.data(), body.size(), [&done] { ++done; });
+  buf.Append(string("tail"));
+  BOOST_CHECK_EQUAL(buf.SliceCount(), 3);
+  BOOST_CHECK_EQUAL(buf.FirstSlice().Size(), 6);
+
+  ChainBuffer other;
+  other.Append(&buf, 10); // 被拆开的slice两边都引用用户的内存
+  BOOST_CHECK_EQUAL(done, 0);
+  buf.Retrieve(buf.ReadableBytes() - 4);
+  BOOST_CHECK_EQUAL(done, 0);
+  BOOST_CHECK_EQUAL(other.RetrieveAllAsString(), "header" + string(4, 'e'));
+  BOOST_CHECK_EQUAL(done, 1); // 最后一个引用释放的时候调用
+  BOOST_CHECK_EQUAL(buf.RetrieveAllAsString(), "tail");
+
+  buf.AppendExternal(body.data(), 0, [&done] { ++done; });
+  BOOST_CHECK_EQUAL(done, 2);
+  BOOST_CHECK_EQUAL(buf.ReadableBytes(), 0);
+}
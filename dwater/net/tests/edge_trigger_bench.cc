@@ -0,0 +1,133 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.12
+// Filename:        edge_trigger_bench.cc
+// Descripton:      比较水平触发和边缘触发下每个请求唤醒EventLoop的次数
+//
+// usage: edge_trigger_bench [idle_conns] [active_conns] [requests] [message_size]
+
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <vector>
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_idle_conns = 500;
+int g_active_conns = 8;
+int g_requests = 200;
+size_t g_message_size = 256 * 1024;
+
+void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    // 收到一个完整的请求之后原样返回
+    while ( buf->ReadableBytes() >= g_message_size ) {
+        conn->Send(buf->Peek(), static_cast<int>(g_message_size));
+        buf->Retrieve(g_message_size);
+    }
+}
+
+int ConnectTo(uint16_t port) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr("127.0.0.1", port);
+    if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+        LOG_SYSFATAL << "connect";
+    }
+    return sockfd;
+}
+
+void ActiveClient(uint16_t port) {
+    int sockfd = ConnectTo(port);
+    std::vector<char> message(g_message_size, 'x');
+    std::vector<char> reply(g_message_size);
+    for ( int i = 0; i < g_requests; ++i ) {
+        size_t sent = 0;
+        while ( sent < g_message_size ) {
+            ssize_t n = ::write(sockfd, &message[sent], g_message_size - sent);
+            if ( n <= 0 ) {
+                LOG_SYSFATAL << "write";
+            }
+            sent += n;
+        }
+        size_t received = 0;
+        while ( received < g_message_size ) {
+            ssize_t n = ::read(sockfd, &reply[received], g_message_size - received);
+            if ( n <= 0 ) {
+                LOG_SYSFATAL << "read";
+            }
+            received += n;
+        }
+    }
+    ::close(sockfd);
+}
+
+void RunClients(EventLoop* loop, uint16_t port) {
+    std::vector<int> idle;
+    for ( int i = 0; i < g_idle_conns; ++i ) {
+        idle.push_back(ConnectTo(port));
+    }
+    std::vector<std::unique_ptr<Thread>> threads;
+    for ( int i = 0; i < g_active_conns; ++i ) {
+        threads.emplace_back(new Thread(std::bind(ActiveClient, port), "active"));
+        threads.back()->Start();
+    }
+    for ( auto& thr : threads ) {
+        thr->Join();
+    }
+    for ( int fd : idle ) {
+        ::close(fd);
+    }
+    loop->Quit();
+}
+
+void Bench(bool edge_triggered, uint16_t port) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "EdgeTriggerBench");
+    server.SetMessageCallback(OnMessage);
+    server.SetEdgeTriggered(edge_triggered);
+    server.Start();
+
+    Thread clients(std::bind(RunClients, &loop, port), "clients");
+    Timestamp start(Timestamp::Now());
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+    double seconds = TimeDifference(Timestamp::Now(), start);
+
+    int64_t requests = static_cast<int64_t>(g_active_conns) * g_requests;
+    printf("%s: %lld wakeups for %lld requests, %.2f wakeups/request, %.0f requests/s\n",
+           edge_triggered ? "ET" : "LT",
+           static_cast<long long>(loop.Iteration()),
+           static_cast<long long>(requests),
+           static_cast<double>(loop.Iteration()) / static_cast<double>(requests),
+           static_cast<double>(requests) / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_idle_conns = atoi(argv[1]);
+    if ( argc > 2 ) g_active_conns = atoi(argv[2]);
+    if ( argc > 3 ) g_requests = atoi(argv[3]);
+    if ( argc > 4 ) g_message_size = atol(argv[4]);
+
+    // 每个空闲连接在同一个进程中占用两个fd
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+
+    Logger::SetLogLevel(Logger::WARN);
+    printf("idle = %d, active = %d, requests = %d, message size = %zd\n",
+           g_idle_conns, g_active_conns, g_requests, g_message_size);
+    Bench(false, 9981);
+    Bench(true, 9982);
+}
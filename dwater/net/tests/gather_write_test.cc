@@ -0,0 +1,112 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        gather_write_test.cc
+// Descripton:      MessageCallback中分开发送的头部和用户内存中的body合并成一次writev，
+// body写完之后调用完成回调；回调中Shutdown()也要等batch中的数据写完
+//
+// usage: gather_write_test [requests]
+
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <atomic>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_requests = 10000;
+const string g_body(20000, 'b'); // 用户自己的内存，不拷贝
+std::atomic<int> g_done(0);
+
+void OnDone() {
+    ++g_done;
+}
+
+///
+/// 每一行是一个请求，"quit"之后关闭连接
+///
+void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    const char* eol;
+    while ( (eol = buf->FindEOL()) != NULL ) {
+        string line(buf->Peek(), eol);
+        buf->RetrieveUntil(eol + 1);
+        char header[64];
+        snprintf(header, sizeof(header), "%s %zu\n", line.c_str(), g_body.size());
+        conn->Send(header);
+        conn->SendExternal(g_body.data(), g_body.size(), OnDone);
+        conn->Send("\n", 1);
+        if ( line == "quit" ) {
+            conn->Shutdown();
+        }
+    }
+}
+
+void RunClient(EventLoop* loop, uint16_t port) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr("127.0.0.1", port);
+    if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+        LOG_SYSFATAL << "connect";
+    }
+    Timestamp start(Timestamp::Now());
+    string requests;
+    for ( int i = 0; i < g_requests; ++i ) {
+        requests += "req\n";
+    }
+    requests += "quit\n";
+    size_t expected = 0;
+    for ( int i = 0; i < g_requests; ++i ) {
+        expected += snprintf(NULL, 0, "req %zu\n", g_body.size()) + g_body.size() + 1;
+    }
+    expected += snprintf(NULL, 0, "quit %zu\n", g_body.size()) + g_body.size() + 1;
+
+    size_t written = 0;
+    size_t received = 0;
+    char buf[64 * 1024];
+    // 请求一点一点地写，读到对方关闭为止
+    while ( true ) {
+        if ( written < requests.size() ) {
+            size_t len = std::min(requests.size() - written, static_cast<size_t>(400));
+            ssize_t n = ::write(sockfd, requests.data() + written, len);
+            if ( n > 0 ) {
+                written += n;
+            }
+        }
+        ssize_t n = ::read(sockfd, buf, sizeof(buf));
+        if ( n <= 0 ) {
+            break;
+        }
+        received += n;
+    }
+    double seconds = TimeDifference(Timestamp::Now(), start);
+    printf("received %zu bytes (expected %zu) %s, %.1f MiB/s\n",
+           received, expected, received == expected ? "OK" : "WRONG",
+           received / seconds / 1024 / 1024);
+    ::close(sockfd);
+    loop->RunInLoop(std::bind(&EventLoop::Quit, loop));
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_requests = atoi(argv[1]);
+
+    Logger::SetLogLevel(Logger::WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(9981), "GatherWriteTest");
+    server.SetMessageCallback(OnMessage);
+    server.Start();
+
+    Thread client(std::bind(RunClient, &loop, 9981), "client");
+    client.Start();
+    loop.Loop();
+    client.Join();
+    printf("done callbacks %d/%d %s\n", g_done.load(), g_requests + 1,
+           g_done.load() == g_requests + 1 ? "OK" : "WRONG");
+}
@@ -0,0 +1,104 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.15
+// Filename:        idle_timeout_test.cc
+// Descripton:      TcpServer::SetIdleTimeout()，空闲的连接被关闭，一直有数据的连接保持
+//
+// usage: idle_timeout_test [idle_conns] [timeout_seconds]
+
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <vector>
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_idle_conns = 1000;
+int g_timeout = 2;
+
+void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->Send(buf);
+}
+
+int ConnectTo(uint16_t port) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr("127.0.0.1", port);
+    if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+        LOG_SYSFATAL << "connect";
+    }
+    return sockfd;
+}
+
+bool Closed(int sockfd) {
+    struct pollfd pfd = { sockfd, POLLIN, 0 };
+    char buf[64];
+    return ::poll(&pfd, 1, 0) == 1 && ::read(sockfd, buf, sizeof(buf)) == 0;
+}
+
+void RunClients(EventLoop* loop, uint16_t port) {
+    std::vector<int> idle;
+    for ( int i = 0; i < g_idle_conns; ++i ) {
+        idle.push_back(ConnectTo(port));
+    }
+    int active = ConnectTo(port);
+    Timestamp start(Timestamp::Now());
+    int closed = 0;
+    bool active_closed = false;
+    // 活跃连接每200ms发一次数据，持续到超时时间的两倍
+    while ( TimeDifference(Timestamp::Now(), start) < g_timeout * 2 + 1 ) {
+        char buf[64];
+        if ( ::write(active, "ping", 4) != 4 || ::read(active, buf, sizeof(buf)) <= 0 ) {
+            active_closed = true;
+            break;
+        }
+        ::usleep(200 * 1000);
+        for ( int& fd : idle ) {
+            if ( fd >= 0 && Closed(fd) ) {
+                ::close(fd);
+                fd = -1;
+                if ( ++closed == g_idle_conns ) {
+                    printf("all %d idle connections closed after %.2f seconds\n",
+                           closed, TimeDifference(Timestamp::Now(), start));
+                }
+            }
+        }
+    }
+    printf("idle closed %d/%d, active connection %s\n",
+           closed, g_idle_conns, active_closed ? "CLOSED (wrong)" : "alive");
+    ::close(active);
+    loop->Quit();
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_idle_conns = atoi(argv[1]);
+    if ( argc > 2 ) g_timeout = atoi(argv[2]);
+
+    struct rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+
+    Logger::SetLogLevel(Logger::WARN);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(9981), "IdleTimeoutTest");
+    server.SetMessageCallback(OnMessage);
+    server.SetIdleTimeout(g_timeout);
+    server.SetThreadNum(2);
+    server.Start();
+
+    Thread clients(std::bind(RunClients, &loop, 9981), "clients");
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+}
@@ -0,0 +1,101 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.15
+// Filename:        loop_selection_bench.cc
+// Descripton:      长连接和短连接混合的时候，不同的EventLoopThreadPool选择策略下每个
+// IO线程的连接数
+//
+// 每4个连接中有1个是长连接，round-robin会把所有长连接放到同一个线程中
+//
+// usage: loop_selection_bench [io_threads] [connections]
+
+#include "dwater/base/logging.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/event_loop_thread_pool.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_io_threads = 4;
+int g_connections = 2000;
+
+void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->Send(buf);
+}
+
+void PrintLoads(TcpServer* server, const char* name) {
+    std::vector<EventLoopThreadPool::LoopLoad> loads = server->ThreadPool()->GetLoads();
+    int min_conns = loads[0].connections;
+    int max_conns = loads[0].connections;
+    printf("%-22s connections per loop:", name);
+    for ( const auto& load : loads ) {
+        printf(" %4d", load.connections);
+        min_conns = std::min(min_conns, load.connections);
+        max_conns = std::max(max_conns, load.connections);
+    }
+    printf("  (max - min = %d)\n", max_conns - min_conns);
+}
+
+void RunClients(EventLoop* loop, TcpServer* server, uint16_t port, const char* name) {
+    InetAddress addr("127.0.0.1", port);
+    std::vector<int> long_lived;
+    for ( int i = 0; i < g_connections; ++i ) {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+            LOG_SYSFATAL << "connect";
+        }
+        // 一次请求应答，保证服务端已经建立了连接
+        char buf[8];
+        if ( ::write(sockfd, "ping", 4) != 4 || ::read(sockfd, buf, sizeof(buf)) <= 0 ) {
+            LOG_SYSFATAL << "ping";
+        }
+        if ( i % 4 == 0 ) {
+            long_lived.push_back(sockfd);
+        } else {
+            ::close(sockfd);
+        }
+    }
+    ::usleep(200 * 1000); // 等服务端关闭短连接
+    loop->RunInLoop(std::bind(PrintLoads, server, name));
+    loop->RunInLoop(std::bind(&EventLoop::Quit, loop));
+    ::usleep(100 * 1000);
+    for ( int fd : long_lived ) {
+        ::close(fd);
+    }
+}
+
+void Bench(EventLoopThreadPool::LoopSelection selection, const char* name, uint16_t port) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "LoopSelectionBench");
+    server.SetMessageCallback(OnMessage);
+    server.SetThreadNum(g_io_threads);
+    server.ThreadPool()->SetLoopSelection(selection);
+    server.Start();
+
+    Thread clients(std::bind(RunClients, &loop, &server, port, name), "clients");
+    clients.Start();
+    loop.Loop();
+    clients.Join();
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_io_threads = atoi(argv[1]);
+    if ( argc > 2 ) g_connections = atoi(argv[2]);
+
+    Logger::SetLogLevel(Logger::WARN);
+    Bench(EventLoopThreadPool::kround_robin, "round robin", 9981);
+    Bench(EventLoopThreadPool::kleast_connections, "least connections", 9982);
+    Bench(EventLoopThreadPool::kleast_queue_size, "least queue size", 9983);
+    Bench(EventLoopThreadPool::kpower_of_two_choices, "power of two choices", 9984);
+}
@@ -0,0 +1,72 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.13
+// Filename:        run_in_loop_bench.cc
+// Descripton:      多个线程同时往一个EventLoop中RunInLoop，测试跨线程调用的吞吐量
+//
+// usage: run_in_loop_bench [calls_per_producer]
+
+#include "dwater/base/count_down_latch.h"
+#include "dwater/base/thread.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/event_loop_thread.h"
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int64_t g_counter = 0; // 只在IO线程中修改
+
+void Increment(CountDownLatch* done, int64_t total) {
+    if ( ++g_counter == total ) {
+        done->CountDown();
+    }
+}
+
+void Produce(EventLoop* loop, CountDownLatch* start, CountDownLatch* done,
+             int calls, int64_t total) {
+    start->Wait();
+    for ( int i = 0; i < calls; ++i ) {
+        loop->RunInLoop(std::bind(Increment, done, total));
+    }
+}
+
+void Bench(EventLoop* loop, int producers, int calls) {
+    g_counter = 0;
+    int64_t total = static_cast<int64_t>(producers) * calls;
+    CountDownLatch start(1);
+    CountDownLatch done(1);
+    int64_t iterations = loop->Iteration();
+
+    std::vector<std::unique_ptr<Thread>> threads;
+    for ( int i = 0; i < producers; ++i ) {
+        threads.emplace_back(new Thread(
+                    std::bind(Produce, loop, &start, &done, calls, total), "producer"));
+        threads.back()->Start();
+    }
+    Timestamp begin(Timestamp::Now());
+    start.CountDown();
+    done.Wait();
+    double seconds = TimeDifference(Timestamp::Now(), begin);
+    for ( auto& thr : threads ) {
+        thr->Join();
+    }
+    // Iteration()在IO线程中修改，这里只是一个近似值
+    printf("%2d producers: %10.0f calls/s, %8lld loop wakeups\n",
+           producers,
+           static_cast<double>(total) / seconds,
+           static_cast<long long>(loop->Iteration() - iterations));
+}
+
+int main(int argc, char* argv[]) {
+    int calls = argc > 1 ? atoi(argv[1]) : 200 * 1000;
+    EventLoopThread loop_thread;
+    EventLoop* loop = loop_thread.StartLoop();
+    for ( int producers = 1; producers <= 32; producers *= 2 ) {
+        Bench(loop, producers, calls);
+    }
+}
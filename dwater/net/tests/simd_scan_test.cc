@@ -0,0 +1,113 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        simd_scan_test.cc
+// Descripton:
+
+#include "dwater/net/simd_scan.h"
+#include "dwater/base/types.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+
+using dwater::string;
+using namespace dwater::net;
+
+namespace {
+
+const scan::Level kall_levels[] = { scan::kscalar, scan::ksse2, scan::kavx2 };
+
+/// 随机的头部，分隔符和\r\n比较多，覆盖块的边界
+string RandomLine(int len) {
+  const char chars[] = "abcdefghij-: \r\n(";
+  string line;
+  for (int i = 0; i < len; ++i)
+    line += chars[::rand() % (sizeof(chars) - 1)];
+  return line;
+}
+
+bool SameScan(const scan::LineScan& a, const scan::LineScan& b) {
+  return a.crlf == b.crlf && a.first == b.first && a.last == b.last &&
+         a.count == b.count && a.token == b.token;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testScanLine)
+{
+  string line = "Content-Type: text/html\r\nHost: a\r\n";
+  for (scan::Level level : kall_levels)
+  {
+    if (!scan::SetLevel(level))
+      continue;
+    scan::LineScan result;
+    scan::ScanLine(line.data(), line.data() + line.size(), ':', &result);
+    BOOST_CHECK(result.crlf == line.data() + 23);
+    BOOST_CHECK(result.first == line.data() + 12);
+    BOOST_CHECK_EQUAL(result.count, 1);
+    BOOST_CHECK(result.token);
+
+    string bad = "Bad Field: x\r\n";
+    scan::ScanLine(bad.data(), bad.data() + bad.size(), ':', &result);
+    BOOST_CHECK(!result.token);
+
+    string field = "Host: a:8000\r\n";
+    scan::ScanField(field.data(), field.data() + field.size(), ':', &result);
+    BOOST_CHECK(result.crlf == field.data() + 12);
+    BOOST_CHECK(result.first == field.data() + 4);
+    BOOST_CHECK(result.token);
+
+    string request = "GET /a/long/path/that/crosses/blocks?q=1 HTTP/1.1\r\n";
+    scan::ScanLine(request.data(), request.data() + request.size(), ' ', &result);
+    BOOST_CHECK(result.first == request.data() + 3);
+    BOOST_CHECK(result.last == request.data() + request.size() - 11);
+    BOOST_CHECK_EQUAL(result.count, 2);
+
+    // 不完整的行
+    scan::ScanLine(request.data(), request.data() + request.size() - 1, ' ', &result);
+    BOOST_CHECK(result.crlf == NULL);
+    BOOST_CHECK(scan::FindCRLF(request.data(), request.data() + request.size() - 1) == NULL);
+
+    string headers = request + line + "\r\n";
+    BOOST_CHECK(scan::FindDoubleCRLF(headers.data(), headers.data() + headers.size()) ==
+                headers.data() + headers.size() - 4);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testSameAsScalar)
+{
+  ::srand(1);
+  for (int i = 0; i < 2000; ++i)
+  {
+    string line = RandomLine(i % 100);
+    const char* begin = line.data();
+    const char* end = begin + line.size();
+    char delim = i % 2 ? ':' : ' ';
+
+    scan::SetLevel(scan::kscalar);
+    scan::LineScan expected;
+    scan::ScanLine(begin, end, delim, &expected);
+    const char* expected_crlf = scan::FindCRLF(begin, end);
+    const char* expected_double = scan::FindDoubleCRLF(begin, end);
+    BOOST_CHECK(expected_crlf == expected.crlf);
+
+    for (scan::Level level : kall_levels)
+    {
+      if (!scan::SetLevel(level))
+        continue;
+      scan::LineScan result;
+      scan::ScanLine(begin, end, delim, &result);
+      BOOST_CHECK_MESSAGE(SameScan(result, expected),
+                          scan::LevelName(level) << " differs on \"" << line << "\"");
+      scan::ScanField(begin, end, delim, &result);
+      BOOST_CHECK_MESSAGE(result.crlf == expected.crlf && result.first == expected.first &&
+                          result.token == expected.token,
+                          scan::LevelName(level) << " field differs on \"" << line << "\"");
+      BOOST_CHECK(scan::FindCRLF(begin, end) == expected_crlf);
+      BOOST_CHECK(scan::FindDoubleCRLF(begin, end) == expected_double);
+    }
+  }
+}
@@ -0,0 +1,99 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.14
+// Filename:        timer_queue_bench.cc
+// Descripton:      比较std::set和分层时间轮两种定时器队列，大量定时器的插入、取消
+// 以及到期的开销
+//
+// usage: timer_queue_bench [timers] [fire_timers]
+
+#include "dwater/base/logging.h"
+#include "dwater/net/event_loop.h"
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+int g_fired = 0;
+double g_max_late = 0.0;
+
+void OnTimer(Timestamp when) {
+    ++g_fired;
+    double late = TimeDifference(Timestamp::Now(), when);
+    if ( late > g_max_late ) {
+        g_max_late = late;
+    }
+}
+
+///
+/// 先插入再全部取消，然后模拟连接超时：每次插入一个新的定时器并取消最老的一个
+///
+void Churn(EventLoop* loop, int timers) {
+    std::vector<TimerId> ids(timers);
+    srand(1);
+    Timestamp start(Timestamp::Now());
+    for ( int i = 0; i < timers; ++i ) {
+        ids[i] = loop->RunAfter(1.0 + rand() % 60000 / 1000.0, []{});
+    }
+    Timestamp added(Timestamp::Now());
+    for ( int i = 0; i < timers; ++i ) {
+        loop->Cancel(ids[i]);
+    }
+    Timestamp canceled(Timestamp::Now());
+
+    const int kwindow = 10000;
+    for ( int i = 0; i < timers; ++i ) {
+        TimerId& slot = ids[i % kwindow];
+        if ( i >= kwindow ) {
+            loop->Cancel(slot);
+        }
+        slot = loop->RunAfter(1.0 + rand() % 60000 / 1000.0, []{});
+    }
+    for ( int i = 0; i < kwindow && i < timers; ++i ) {
+        loop->Cancel(ids[i]);
+    }
+    Timestamp churned(Timestamp::Now());
+
+    printf("  add %6.1f ns/op, cancel %6.1f ns/op, add+cancel %6.1f ns/op\n",
+           TimeDifference(added, start) * 1e9 / timers,
+           TimeDifference(canceled, added) * 1e9 / timers,
+           TimeDifference(churned, canceled) * 1e9 / timers);
+}
+
+///
+/// 插入一批很短的定时器，检查都按时执行，统计最大延迟
+///
+void Fire(EventLoop* loop, int timers) {
+    g_fired = 0;
+    g_max_late = 0.0;
+    for ( int i = 0; i < timers; ++i ) {
+        double delay = (rand() % 500) / 1000.0;
+        Timestamp when = AddTime(Timestamp::Now(), delay);
+        loop->RunAt(when, std::bind(OnTimer, when));
+    }
+    loop->RunAfter(0.6, std::bind(&EventLoop::Quit, loop));
+    int64_t iterations = loop->Iteration();
+    loop->Loop();
+    printf("  fired %d/%d, max late %.2f ms, %lld loop wakeups\n",
+           g_fired, timers, g_max_late * 1000,
+           static_cast<long long>(loop->Iteration() - iterations));
+}
+
+void Bench(EventLoop::TimerQueueOption option, int timers, int fire_timers) {
+    EventLoop loop(option);
+    printf("%s:\n", option == EventLoop::kwheel_timer_queue ? "wheel" : "tree");
+    Churn(&loop, timers);
+    Fire(&loop, fire_timers);
+}
+
+int main(int argc, char* argv[]) {
+    int timers = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+    int fire_timers = argc > 2 ? atoi(argv[2]) : 100 * 1000;
+    Logger::SetLogLevel(Logger::WARN);
+    Bench(EventLoop::ktree_timer_queue, timers, fire_timers);
+    Bench(EventLoop::kwheel_timer_queue, timers, fire_timers);
+}
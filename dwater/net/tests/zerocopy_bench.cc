@@ -0,0 +1,117 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.17
+// Filename:        zerocopy_bench.cc
+// Descripton:      不同消息大小下TcpConnection::Send(shared_ptr)普通发送和MSG_ZEROCOPY
+// 发送的吞吐量和服务端CPU时间
+//
+// 客户端是fork出来的进程，只读数据，所以getrusage()得到的只有服务端的CPU时间。
+// loopback上内核在完成通知里报告copied，零拷贝只是推迟了拷贝，通常不划算；
+// 在真正的网卡上，消息越大越划算，一般几百KB以上才能抵消锁住页面和处理完成通知的开销
+//
+// usage: zerocopy_bench [total_mb] [host]
+
+#include "dwater/base/logging.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/inet_address.h"
+#include "dwater/net/tcp_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+const uint16_t kport = 9981;
+size_t g_total = 1024 * 1024 * 1024;
+size_t g_message_size = 0;
+bool g_zerocopy = false;
+EventLoop* g_loop = NULL;
+
+double CpuSeconds() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void OnConnection(const TcpConnectionPtr& conn) {
+    if ( conn->Connected() ) {
+        if ( g_zerocopy && !conn->EnableZeroCopy(g_message_size) ) {
+            printf("SO_ZEROCOPY not supported\n");
+        }
+        std::shared_ptr<const string> message(new string(g_message_size, 'z'));
+        // 全部放进发送队列，发送完之后关闭
+        conn->BeginBatch();
+        for ( size_t sent = 0; sent < g_total; sent += g_message_size ) {
+            conn->Send(message);
+        }
+        conn->EndBatch();
+        conn->Shutdown();
+    } else {
+        if ( g_zerocopy ) {
+            const TcpConnection::ZeroCopyStats& stats = conn->GetZeroCopyStats();
+            printf("    zerocopy sends %ld completions %ld copied %ld\n",
+                   stats.sends, stats.completions, stats.copied);
+        }
+        g_loop->Quit();
+    }
+}
+
+///
+/// 子进程，读到对方关闭为止
+///
+void RunReader(const char* host) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(host, kport);
+    if ( ::connect(sockfd, addr.GetSockAddr(), sizeof(struct sockaddr_in)) < 0 ) {
+        perror("connect");
+        _exit(1);
+    }
+    static char buf[256 * 1024];
+    while ( ::read(sockfd, buf, sizeof(buf)) > 0 ) {
+    }
+    ::close(sockfd);
+    _exit(0);
+}
+
+void RunOnce(EventLoop* loop, const char* host, size_t message_size, bool zerocopy) {
+    g_message_size = message_size;
+    g_zerocopy = zerocopy;
+    pid_t pid = ::fork();
+    if ( pid == 0 ) {
+        RunReader(host);
+    }
+    double cpu = CpuSeconds();
+    Timestamp start(Timestamp::Now());
+    loop->Loop();
+    double seconds = TimeDifference(Timestamp::Now(), start);
+    cpu = CpuSeconds() - cpu;
+    ::waitpid(pid, NULL, 0);
+    printf("%8zu KB %-9s %8.1f MiB/s  server cpu %.3fs (%.2f s/GiB)\n",
+           message_size / 1024, zerocopy ? "zerocopy" : "copy",
+           static_cast<double>(g_total) / seconds / 1024 / 1024,
+           cpu, cpu / (static_cast<double>(g_total) / 1024 / 1024 / 1024));
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 1 ) g_total = static_cast<size_t>(atoi(argv[1])) * 1024 * 1024;
+    const char* host = argc > 2 ? argv[2] : "127.0.0.1";
+
+    Logger::SetLogLevel(Logger::WARN);
+    EventLoop loop;
+    g_loop = &loop;
+    TcpServer server(&loop, InetAddress(kport), "ZeroCopyBench");
+    server.SetConnectionCallback(OnConnection);
+    server.Start();
+
+    const size_t sizes[] = { 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 4096 * 1024 };
+    for ( size_t size : sizes ) {
+        RunOnce(&loop, host, size, false);
+        RunOnce(&loop, host, size, true);
+    }
+}
@@ -20,5 +20,13 @@ void Timer::Restart(Timestamp now) {
     }
 }
 
+void Timer::Reset(TimerCallback cb, Timestamp when, double interval) {
+    callback_ = std::move(cb);
+    expiration_ = when;
+    interval_ = interval;
+    repeat_ = interval_ > 0.0;
+    sequence_ = s_num_created_.IncrementAndGet();
+}
+
 
 
@@ -48,15 +48,27 @@ public:
 
     void Restart(Timestamp now);
 
+    ///
+    /// 复用一个已经结束的定时器对象，会重新分配序列号，旧的TimerId随之失效
+    ///
+    void Reset(TimerCallback cb, Timestamp when, double interval);
+
+    ///
+    /// 释放回调函数持有的资源，定时器对象放回池中之前调用
+    ///
+    void Clear() {
+        callback_ = TimerCallback();
+    }
+
     static int64_t NumCreate() {
         return s_num_created_.Get();
     }
 private:
-    const TimerCallback callback_;
+    TimerCallback       callback_;
     Timestamp           expiration_;
-    const double        interval_;
-    const bool          repeat_;
-    const int64_t       sequence_; // 序列号
+    double              interval_;
+    bool                repeat_;
+    int64_t             sequence_; // 序列号
 
     static AtomicInt64  s_num_created_; // 用来产生Timer创建的编号，必须要线程安全的
 }; // class Timer
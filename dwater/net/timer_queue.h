@@ -1,20 +1,18 @@
 // Author:          Drinkwater
 // Email:           tanzhuobo@gmail.com
-// Last modified:   2021.03.23
+// Last modified:   2021.04.14
 // Filename:        timer_queue.h
-// Descripton:  
+// Descripton:      定时器队列的基类，封装了timerfd以及它的Channel，具体的定时器
+// 组织方式由子类实现：TreeTimerQueue(std::set)以及WheelTimerQueue(分层时间轮)
 
 
 #ifndef DWATER_NET_TIMER_QUEUE_H
 #define DWATER_NET_TIMER_QUEUE_H
 
-#include "dwater/base/mutex.h"
 #include "dwater/base/timestamp.h"
 #include "dwater/net/callbacks.h"
 #include "dwater/net/channel.h"
-
-#include <vector>
-#include <set>
+#include "dwater/net/timerid.h"
 
 namespace dwater {
 
@@ -22,60 +20,59 @@ namespace net {
 
 class EventLoop;
 class Timer;
-class TimerId;
 
-/// 
+///
 /// 定时器队列
 /// 定时器处理流程的封装
-/// 
+///
 class TimerQueue : noncopyable {
 public:
     explicit TimerQueue(EventLoop* loop);
-    ~TimerQueue();
+    virtual ~TimerQueue();
 
     ///
     /// 加入一个定时器任务，如果 @c interval > 0.0 就重复执行这个任务
-    /// 
+    ///
     /// 必须要保证这个函数是线程安全的，因为别的线程也会调用这个函数加入定时器任务
-    TimerId AddTimer(TimerCallback cb, Timestamp  when, double interval);
+    virtual TimerId AddTimer(TimerCallback cb, Timestamp  when, double interval) = 0;
 
-    void Cancel(TimerId timer_id);
+    virtual void Cancel(TimerId timer_id) = 0;
 
-private:
-    typedef std::pair<Timestamp, Timer*>    Entry;
-    typedef std::set<Entry>                 TimerList;
-    typedef std::pair<Timer*, int64_t>      ActiveTimer;
-    typedef std::set<ActiveTimer>           ActiveTimerSet;
-
-    void AddTimerInLoop(Timer* timer);
-    void CancelInLoop(TimerId timer_id);
-    void HandleRead();
+    ///
+    /// @brief 根据EventLoop的选项创建定时器队列
+    /// @param use_wheel 使用分层时间轮，否则使用std::set
+    ///
+    static TimerQueue* NewTimerQueue(EventLoop* loop, bool use_wheel);
 
-    std::vector<Entry> GetExpired(Timestamp now);
-    void Reset(const std::vector<Entry>& expired, Timestamp now);
+    ///
+    /// 环境变量DWATER_USE_TIMER_WHEEL决定默认的实现
+    ///
+    static TimerQueue* NewDefaultTimerQueue(EventLoop* loop);
 
+protected:
+    ///
+    /// timerfd可读，处理到期的定时器
     ///
-    /// @brief 往活动的定时器表中插入一个定时器
-    /// @param timer 要插入的定时器
-    /// @return 是否成功插入定时器
-    /// 
-    bool Insert(Timer* timer);
+    virtual void HandleRead() = 0;
+
+    /// 读出timerfd_中的数据，否则会一直可读
+    void ReadTimerfd(Timestamp now);
+
+    /// 重新设定timerfd_的超时时间
+    void ResetTimerfd(Timestamp expiration);
+
+    static Timer* TimerOf(const TimerId& timer_id) { return timer_id.timer_; }
+
+    static int64_t SequenceOf(const TimerId& timer_id) { return timer_id.sequence_; }
 
     EventLoop*      loop_;
     const int       timerfd_;
     Channel         timerfd_channel_;
-    TimerList       timers_;
-    ActiveTimerSet  active_timers_;
-    bool            calling_expired_timers_;
-    ActiveTimerSet  canceling_timers_;
 }; // class TimerQueue
 
 } // namespace net
 
-} // namespace 
+} // namespace
 
 
 #endif // DWATER_NET_TIMER_QUEUE_H
-
-
-
@@ -0,0 +1,25 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.14
+// Filename:        default_timer_queue.cc
+// Descripton:      
+
+#include "dwater/net/timer_queue.h"
+#include "dwater/net/timer_queue/tree_timer_queue.h"
+#include "dwater/net/timer_queue/wheel_timer_queue.h"
+
+#include <stdlib.h>
+
+using namespace dwater::net;
+
+TimerQueue* TimerQueue::NewTimerQueue(EventLoop* loop, bool use_wheel) {
+    if ( use_wheel ) {
+        return new WheelTimerQueue(loop);
+    } else {
+        return new TreeTimerQueue(loop);
+    }
+}
+
+TimerQueue* TimerQueue::NewDefaultTimerQueue(EventLoop* loop) {
+    return NewTimerQueue(loop, getenv("DWATER_USE_TIMER_WHEEL") != NULL);
+}
@@ -0,0 +1,143 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.14
+// Filename:        tree_timer_queue.cc
+// Descripton:       
+
+
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include "dwater/net/timer_queue/tree_timer_queue.h"
+#include "dwater/base/logging.h"
+#include "dwater/net/event_loop.h"
+#include "dwater/net/timer.h"
+
+#include <stdint.h>
+
+using namespace dwater;
+using namespace dwater::net;
+
+TreeTimerQueue::TreeTimerQueue(EventLoop* loop)
+    : TimerQueue(loop),
+      timers_(),
+      calling_expired_timers_(false) {
+}
+
+/// 
+/// 移除队列所有的定时器
+/// 
+TreeTimerQueue::~TreeTimerQueue() {
+    for ( const Entry& timer : timers_ ) {
+        delete timer.second;
+    }
+}
+
+TimerId TreeTimerQueue::AddTimer(TimerCallback cb, Timestamp when, double interavl) {
+    Timer* timer = new Timer(std::move(cb), when, interavl);
+    loop_->RunInLoop(std::bind(&TreeTimerQueue::AddTimerInLoop, this, timer));
+    return TimerId(timer, timer->Sequence());
+}
+
+void TreeTimerQueue::Cancel(TimerId timer_id) {
+    loop_->RunInLoop(std::bind(&TreeTimerQueue::CancelInLoop, this, timer_id));
+}
+
+void TreeTimerQueue::AddTimerInLoop(Timer* timer) {
+    loop_->AssertInLoopThread();
+    bool earliest_changed = Insert(timer);
+    if ( earliest_changed ) {
+        ResetTimerfd(timer->Expiration());
+    }
+}
+
+void TreeTimerQueue::CancelInLoop(TimerId timer_id) {
+    loop_->AssertInLoopThread();
+    assert(timers_.size() == active_timers_.size());
+    ActiveTimer timer(TimerOf(timer_id), SequenceOf(timer_id));
+    ActiveTimerSet::iterator it = active_timers_.find(timer);
+    if ( it != active_timers_.end() ) {
+        size_t n = timers_.erase(Entry(it->first->Expiration(), it->first));
+        assert(n == 1);
+        (void)n;
+        delete it->first;
+        active_timers_.erase(it);
+    } else if ( calling_expired_timers_ ) {
+        canceling_timers_.insert(timer);
+    }
+    assert(timers_.size() == active_timers_.size());
+}
+
+void TreeTimerQueue::HandleRead() {
+    loop_->AssertInLoopThread();
+    Timestamp now(Timestamp::Now());
+    ReadTimerfd(now);
+    std::vector<Entry> expired = GetExpired(now);
+    calling_expired_timers_ = true;
+    canceling_timers_.clear();
+
+    for ( const Entry& it : expired ) {
+        it.second->Run(); // run the callback of current timer
+    }
+    calling_expired_timers_ = false;
+    Reset(expired, now);
+}
+
+std::vector<TreeTimerQueue::Entry> TreeTimerQueue::GetExpired(Timestamp now) {
+    assert(timers_.size() == active_timers_.size());
+    std::vector<Entry> expired;
+    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
+    TimerList::iterator end = timers_.lower_bound(sentry);
+    assert(end == timers_.end() || now < end->first);
+    std::copy(timers_.begin(), end, back_inserter(expired));
+    timers_.erase(timers_.begin(), end);
+
+    for (  const Entry& it : expired ) {
+        ActiveTimer timer(it.second, it.second->Sequence());
+        size_t n = active_timers_.erase(timer);
+        assert(n == 1); (void)n;
+    }
+    assert(timers_.size() == active_timers_.size());
+    return expired;
+}
+
+void TreeTimerQueue::Reset(const std::vector<Entry>& expired, Timestamp now) {
+    Timestamp next_expired;
+    for ( const Entry& it : expired ) {
+        ActiveTimer timer(it.second, it.second->Sequence());
+        if ( it.second->Repeat() && canceling_timers_.find(timer) == canceling_timers_.end()) {
+            it.second->Restart(now); // 重启再次插入
+            Insert(it.second);
+        } else {
+            delete it.second; // 到时且不是repeat的定时器要删除
+        }
+    }
+    if ( !timers_.empty() ) {
+        next_expired = timers_.begin()->second->Expiration();
+    }
+    if ( next_expired.Valid() ) {
+        ResetTimerfd(next_expired);
+    }
+}
+
+bool TreeTimerQueue::Insert(Timer* timer) {
+    loop_->AssertInLoopThread();
+    assert(timers_.size() == active_timers_.size());
+    bool earliest_changed = false;
+    Timestamp when = timer->Expiration();
+    TimerList::iterator it = timers_.begin();
+    if ( it == timers_.end() || when < it->first ) {
+        earliest_changed = true;
+    }
+    {
+        std::pair<TimerList::iterator, bool> result = timers_.insert(Entry(when, timer));
+        assert(result.second); (void)result;
+    }
+    {
+        std::pair<ActiveTimerSet::iterator, bool> result = active_timers_.insert(ActiveTimer(timer, timer->Sequence()));
+        assert(result.second); (void)result;
+    }
+    assert(timers_.size() == active_timers_.size());
+    return earliest_changed;
+}
@@ -0,0 +1,67 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.14
+// Filename:        tree_timer_queue.h
+// Descripton:      用std::set组织的定时器队列，插入、删除O(logN)
+
+
+#ifndef DWATER_NET_TIMER_QUEUE_TREE_TIMER_QUEUE_H
+#define DWATER_NET_TIMER_QUEUE_TREE_TIMER_QUEUE_H
+
+#include "dwater/net/timer_queue.h"
+
+#include <vector>
+#include <set>
+
+namespace dwater {
+
+namespace net {
+
+/// 
+/// 定时器队列
+/// 按照到期时间排序的std::set，另外用一个std::set记录活动的定时器用于取消
+/// 
+class TreeTimerQueue : public TimerQueue {
+public:
+    explicit TreeTimerQueue(EventLoop* loop);
+    ~TreeTimerQueue() override;
+
+    TimerId AddTimer(TimerCallback cb, Timestamp  when, double interval) override;
+
+    void Cancel(TimerId timer_id) override;
+
+private:
+    typedef std::pair<Timestamp, Timer*>    Entry;
+    typedef std::set<Entry>                 TimerList;
+    typedef std::pair<Timer*, int64_t>      ActiveTimer;
+    typedef std::set<ActiveTimer>           ActiveTimerSet;
+
+    void AddTimerInLoop(Timer* timer);
+    void CancelInLoop(TimerId timer_id);
+    void HandleRead() override;
+
+    std::vector<Entry> GetExpired(Timestamp now);
+    void Reset(const std::vector<Entry>& expired, Timestamp now);
+
+    ///
+    /// @brief 往活动的定时器表中插入一个定时器
+    /// @param timer 要插入的定时器
+    /// @return 是否成功插入定时器
+    /// 
+    bool Insert(Timer* timer);
+
+    TimerList       timers_;
+    ActiveTimerSet  active_timers_;
+    bool            calling_expired_timers_;
+    ActiveTimerSet  canceling_timers_;
+}; // class TreeTimerQueue
+
+} // namespace net
+
+} // namespace 
+
+
+#endif // DWATER_NET_TIMER_QUEUE_TREE_TIMER_QUEUE_H
+
+
+
@@ -0,0 +1,306 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.14
+// Filename:        wheel_timer_queue.cc
+// Descripton:
+
+#include "dwater/net/timer_queue/wheel_timer_queue.h"
+#include "dwater/base/logging.h"
+#include "dwater/net/event_loop.h"
+
+#include <algorithm>
+
+using namespace dwater;
+using namespace dwater::net;
+
+const int WheelTimerQueue::kbits;
+const int WheelTimerQueue::klevels;
+const int WheelTimerQueue::kslots;
+const int WheelTimerQueue::kslot_mask;
+const int WheelTimerQueue::kwords;
+
+WheelTimerQueue::WheelTimerQueue(EventLoop* loop)
+    : TimerQueue(loop),
+      base_(NowTick()),
+      armed_tick_(0),
+      size_(0),
+      free_list_(NULL),
+      calling_expired_timers_(false) {
+    MemZero(wheel_, sizeof(wheel_));
+    MemZero(bitmap_, sizeof(bitmap_));
+}
+
+///
+/// 所有的节点都在nodes_中，包括时间轮中的、空闲的
+///
+WheelTimerQueue::~WheelTimerQueue() {
+    for ( Node* node : nodes_ ) {
+        delete node;
+    }
+}
+
+///
+/// 在IO线程中直接从池中取节点插入，其他线程先new一个节点再交给IO线程
+///
+TimerId WheelTimerQueue::AddTimer(TimerCallback cb, Timestamp when, double interval) {
+    Node* node = NULL;
+    if ( loop_->IsInLoopThread() ) {
+        node = Allocate(std::move(cb), when, interval);
+        Schedule(node);
+        return TimerId(node, node->Sequence());
+    }
+    node = new Node(std::move(cb), when, interval);
+    // 交给IO线程之后节点可能马上到期并被复用，所以先取出序列号
+    TimerId timer_id(node, node->Sequence());
+    loop_->QueueInLoop(std::bind(&WheelTimerQueue::AddTimerInLoop, this, node));
+    return timer_id;
+}
+
+void WheelTimerQueue::Cancel(TimerId timer_id) {
+    loop_->RunInLoop(std::bind(&WheelTimerQueue::CancelInLoop, this, timer_id));
+}
+
+void WheelTimerQueue::AddTimerInLoop(Node* node) {
+    loop_->AssertInLoopThread();
+    nodes_.push_back(node);
+    Schedule(node);
+}
+
+void WheelTimerQueue::Schedule(Node* node) {
+    if ( size_ == 0 ) {
+        // 时间轮为空的时候直接跳到当前时间，避免处理中间空的tick
+        base_ = std::max(base_, NowTick());
+    }
+    node->expire_tick = TickOf(node->Expiration());
+    int64_t tick = Insert(node);
+    if ( !calling_expired_timers_ && (armed_tick_ == 0 || tick < armed_tick_) ) {
+        ArmTimerfd(tick);
+    }
+}
+
+///
+/// 节点不会被释放，序列号不同说明定时器已经结束或者节点已经被复用
+///
+void WheelTimerQueue::CancelInLoop(TimerId timer_id) {
+    loop_->AssertInLoopThread();
+    Node* node = static_cast<Node*>(TimerOf(timer_id));
+    if ( node == NULL || node->Sequence() != SequenceOf(timer_id) ) {
+        return;
+    }
+    if ( node->state == kpending ) {
+        Unlink(node);
+        --size_;
+        Release(node);
+    } else if ( node->state == kexpired ) {
+        // 正在处理到期的定时器，还没有执行的不再执行，重复的不再插入
+        node->state = kcanceled;
+    }
+}
+
+void WheelTimerQueue::HandleRead() {
+    loop_->AssertInLoopThread();
+    Timestamp now(Timestamp::Now());
+    ReadTimerfd(now);
+    armed_tick_ = 0;
+
+    expired_.clear();
+    Advance(now.MicroSecondsSinceEpoch() / 1000);
+
+    calling_expired_timers_ = true;
+    for ( size_t i = 0; i < expired_.size(); ++i ) {
+        if ( expired_[i]->state == kexpired ) {
+            expired_[i]->Run();
+        }
+    }
+    calling_expired_timers_ = false;
+
+    for ( Node* node : expired_ ) {
+        if ( node->state == kexpired && node->Repeat() ) {
+            node->Restart(now);
+            node->expire_tick = TickOf(node->Expiration());
+            Insert(node);
+        } else {
+            Release(node);
+        }
+    }
+    expired_.clear();
+
+    int64_t tick = NextTick();
+    if ( tick > 0 ) {
+        ArmTimerfd(tick);
+    }
+}
+
+WheelTimerQueue::Node* WheelTimerQueue::Allocate(TimerCallback cb, Timestamp when, double interval) {
+    Node* node = free_list_;
+    if ( node ) {
+        free_list_ = node->next;
+        node->next = NULL;
+        node->Reset(std::move(cb), when, interval);
+    } else {
+        node = new Node(std::move(cb), when, interval);
+        nodes_.push_back(node);
+    }
+    return node;
+}
+
+void WheelTimerQueue::Release(Node* node) {
+    node->Clear();
+    node->state = kfree;
+    node->pprev = NULL;
+    node->next = free_list_;
+    free_list_ = node;
+}
+
+int64_t WheelTimerQueue::Insert(Node* node) {
+    int64_t expire = std::max(node->expire_tick, base_);
+    int64_t delta = expire - base_;
+    int level = 0;
+    while ( level < klevels - 1 && delta >= (static_cast<int64_t>(1) << (kbits * (level + 1))) ) {
+        ++level;
+    }
+    if ( level == klevels - 1 && delta >= (static_cast<int64_t>(1) << (kbits * klevels)) ) {
+        // 超出时间轮的范围，先放在最高层最远的slot，级联的时候再重新计算
+        expire = base_ + (static_cast<int64_t>(1) << (kbits * klevels)) - 1;
+    }
+    int shift = kbits * level;
+    int slot = static_cast<int>(expire >> shift) & kslot_mask;
+
+    Node** head = &wheel_[level][slot];
+    node->next = *head;
+    if ( node->next ) {
+        node->next->pprev = &node->next;
+    }
+    node->pprev = head;
+    *head = node;
+    bitmap_[level][slot >> 6] |= static_cast<uint64_t>(1) << (slot & 63);
+
+    node->level = level;
+    node->slot = slot;
+    node->state = kpending;
+    ++size_;
+    return (expire >> shift) << shift;
+}
+
+void WheelTimerQueue::Unlink(Node* node) {
+    *node->pprev = node->next;
+    if ( node->next ) {
+        node->next->pprev = node->pprev;
+    }
+    if ( wheel_[node->level][node->slot] == NULL ) {
+        bitmap_[node->level][node->slot >> 6] &= ~(static_cast<uint64_t>(1) << (node->slot & 63));
+    }
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+WheelTimerQueue::Node* WheelTimerQueue::TakeSlot(int level, int slot) {
+    Node* list = wheel_[level][slot];
+    wheel_[level][slot] = NULL;
+    bitmap_[level][slot >> 6] &= ~(static_cast<uint64_t>(1) << (slot & 63));
+    return list;
+}
+
+int WheelTimerQueue::Cascade(int level, int slot) {
+    Node* node = TakeSlot(level, slot);
+    while ( node ) {
+        Node* next = node->next;
+        --size_;
+        Insert(node);
+        node = next;
+    }
+    return slot;
+}
+
+void WheelTimerQueue::Advance(int64_t now_tick) {
+    while ( base_ <= now_tick ) {
+        int index = static_cast<int>(base_) & kslot_mask;
+        if ( index == 0 ) {
+            int level = 1;
+            while ( level < klevels
+                    && Cascade(level, static_cast<int>(base_ >> (kbits * level)) & kslot_mask) == 0 ) {
+                ++level;
+            }
+        }
+        Node* node = TakeSlot(0, index);
+        while ( node ) {
+            Node* next = node->next;
+            node->next = NULL;
+            node->pprev = NULL;
+            node->state = kexpired;
+            --size_;
+            expired_.push_back(node);
+            node = next;
+        }
+        ++base_;
+
+        if ( size_ == 0 ) {
+            base_ = now_tick + 1;
+            break;
+        }
+        // 跳过空的slot，但是不能跳过级联的tick
+        int64_t next_tick = (base_ + kslot_mask) & ~static_cast<int64_t>(kslot_mask);
+        int distance = NextOccupied(0, static_cast<int>(base_) & kslot_mask);
+        if ( distance >= 0 ) {
+            next_tick = std::min(next_tick, base_ + distance);
+        }
+        base_ = std::min(next_tick, now_tick + 1);
+    }
+}
+
+int WheelTimerQueue::NextOccupied(int level, int from) const {
+    for ( int i = 0; i <= kwords; ++i ) {
+        int word = ((from >> 6) + i) % kwords;
+        uint64_t bits = bitmap_[level][word];
+        if ( i == 0 ) {
+            bits &= ~static_cast<uint64_t>(0) << (from & 63);
+        } else if ( i == kwords ) {
+            // 绕回到from所在的word，只看from之前的slot
+            bits &= (static_cast<uint64_t>(1) << (from & 63)) - 1;
+        }
+        if ( bits ) {
+            int slot = (word << 6) + __builtin_ctzll(bits);
+            return (slot - from) & kslot_mask;
+        }
+    }
+    return -1;
+}
+
+///
+/// 第0层的节点在它的slot到期，更高层的节点在级联的时候需要处理
+///
+int64_t WheelTimerQueue::NextTick() const {
+    if ( size_ == 0 ) {
+        return -1;
+    }
+    int64_t tick = -1;
+    int distance = NextOccupied(0, static_cast<int>(base_) & kslot_mask);
+    if ( distance >= 0 ) {
+        tick = base_ + distance;
+    }
+    for ( int level = 1; level < klevels; ++level ) {
+        int shift = kbits * level;
+        int64_t round = (base_ + (static_cast<int64_t>(1) << shift) - 1) >> shift;
+        distance = NextOccupied(level, static_cast<int>(round) & kslot_mask);
+        if ( distance >= 0 ) {
+            int64_t cascade_tick = (round + distance) << shift;
+            if ( tick < 0 || cascade_tick < tick ) {
+                tick = cascade_tick;
+            }
+        }
+    }
+    return tick;
+}
+
+void WheelTimerQueue::ArmTimerfd(int64_t tick) {
+    armed_tick_ = tick;
+    ResetTimerfd(Timestamp(tick * 1000));
+}
+
+int64_t WheelTimerQueue::TickOf(Timestamp when) {
+    return (when.MicroSecondsSinceEpoch() + 999) / 1000;
+}
+
+int64_t WheelTimerQueue::NowTick() {
+    return Timestamp::Now().MicroSecondsSinceEpoch() / 1000;
+}
@@ -0,0 +1,107 @@
+// Author:          Drinkwater
+// Email:           tanzhuobo@gmail.com
+// Last modified:   2021.04.14
+// Filename:        wheel_timer_queue.h
+// Descripton:      分层时间轮实现的定时器队列，插入、删除O(1)
+//
+// 时间精度1ms(一个tick)，4层，每层256个slot，总共可以表示2^32个tick(约49天)，
+// 更远的定时器先放在最高层，级联时重新计算位置。每个slot是一个侵入式的双向链表，
+// 每层用一个bitmap记录非空的slot，timerfd只设定到下一个非空的slot
+
+#ifndef DWATER_NET_TIMER_QUEUE_WHEEL_TIMER_QUEUE_H
+#define DWATER_NET_TIMER_QUEUE_WHEEL_TIMER_QUEUE_H
+
+#include "dwater/net/timer.h"
+#include "dwater/net/timer_queue.h"
+
+#include <vector>
+
+namespace dwater {
+
+namespace net {
+
+///
+/// 分层时间轮
+/// 结束的定时器对象放回空闲链表中复用，在析构之前不会释放，所以取消一个已经结束的
+/// 定时器只需要比较序列号
+///
+class WheelTimerQueue : public TimerQueue {
+public:
+    explicit WheelTimerQueue(EventLoop* loop);
+    ~WheelTimerQueue() override;
+
+    TimerId AddTimer(TimerCallback cb, Timestamp  when, double interval) override;
+
+    void Cancel(TimerId timer_id) override;
+
+private:
+    static const int kbits = 8;
+    static const int klevels = 4;
+    static const int kslots = 1 << kbits;
+    static const int kslot_mask = kslots - 1;
+    static const int kwords = kslots / 64;
+
+    enum State { kfree, kpending, kexpired, kcanceled };
+
+    struct Node : public Timer {
+        Node(TimerCallback cb, Timestamp when, double interval)
+            : Timer(std::move(cb), when, interval),
+              next(NULL), pprev(NULL), expire_tick(0),
+              level(0), slot(0), state(kfree) {}
+
+        Node*   next;
+        Node**  pprev;       // 指向前一个节点的next，方便O(1)删除
+        int64_t expire_tick;
+        int     level;
+        int     slot;
+        State   state;
+    };
+
+    /// 其他线程new出来的节点，交给nodes_管理
+    void AddTimerInLoop(Node* node);
+    void Schedule(Node* node);
+    void CancelInLoop(TimerId timer_id);
+    void HandleRead() override;
+
+    Node* Allocate(TimerCallback cb, Timestamp when, double interval);
+    void Release(Node* node);
+
+    /// 放入时间轮，返回需要处理这个节点的tick(到期或者级联)
+    int64_t Insert(Node* node);
+    void Unlink(Node* node);
+    Node* TakeSlot(int level, int slot);
+
+    /// 把第level层的slot重新插入到低层，返回slot
+    int Cascade(int level, int slot);
+
+    /// 处理[base_, now_tick]之间所有的tick，到期的节点放入expired_
+    void Advance(int64_t now_tick);
+
+    /// 从slot from开始(包括from)第一个非空slot的距离，没有返回-1
+    int NextOccupied(int level, int from) const;
+
+    /// 下一个需要处理的tick，时间轮为空返回-1
+    int64_t NextTick() const;
+
+    void ArmTimerfd(int64_t tick);
+
+    static int64_t TickOf(Timestamp when); // 向上取整
+    static int64_t NowTick();               // 向下取整
+
+    Node*               wheel_[klevels][kslots];
+    uint64_t            bitmap_[klevels][kwords];
+    int64_t             base_;          // 下一个要处理的tick
+    int64_t             armed_tick_;    // timerfd_设定的tick，0表示没有设定
+    size_t              size_;          // 时间轮中的节点数
+    Node*               free_list_;
+    std::vector<Node*>  nodes_;         // 所有分配的节点
+    std::vector<Node*>  expired_;
+    bool                calling_expired_timers_;
+}; // class WheelTimerQueue
+
+} // namespace net
+
+} // namespace dwater
+
+
+#endif // DWATER_NET_TIMER_QUEUE_WHEEL_TIMER_QUEUE_H